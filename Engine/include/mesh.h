@@ -0,0 +1,27 @@
+#ifndef MESH_H
+#define MESH_H
+#pragma once
+#include "hello_export.h"
+#include <stdint.h>
+#include <vector>
+
+namespace HelloEngine
+{
+	// Number of floats in one vertex: position x, y, z, w and texture coordinates u, v
+	static const uint32_t MESH_VERTEX_SIZE = 6;
+
+	// Indexed triangle list in the renderer's vertex layout
+	struct Mesh {
+		std::vector<float>    vertices;
+		std::vector<uint32_t> indices;
+	};
+
+	// Indexes an unindexed triangle list, keeping one copy of bitwise identical vertices
+	HELLO_ENGINE_API Mesh DeduplicateVertices(const std::vector<float>& vertex_data);
+	// Reorders triangles so that they reuse recently transformed vertices, then
+	// renumbers vertices in the order the triangles first reference them
+	HELLO_ENGINE_API void OptimizeMesh(Mesh &mesh);
+	// Average number of vertex shader invocations per triangle with a FIFO post-transform cache
+	HELLO_ENGINE_API float GetAverageCacheMissRatio(const Mesh &mesh, uint32_t cache_size = 16);
+}
+#endif
@@ -3,20 +3,184 @@
 #pragma once
 #include "window.h"
 #include "color.h"
+#include "mesh.h"
+#include "sprite_culling.h"
+#include <stdint.h>
 
 namespace HelloEngine 
 {
 	class RenderParameters;
 
+	enum class CommandBufferMode {
+		RecordEachFrame, PreRecorded
+	};
+
+	enum class PresentMode {
+		LowLatency, Uncapped, VSync
+	};
+
+	struct RendererStatistics {
+		uint64_t frameCount;
+		uint64_t framebufferCreations;
+		uint64_t commandBufferRecordings;
+		uint64_t fenceWaits;
+		double   fenceWaitMilliseconds;
+		uint64_t spriteCount;
+		uint64_t spriteDrawCalls;
+		double   spriteBuildMilliseconds;
+		uint64_t visibleSpriteCount;
+		double   spriteCullMilliseconds;
+		uint64_t skippedPipelineBinds;
+		uint64_t skippedDescriptorSetBinds;
+		uint64_t skippedVertexBufferBinds;
+		uint64_t renderGraphBarriers;
+		uint64_t culledRenderGraphPasses;
+		double   pipelineCreationMilliseconds;
+		double   pipelineCacheSavedMilliseconds;
+		uint32_t graphicsPipelines;
+		uint32_t pendingGraphicsPipelines;
+		uint64_t deduplicatedPipelineRequests;
+		uint32_t descriptorPools;
+		uint32_t cachedDescriptorSets;
+		uint64_t descriptorSetCacheHits;
+
+		RendererStatistics() :
+			frameCount(0),
+			framebufferCreations(0),
+			commandBufferRecordings(0),
+			fenceWaits(0),
+			fenceWaitMilliseconds(0.0),
+			spriteCount(0),
+			spriteDrawCalls(0),
+			spriteBuildMilliseconds(0.0),
+			visibleSpriteCount(0),
+			spriteCullMilliseconds(0.0),
+			skippedPipelineBinds(0),
+			skippedDescriptorSetBinds(0),
+			skippedVertexBufferBinds(0),
+			renderGraphBarriers(0),
+			culledRenderGraphPasses(0),
+			pipelineCreationMilliseconds(0.0),
+			pipelineCacheSavedMilliseconds(0.0),
+			graphicsPipelines(0),
+			pendingGraphicsPipelines(0),
+			deduplicatedPipelineRequests(0),
+			descriptorPools(0),
+			cachedDescriptorSets(0),
+			descriptorSetCacheHits(0) {
+		}
+	};
+
+	static const uint32_t MAX_SPRITE_LAYER = 255;
+
+	// Textured quad centred at (x, y), in the same units as vertex data.
+	// Texture 0 is the one loaded at initialization. Layers go from 0 to
+	// MAX_SPRITE_LAYER and higher layers are drawn over lower ones; within a
+	// layer sprites are grouped by texture and keep submission order only
+	// among sprites sharing one. The texture colour is multiplied by tint.
+	struct Sprite {
+		float    x, y;
+		float    width, height;
+		float    u0, v0, u1, v1;
+		uint32_t texture;
+		uint32_t layer;
+		Color    tint;
+
+		Sprite() :
+			x(0.0f), y(0.0f),
+			width(0.0f), height(0.0f),
+			u0(0.0f), v0(0.0f), u1(1.0f), v1(1.0f),
+			texture(0),
+			layer(0),
+			tint{ 1.0f, 1.0f, 1.0f } {
+		}
+	};
+
+	struct MemoryStatistics {
+		uint32_t blockCount;
+		uint32_t allocationCount;
+		uint64_t reservedBytes;
+		uint64_t usedBytes;
+		uint32_t freeRangeCount;
+		uint64_t largestFreeRange;
+		float    fragmentation;
+
+		MemoryStatistics() :
+			blockCount(0),
+			allocationCount(0),
+			reservedBytes(0),
+			usedBytes(0),
+			freeRangeCount(0),
+			largestFreeRange(0),
+			fragmentation(0.0f) {
+		}
+	};
+
+	// One copy of the mesh drawn by DrawInstances(): scaled, rotated around its
+	// origin by rotation radians and moved to (x, y). Mesh texture coordinates
+	// are mapped into the UV rectangle and the texture colour is multiplied by tint.
+	struct Instance {
+		float    x, y;
+		float    scaleX, scaleY;
+		float    rotation;
+		float    u0, v0, u1, v1;
+		Color    tint;
+
+		Instance() :
+			x(0.0f), y(0.0f),
+			scaleX(1.0f), scaleY(1.0f),
+			rotation(0.0f),
+			u0(0.0f), v0(0.0f), u1(1.0f), v1(1.0f),
+			tint{ 1.0f, 1.0f, 1.0f } {
+		}
+	};
+
+	// Shader features of instanced drawing. Each combination is its own pipeline
+	// with the disabled paths compiled out; alpha tested instances discard
+	// texels with alpha below one half.
+	enum InstanceFeatureFlagBits {
+		INSTANCE_FEATURE_TINT_BIT       = 0x00000001,
+		INSTANCE_FEATURE_ALPHA_TEST_BIT = 0x00000002
+	};
+
 	class HELLO_ENGINE_API Renderer {
 	public:
 		Renderer();
 		~Renderer();
 
-		bool Initialize(WindowParameters *parameters, const std::vector<float>& vertex_data, Color color = { 0.0f, 0.3f, 0.4f });
+		bool Initialize(WindowParameters *parameters, const std::vector<float>& vertex_data, Color color = { 0.0f, 0.3f, 0.4f }, uint32_t frames_in_flight = 3);
+		// Indexed meshes are drawn as triangle lists, unindexed vertex data as a triangle strip
+		bool Initialize(WindowParameters *parameters, const Mesh& mesh, Color color = { 0.0f, 0.3f, 0.4f }, uint32_t frames_in_flight = 3);
 		bool OnWindowSizeChanged();
 		bool ReadyToDraw() const;
 		bool Draw();
+		void SetCommandBufferMode(CommandBufferMode mode);
+		void MarkSceneDirty();
+		bool SetPresentMode(PresentMode mode);
+		PresentMode GetPresentMode() const;
+		RendererStatistics GetStatistics() const;
+		MemoryStatistics GetMemoryStatistics() const;
+		// Streamed vertex data, in floats; writes land in the next frame's copy and never wait for the GPU.
+		// SetVertexData replaces the whole stream, frames in flight keep drawing what they were given.
+		bool UpdateVertexData(const std::vector<float>& vertex_data, uint32_t offset = 0);
+		bool AppendVertexData(const std::vector<float>& vertex_data);
+		bool SetVertexData(const std::vector<float>& vertex_data);
+		// Sprites are drawn by the next Draw() call only, in submission order.
+		// Those outside the view are dropped on the CPU before their quads are built.
+		bool DrawSprites(const std::vector<Sprite>& sprites);
+		void SetSpriteCullSettings(const CullSettings& settings);
+		// Multiplies the colour of every sprite on the layer, on top of the tint of each sprite
+		bool SetSpriteLayerTint(uint32_t layer, Color tint);
+		// World rectangle shown by the window; window pixel (x, y) maps to (left + x, top + y)
+		CullRect GetViewRect() const;
+		// Draws the mesh once per instance with a single draw call in the next frame
+		bool DrawInstances(const std::vector<Instance>& instances);
+		// Culls instances against the view in a compute pass; the draw then reads the survivors indirectly
+		bool SetGpuCulling(bool enabled);
+		// Alpha blends sprites; until the blended pipeline is compiled in the background they draw opaque
+		void SetSpriteBlending(bool enabled);
+		// Combination of InstanceFeatureFlagBits; new combinations draw with the default one until compiled
+		void SetInstanceFeatures(uint32_t features);
 	private:
 		RenderParameters *m_Params;
 	};
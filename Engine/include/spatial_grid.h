@@ -0,0 +1,66 @@
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+#pragma once
+#include "hello_export.h"
+#include "sprite_culling.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace HelloEngine
+{
+	// Uniform grid over a world rectangle; objects outside it are kept in the
+	// border cells. Static objects are bulk built into packed cell lists,
+	// moving ones live in per-cell lists updated in place. Object ids index a
+	// dense table, so they should be small. Queries never allocate: they fill
+	// the caller's array and return how many objects matched, which may be
+	// more than fit into it.
+	class HELLO_ENGINE_API SpatialGrid {
+	public:
+		SpatialGrid();
+
+		void					Initialize(const CullRect &world, float cell_size);
+		// Replaces all static objects
+		void					Build(const uint32_t *ids, const CullRect *bounds, size_t count);
+		void					Insert(uint32_t id, const CullRect &bounds);
+		void					Update(uint32_t id, const CullRect &bounds);
+		void					Remove(uint32_t id);
+
+		size_t					QueryRect(const CullRect &rect, uint32_t *ids, size_t max_count) const;
+		size_t					QueryPoint(float x, float y, uint32_t *ids, size_t max_count) const;
+		size_t					QueryRadius(float x, float y, float radius, uint32_t *ids, size_t max_count) const;
+		// Finds the object with the highest id under the point. With ids in submission order that is the sprite
+		// drawn on top only among sprites sharing a layer and texture; the render queue groups the rest by texture
+		bool					Pick(float x, float y, uint32_t &id) const;
+	private:
+		struct CellRange {
+			uint32_t left, top, right, bottom;
+		};
+
+		struct DynamicObject {
+			CullRect  bounds;
+			CellRange cells;
+			bool      inserted;
+		};
+
+		uint32_t				GetCellX(float x) const;
+		uint32_t				GetCellY(float y) const;
+		CellRange				GetCellRange(const CullRect &bounds) const;
+		void					AddToCells(uint32_t id, const CellRange &cells);
+		void					RemoveFromCells(uint32_t id, const CellRange &cells);
+		template<typename Visitor>
+		void					Visit(const CullRect &rect, Visitor visitor) const;
+
+		CullRect							m_World;
+		float								m_InverseCellSize;
+		uint32_t							m_Columns;
+		uint32_t							m_Rows;
+		std::vector<uint32_t>				m_StaticCellStart;
+		std::vector<uint32_t>				m_StaticCellObjects;
+		std::vector<uint32_t>				m_StaticIds;
+		std::vector<CullRect>				m_StaticBounds;
+		std::vector<std::vector<uint32_t>>	m_DynamicCells;
+		std::vector<DynamicObject>			m_DynamicObjects;
+	};
+}
+#endif
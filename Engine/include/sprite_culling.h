@@ -0,0 +1,70 @@
+#ifndef SPRITE_CULLING_H
+#define SPRITE_CULLING_H
+#pragma once
+#include "hello_export.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+namespace HelloEngine
+{
+	// Axis aligned rectangle, top is the smaller y
+	struct CullRect {
+		float left, top, right, bottom;
+	};
+
+	enum class CullMethod {
+		Scalar, Simd
+	};
+
+	// Bounds are split into chunks of chunkSize, spread over threadCount threads.
+	// Counts below one chunk or a single thread cull on the calling thread.
+	// The extra threads are started by the first threaded cull and kept for later ones.
+	struct CullSettings {
+		CullMethod method;
+		uint32_t   threadCount;
+		uint32_t   chunkSize;
+
+		CullSettings() :
+			method(CullMethod::Simd),
+			threadCount(1),
+			chunkSize(65536) {
+		}
+	};
+
+	class CullWorkers;
+
+	// Sprite bounds stored as separate arrays, so a culling kernel loads
+	// several sprites' edges with one vector load
+	class HELLO_ENGINE_API SpriteBounds {
+	public:
+		SpriteBounds();
+		~SpriteBounds();
+
+		void					Resize(size_t count);
+		void					Clear();
+		size_t					GetCount() const;
+		// Writes the indices of bounds overlapping view into visible in increasing order
+		void					Cull(const CullRect &view, std::vector<uint32_t> &visible, const CullSettings &settings = CullSettings()) const;
+
+		void Set(size_t index, float left, float top, float right, float bottom) {
+			m_Left[index] = left;
+			m_Top[index] = top;
+			m_Right[index] = right;
+			m_Bottom[index] = bottom;
+		}
+	private:
+		size_t					CullRange(const CullRect &view, size_t begin, size_t end, uint32_t *visible, CullMethod method) const;
+
+		std::vector<float>		m_Left;
+		std::vector<float>		m_Top;
+		std::vector<float>		m_Right;
+		std::vector<float>		m_Bottom;
+		mutable std::unique_ptr<CullWorkers> m_Workers;
+	};
+
+	// True when CullMethod::Simd runs 8-wide AVX rather than 4-wide SSE or the scalar fallback
+	HELLO_ENGINE_API bool IsAvxCullingSupported();
+}
+#endif
@@ -0,0 +1,25 @@
+#version 450
+
+// Set per pipeline variant, the branches on them are folded away when the pipeline is compiled
+layout(constant_id = 0) const bool c_Tint = true;
+layout(constant_id = 1) const bool c_AlphaTest = false;
+
+layout(set = 0, binding = 0) uniform sampler2D u_Texture;
+
+// Pushed for each draw; sprites get the tint of their layer, instances white
+layout(push_constant) uniform u_DrawConstants {
+	vec3 u_DrawTint;
+};
+
+layout(location = 0) in vec2 v_Texcoord;
+layout(location = 1) in vec3 v_Tint;
+
+layout(location = 0) out vec4 o_Color;
+
+void main() {
+	vec4 color = texture(u_Texture, v_Texcoord);
+	if (c_AlphaTest && (color.a < 0.5)) {
+		discard;
+	}
+	o_Color = vec4((c_Tint ? color.rgb * v_Tint : color.rgb) * u_DrawTint, color.a);
+}
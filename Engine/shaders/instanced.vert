@@ -0,0 +1,31 @@
+#version 450
+
+layout(location = 0) in vec4 i_Position;
+layout(location = 1) in vec2 i_Texcoord;
+layout(location = 2) in vec4 i_Transform;
+layout(location = 3) in float i_Rotation;
+layout(location = 4) in vec4 i_TexcoordRect;
+layout(location = 5) in vec3 i_Tint;
+
+layout(set = 0, binding = 1) uniform u_UniformBuffer {
+	mat4 u_ProjectionMatrix;
+};
+
+out gl_PerVertex {
+	vec4 gl_Position;
+};
+
+layout(location = 0) out vec2 v_Texcoord;
+layout(location = 1) out vec3 v_Tint;
+
+void main() {
+	// i_Transform holds the translation in xy and the scale in zw
+	vec2 scaled = i_Position.xy * i_Transform.zw;
+	float s = sin(i_Rotation);
+	float c = cos(i_Rotation);
+	vec2 rotated = vec2(c * scaled.x - s * scaled.y, s * scaled.x + c * scaled.y);
+
+	gl_Position = u_ProjectionMatrix * vec4(rotated + i_Transform.xy, i_Position.zw);
+	v_Texcoord = mix(i_TexcoordRect.xy, i_TexcoordRect.zw, i_Texcoord);
+	v_Tint = i_Tint;
+}
@@ -0,0 +1,23 @@
+#version 450
+
+layout(location = 0) in vec4 i_Position;
+layout(location = 1) in vec2 i_Texcoord;
+layout(location = 2) in vec3 i_Tint;
+
+layout(set = 0, binding = 1) uniform u_UniformBuffer {
+	mat4 u_ProjectionMatrix;
+};
+
+out gl_PerVertex {
+	vec4 gl_Position;
+};
+
+// Outputs match what instanced.frag reads, sprites share its fragment stage
+layout(location = 0) out vec2 v_Texcoord;
+layout(location = 1) out vec3 v_Tint;
+
+void main() {
+	gl_Position = u_ProjectionMatrix * i_Position;
+	v_Texcoord = i_Texcoord;
+	v_Tint = i_Tint;
+}
@@ -0,0 +1,236 @@
+#include "mesh.h"
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+#include <unordered_map>
+
+namespace HelloEngine
+{
+	namespace
+	{
+		struct VertexKey {
+			const float *data;
+
+			bool operator == (const VertexKey &other) const
+			{
+				return memcmp(data, other.data, MESH_VERTEX_SIZE * sizeof(float)) == 0;
+			}
+		};
+
+		struct VertexKeyHash {
+			size_t operator () (const VertexKey &key) const
+			{
+				// FNV-1a over the raw bytes, so -0.0f and 0.0f stay distinct like in the comparison
+				const unsigned char *bytes = reinterpret_cast<const unsigned char*>(key.data);
+				size_t hash = 2166136261u;
+				for (size_t i = 0; i < MESH_VERTEX_SIZE * sizeof(float); ++i) {
+					hash = (hash ^ bytes[i]) * 16777619u;
+				}
+				return hash;
+			}
+		};
+
+		// Scoring of "Linear-Speed Vertex Cache Optimisation" by Tom Forsyth
+		const uint32_t SCORE_CACHE_SIZE = 32;
+		const float    CACHE_DECAY_POWER = 1.5f;
+		const float    LAST_TRIANGLE_SCORE = 0.75f;
+		const float    VALENCE_BOOST_SCALE = 2.0f;
+		const float    VALENCE_BOOST_POWER = 0.5f;
+
+		float GetVertexScore(int cache_position, uint32_t remaining_triangles)
+		{
+			if (remaining_triangles == 0) {
+				return -1.0f;
+			}
+			float score = 0.0f;
+			if (cache_position >= 0) {
+				if (cache_position < 3) {
+					// The last triangle's vertices are scored down so the next one does not just reuse two of them
+					score = LAST_TRIANGLE_SCORE;
+				}
+				else {
+					float scaler = 1.0f / (SCORE_CACHE_SIZE - 3);
+					score = powf(1.0f - (cache_position - 3) * scaler, CACHE_DECAY_POWER);
+				}
+			}
+			// Vertices with few triangles left are finished first, so they drop out of the cache for good
+			score += VALENCE_BOOST_SCALE * powf(static_cast<float>(remaining_triangles), -VALENCE_BOOST_POWER);
+			return score;
+		}
+	}
+
+	Mesh DeduplicateVertices(const std::vector<float>& vertex_data)
+	{
+		Mesh mesh;
+		size_t vertex_count = vertex_data.size() / MESH_VERTEX_SIZE;
+		mesh.indices.reserve(vertex_count);
+
+		std::unordered_map<VertexKey, uint32_t, VertexKeyHash> unique_vertices;
+		unique_vertices.reserve(vertex_count);
+		for (size_t i = 0; i < vertex_count; ++i) {
+			VertexKey key = { &vertex_data[i * MESH_VERTEX_SIZE] };
+			uint32_t index = static_cast<uint32_t>(unique_vertices.size());
+			auto inserted = unique_vertices.insert(std::make_pair(key, index));
+			if (inserted.second) {
+				mesh.vertices.insert(mesh.vertices.end(), key.data, key.data + MESH_VERTEX_SIZE);
+			}
+			mesh.indices.push_back(inserted.first->second);
+		}
+		return mesh;
+	}
+
+	void OptimizeMesh(Mesh &mesh)
+	{
+		uint32_t vertex_count = static_cast<uint32_t>(mesh.vertices.size() / MESH_VERTEX_SIZE);
+		uint32_t triangle_count = static_cast<uint32_t>(mesh.indices.size() / 3);
+		if (triangle_count == 0) {
+			return;
+		}
+		for (size_t i = 0; i < triangle_count * 3; ++i) {
+			if (mesh.indices[i] >= vertex_count) {
+				return;
+			}
+		}
+
+		// Triangles of every vertex, stored contiguously
+		std::vector<uint32_t> remaining(vertex_count, 0);
+		for (size_t i = 0; i < triangle_count * 3; ++i) {
+			++remaining[mesh.indices[i]];
+		}
+		std::vector<uint32_t> first_triangle(vertex_count + 1, 0);
+		for (uint32_t i = 0; i < vertex_count; ++i) {
+			first_triangle[i + 1] = first_triangle[i] + remaining[i];
+		}
+		std::vector<uint32_t> vertex_triangles(triangle_count * 3);
+		std::vector<uint32_t> filled(first_triangle.begin(), first_triangle.end() - 1);
+		for (uint32_t i = 0; i < triangle_count * 3; ++i) {
+			vertex_triangles[filled[mesh.indices[i]]++] = i / 3;
+		}
+
+		std::vector<int> cache_position(vertex_count, -1);
+		std::vector<float> vertex_score(vertex_count);
+		for (uint32_t i = 0; i < vertex_count; ++i) {
+			vertex_score[i] = GetVertexScore(-1, remaining[i]);
+		}
+		std::vector<float> triangle_score(triangle_count);
+		for (uint32_t i = 0; i < triangle_count; ++i) {
+			const uint32_t *triangle = &mesh.indices[i * 3];
+			triangle_score[i] = vertex_score[triangle[0]] + vertex_score[triangle[1]] + vertex_score[triangle[2]];
+		}
+
+		std::vector<bool> emitted(triangle_count, false);
+		std::vector<uint32_t> optimized;
+		optimized.reserve(triangle_count * 3);
+		std::vector<uint32_t> cache;
+		std::vector<uint32_t> new_cache;
+		cache.reserve(SCORE_CACHE_SIZE + 3);
+		new_cache.reserve(SCORE_CACHE_SIZE + 3);
+		uint32_t scan_position = 0;
+
+		for (uint32_t emitted_count = 0; emitted_count < triangle_count; ++emitted_count) {
+			// The best candidate is almost always next to a cached vertex; only a
+			// fresh start needs the linear scan over the remaining triangles
+			int best_triangle = -1;
+			float best_score = -1.0f;
+			for (size_t i = 0; i < cache.size(); ++i) {
+				uint32_t vertex = cache[i];
+				for (uint32_t j = first_triangle[vertex]; j < first_triangle[vertex] + remaining[vertex]; ++j) {
+					uint32_t triangle = vertex_triangles[j];
+					if (triangle_score[triangle] > best_score) {
+						best_score = triangle_score[triangle];
+						best_triangle = static_cast<int>(triangle);
+					}
+				}
+			}
+			if (best_triangle < 0) {
+				while (emitted[scan_position]) {
+					++scan_position;
+				}
+				best_triangle = static_cast<int>(scan_position);
+				for (uint32_t i = scan_position; i < triangle_count; ++i) {
+					if (!emitted[i] && (triangle_score[i] > triangle_score[best_triangle])) {
+						best_triangle = static_cast<int>(i);
+					}
+				}
+			}
+
+			emitted[best_triangle] = true;
+			const uint32_t *triangle = &mesh.indices[best_triangle * 3];
+			new_cache.assign(triangle, triangle + 3);
+			for (int i = 0; i < 3; ++i) {
+				uint32_t vertex = triangle[i];
+				optimized.push_back(vertex);
+
+				// Drop the emitted triangle from the vertex's list of remaining ones
+				uint32_t begin = first_triangle[vertex];
+				uint32_t end = begin + remaining[vertex];
+				for (uint32_t j = begin; j < end; ++j) {
+					if (vertex_triangles[j] == static_cast<uint32_t>(best_triangle)) {
+						std::swap(vertex_triangles[j], vertex_triangles[end - 1]);
+						break;
+					}
+				}
+				--remaining[vertex];
+			}
+			for (size_t i = 0; i < cache.size(); ++i) {
+				if (std::find(triangle, triangle + 3, cache[i]) == triangle + 3) {
+					new_cache.push_back(cache[i]);
+				}
+			}
+			for (size_t i = SCORE_CACHE_SIZE; i < new_cache.size(); ++i) {
+				cache_position[new_cache[i]] = -1;
+				vertex_score[new_cache[i]] = GetVertexScore(-1, remaining[new_cache[i]]);
+			}
+			if (new_cache.size() > SCORE_CACHE_SIZE) {
+				new_cache.resize(SCORE_CACHE_SIZE);
+			}
+			cache.swap(new_cache);
+
+			for (size_t i = 0; i < cache.size(); ++i) {
+				cache_position[cache[i]] = static_cast<int>(i);
+				vertex_score[cache[i]] = GetVertexScore(static_cast<int>(i), remaining[cache[i]]);
+			}
+			for (size_t i = 0; i < cache.size(); ++i) {
+				uint32_t vertex = cache[i];
+				for (uint32_t j = first_triangle[vertex]; j < first_triangle[vertex] + remaining[vertex]; ++j) {
+					const uint32_t *other = &mesh.indices[vertex_triangles[j] * 3];
+					triangle_score[vertex_triangles[j]] = vertex_score[other[0]] + vertex_score[other[1]] + vertex_score[other[2]];
+				}
+			}
+		}
+
+		// Vertices follow the order of their first use, so fetches walk memory forwards
+		std::vector<uint32_t> remap(vertex_count, UINT32_MAX);
+		std::vector<float> vertices;
+		vertices.reserve(mesh.vertices.size());
+		for (size_t i = 0; i < optimized.size(); ++i) {
+			uint32_t vertex = optimized[i];
+			if (remap[vertex] == UINT32_MAX) {
+				remap[vertex] = static_cast<uint32_t>(vertices.size() / MESH_VERTEX_SIZE);
+				vertices.insert(vertices.end(), &mesh.vertices[vertex * MESH_VERTEX_SIZE], &mesh.vertices[vertex * MESH_VERTEX_SIZE] + MESH_VERTEX_SIZE);
+			}
+			optimized[i] = remap[vertex];
+		}
+		mesh.vertices.swap(vertices);
+		mesh.indices.swap(optimized);
+	}
+
+	float GetAverageCacheMissRatio(const Mesh &mesh, uint32_t cache_size)
+	{
+		size_t triangle_count = mesh.indices.size() / 3;
+		if ((triangle_count == 0) || (cache_size == 0)) {
+			return 0.0f;
+		}
+		std::vector<uint32_t> fifo(cache_size, UINT32_MAX);
+		size_t head = 0;
+		size_t misses = 0;
+		for (size_t i = 0; i < triangle_count * 3; ++i) {
+			if (std::find(fifo.begin(), fifo.end(), mesh.indices[i]) == fifo.end()) {
+				fifo[head] = mesh.indices[i];
+				head = (head + 1) % cache_size;
+				++misses;
+			}
+		}
+		return static_cast<float>(misses) / triangle_count;
+	}
+}
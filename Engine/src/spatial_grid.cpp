@@ -0,0 +1,236 @@
+#include "spatial_grid.h"
+#include <algorithm>
+
+namespace HelloEngine
+{
+	namespace
+	{
+		bool Overlaps(const CullRect &a, const CullRect &b)
+		{
+			return (a.right >= b.left) && (a.left <= b.right) && (a.bottom >= b.top) && (a.top <= b.bottom);
+		}
+	}
+
+	SpatialGrid::SpatialGrid() :
+		m_World(),
+		m_InverseCellSize(0.0f),
+		m_Columns(0),
+		m_Rows(0),
+		m_StaticCellStart(),
+		m_StaticCellObjects(),
+		m_StaticIds(),
+		m_StaticBounds(),
+		m_DynamicCells(),
+		m_DynamicObjects()
+	{
+	}
+
+	void SpatialGrid::Initialize(const CullRect &world, float cell_size)
+	{
+		m_World = world;
+		m_InverseCellSize = 1.0f / cell_size;
+		m_Columns = std::max(1u, static_cast<uint32_t>((world.right - world.left) * m_InverseCellSize + 0.999f));
+		m_Rows = std::max(1u, static_cast<uint32_t>((world.bottom - world.top) * m_InverseCellSize + 0.999f));
+		m_StaticCellStart.assign(m_Columns * m_Rows + 1, 0);
+		m_StaticCellObjects.clear();
+		m_StaticIds.clear();
+		m_StaticBounds.clear();
+		m_DynamicCells.assign(m_Columns * m_Rows, std::vector<uint32_t>());
+		m_DynamicObjects.clear();
+	}
+
+	uint32_t SpatialGrid::GetCellX(float x) const
+	{
+		float column = (x - m_World.left) * m_InverseCellSize;
+		return (column <= 0.0f) ? 0 : std::min(static_cast<uint32_t>(column), m_Columns - 1);
+	}
+
+	uint32_t SpatialGrid::GetCellY(float y) const
+	{
+		float row = (y - m_World.top) * m_InverseCellSize;
+		return (row <= 0.0f) ? 0 : std::min(static_cast<uint32_t>(row), m_Rows - 1);
+	}
+
+	SpatialGrid::CellRange SpatialGrid::GetCellRange(const CullRect &bounds) const
+	{
+		CellRange cells = { GetCellX(bounds.left), GetCellY(bounds.top), GetCellX(bounds.right), GetCellY(bounds.bottom) };
+		return cells;
+	}
+
+	void SpatialGrid::Build(const uint32_t *ids, const CullRect *bounds, size_t count)
+	{
+		m_StaticIds.assign(ids, ids + count);
+		m_StaticBounds.assign(bounds, bounds + count);
+
+		// Counting sort of objects into cells, every cell's list ends where the next one starts
+		std::fill(m_StaticCellStart.begin(), m_StaticCellStart.end(), 0);
+		for (size_t i = 0; i < count; ++i) {
+			CellRange cells = GetCellRange(bounds[i]);
+			for (uint32_t y = cells.top; y <= cells.bottom; ++y) {
+				for (uint32_t x = cells.left; x <= cells.right; ++x) {
+					++m_StaticCellStart[y * m_Columns + x + 1];
+				}
+			}
+		}
+		for (size_t i = 1; i < m_StaticCellStart.size(); ++i) {
+			m_StaticCellStart[i] += m_StaticCellStart[i - 1];
+		}
+		m_StaticCellObjects.resize(m_StaticCellStart.back());
+		std::vector<uint32_t> cell_fill(m_StaticCellStart.begin(), m_StaticCellStart.end() - 1);
+		for (size_t i = 0; i < count; ++i) {
+			CellRange cells = GetCellRange(bounds[i]);
+			for (uint32_t y = cells.top; y <= cells.bottom; ++y) {
+				for (uint32_t x = cells.left; x <= cells.right; ++x) {
+					m_StaticCellObjects[cell_fill[y * m_Columns + x]++] = static_cast<uint32_t>(i);
+				}
+			}
+		}
+	}
+
+	void SpatialGrid::AddToCells(uint32_t id, const CellRange &cells)
+	{
+		for (uint32_t y = cells.top; y <= cells.bottom; ++y) {
+			for (uint32_t x = cells.left; x <= cells.right; ++x) {
+				m_DynamicCells[y * m_Columns + x].push_back(id);
+			}
+		}
+	}
+
+	void SpatialGrid::RemoveFromCells(uint32_t id, const CellRange &cells)
+	{
+		for (uint32_t y = cells.top; y <= cells.bottom; ++y) {
+			for (uint32_t x = cells.left; x <= cells.right; ++x) {
+				std::vector<uint32_t> &cell = m_DynamicCells[y * m_Columns + x];
+				std::vector<uint32_t>::iterator it = std::find(cell.begin(), cell.end(), id);
+				if (it != cell.end()) {
+					*it = cell.back();
+					cell.pop_back();
+				}
+			}
+		}
+	}
+
+	void SpatialGrid::Insert(uint32_t id, const CullRect &bounds)
+	{
+		if (id >= m_DynamicObjects.size()) {
+			DynamicObject empty = {};
+			m_DynamicObjects.resize(id + 1, empty);
+		}
+		if (m_DynamicObjects[id].inserted) {
+			Update(id, bounds);
+			return;
+		}
+		DynamicObject &object = m_DynamicObjects[id];
+		object.bounds = bounds;
+		object.cells = GetCellRange(bounds);
+		object.inserted = true;
+		AddToCells(id, object.cells);
+	}
+
+	void SpatialGrid::Update(uint32_t id, const CullRect &bounds)
+	{
+		if ((id >= m_DynamicObjects.size()) || !m_DynamicObjects[id].inserted) {
+			Insert(id, bounds);
+			return;
+		}
+		// Most moves stay within the same cells and only change the stored bounds
+		DynamicObject &object = m_DynamicObjects[id];
+		CellRange cells = GetCellRange(bounds);
+		object.bounds = bounds;
+		if ((cells.left != object.cells.left) || (cells.top != object.cells.top) ||
+			(cells.right != object.cells.right) || (cells.bottom != object.cells.bottom)) {
+			RemoveFromCells(id, object.cells);
+			AddToCells(id, cells);
+			object.cells = cells;
+		}
+	}
+
+	void SpatialGrid::Remove(uint32_t id)
+	{
+		if ((id >= m_DynamicObjects.size()) || !m_DynamicObjects[id].inserted) {
+			return;
+		}
+		RemoveFromCells(id, m_DynamicObjects[id].cells);
+		m_DynamicObjects[id].inserted = false;
+	}
+
+	template<typename Visitor>
+	void SpatialGrid::Visit(const CullRect &rect, Visitor visitor) const
+	{
+		if (m_Columns == 0) {
+			return;
+		}
+		// An object covering several cells is reported only from the cell holding
+		// the top left corner of its overlap with rect, so no visited set is needed
+		CellRange cells = GetCellRange(rect);
+		for (uint32_t y = cells.top; y <= cells.bottom; ++y) {
+			for (uint32_t x = cells.left; x <= cells.right; ++x) {
+				uint32_t cell = y * m_Columns + x;
+				for (uint32_t i = m_StaticCellStart[cell]; i < m_StaticCellStart[cell + 1]; ++i) {
+					const CullRect &bounds = m_StaticBounds[m_StaticCellObjects[i]];
+					if (Overlaps(bounds, rect) &&
+						(GetCellX(std::max(bounds.left, rect.left)) == x) && (GetCellY(std::max(bounds.top, rect.top)) == y)) {
+						visitor(m_StaticIds[m_StaticCellObjects[i]], bounds);
+					}
+				}
+				const std::vector<uint32_t> &dynamic_cell = m_DynamicCells[cell];
+				for (size_t i = 0; i < dynamic_cell.size(); ++i) {
+					const CullRect &bounds = m_DynamicObjects[dynamic_cell[i]].bounds;
+					if (Overlaps(bounds, rect) &&
+						(GetCellX(std::max(bounds.left, rect.left)) == x) && (GetCellY(std::max(bounds.top, rect.top)) == y)) {
+						visitor(dynamic_cell[i], bounds);
+					}
+				}
+			}
+		}
+	}
+
+	size_t SpatialGrid::QueryRect(const CullRect &rect, uint32_t *ids, size_t max_count) const
+	{
+		size_t count = 0;
+		Visit(rect, [&](uint32_t id, const CullRect &) {
+			if (count < max_count) {
+				ids[count] = id;
+			}
+			++count;
+		});
+		return count;
+	}
+
+	size_t SpatialGrid::QueryPoint(float x, float y, uint32_t *ids, size_t max_count) const
+	{
+		CullRect point = { x, y, x, y };
+		return QueryRect(point, ids, max_count);
+	}
+
+	size_t SpatialGrid::QueryRadius(float x, float y, float radius, uint32_t *ids, size_t max_count) const
+	{
+		CullRect rect = { x - radius, y - radius, x + radius, y + radius };
+		size_t count = 0;
+		Visit(rect, [&](uint32_t id, const CullRect &bounds) {
+			float dx = x - std::max(bounds.left, std::min(x, bounds.right));
+			float dy = y - std::max(bounds.top, std::min(y, bounds.bottom));
+			if (dx * dx + dy * dy > radius * radius) {
+				return;
+			}
+			if (count < max_count) {
+				ids[count] = id;
+			}
+			++count;
+		});
+		return count;
+	}
+
+	bool SpatialGrid::Pick(float x, float y, uint32_t &id) const
+	{
+		CullRect point = { x, y, x, y };
+		bool found = false;
+		Visit(point, [&](uint32_t object_id, const CullRect &) {
+			if (!found || (object_id > id)) {
+				id = object_id;
+				found = true;
+			}
+		});
+		return found;
+	}
+}
@@ -0,0 +1,290 @@
+#include "sprite_culling.h"
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SPRITE_CULLING_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_AVX
+#else
+#define TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+
+namespace HelloEngine
+{
+	namespace
+	{
+		// Chunks start on a multiple of the widest kernel, so only the last one has a scalar tail
+		const size_t SIMD_WIDTH = 8;
+
+		// Reference implementation, also used for the tails of the vector kernels
+		size_t CullScalar(const CullRect &view, const float *left, const float *top, const float *right, const float *bottom,
+			size_t begin, size_t end, uint32_t *visible)
+		{
+			size_t count = 0;
+			for (size_t i = begin; i < end; ++i) {
+				if ((right[i] >= view.left) && (left[i] <= view.right) && (bottom[i] >= view.top) && (top[i] <= view.bottom)) {
+					visible[count++] = static_cast<uint32_t>(i);
+				}
+			}
+			return count;
+		}
+
+#ifdef SPRITE_CULLING_X86
+		// Every lane is written and the output only advances past visible ones, which avoids a branch per sprite
+		size_t CullSse(const CullRect &view, const float *left, const float *top, const float *right, const float *bottom,
+			size_t begin, size_t end, uint32_t *visible)
+		{
+			const __m128 view_left = _mm_set1_ps(view.left);
+			const __m128 view_top = _mm_set1_ps(view.top);
+			const __m128 view_right = _mm_set1_ps(view.right);
+			const __m128 view_bottom = _mm_set1_ps(view.bottom);
+			size_t count = 0;
+			size_t i = begin;
+			for (; i + 4 <= end; i += 4) {
+				__m128 inside = _mm_and_ps(
+					_mm_and_ps(_mm_cmpge_ps(_mm_loadu_ps(right + i), view_left), _mm_cmple_ps(_mm_loadu_ps(left + i), view_right)),
+					_mm_and_ps(_mm_cmpge_ps(_mm_loadu_ps(bottom + i), view_top), _mm_cmple_ps(_mm_loadu_ps(top + i), view_bottom)));
+				int mask = _mm_movemask_ps(inside);
+				if (mask == 0) {
+					continue;
+				}
+				for (uint32_t lane = 0; lane < 4; ++lane) {
+					visible[count] = static_cast<uint32_t>(i + lane);
+					count += (mask >> lane) & 1;
+				}
+			}
+			return count + CullScalar(view, left, top, right, bottom, i, end, visible + count);
+		}
+
+		TARGET_AVX size_t CullAvx(const CullRect &view, const float *left, const float *top, const float *right, const float *bottom,
+			size_t begin, size_t end, uint32_t *visible)
+		{
+			const __m256 view_left = _mm256_set1_ps(view.left);
+			const __m256 view_top = _mm256_set1_ps(view.top);
+			const __m256 view_right = _mm256_set1_ps(view.right);
+			const __m256 view_bottom = _mm256_set1_ps(view.bottom);
+			size_t count = 0;
+			size_t i = begin;
+			for (; i + 8 <= end; i += 8) {
+				__m256 inside = _mm256_and_ps(
+					_mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(right + i), view_left, _CMP_GE_OQ), _mm256_cmp_ps(_mm256_loadu_ps(left + i), view_right, _CMP_LE_OQ)),
+					_mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(bottom + i), view_top, _CMP_GE_OQ), _mm256_cmp_ps(_mm256_loadu_ps(top + i), view_bottom, _CMP_LE_OQ)));
+				int mask = _mm256_movemask_ps(inside);
+				if (mask == 0) {
+					continue;
+				}
+				for (uint32_t lane = 0; lane < 8; ++lane) {
+					visible[count] = static_cast<uint32_t>(i + lane);
+					count += (mask >> lane) & 1;
+				}
+			}
+			return count + CullScalar(view, left, top, right, bottom, i, end, visible + count);
+		}
+
+		bool DetectAvx()
+		{
+#if defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 1);
+			bool os_saves_ymm = ((info[2] & (1 << 27)) != 0) && ((_xgetbv(0) & 6) == 6);
+			return os_saves_ymm && ((info[2] & (1 << 28)) != 0);
+#else
+			return __builtin_cpu_supports("avx");
+#endif
+		}
+#endif
+	}
+
+	// Threads kept alive between culls, so a frame only pays for waking them up.
+	// Run() hands task indices 1 and up to the workers and runs index 0 itself.
+	class CullWorkers {
+	public:
+		CullWorkers();
+		~CullWorkers();
+
+		void					Run(size_t task_count, const std::function<void(size_t)> &task);
+	private:
+		void					WorkerLoop(size_t index, uint64_t generation);
+
+		std::vector<std::thread>				m_Threads;
+		std::mutex								m_Mutex;
+		std::condition_variable					m_WorkReady;
+		std::condition_variable					m_WorkDone;
+		const std::function<void(size_t)>	   *m_Task;
+		size_t									m_TaskCount;
+		size_t									m_Remaining;
+		uint64_t								m_Generation;
+		bool									m_Quit;
+	};
+
+	CullWorkers::CullWorkers() :
+		m_Threads(),
+		m_Mutex(),
+		m_WorkReady(),
+		m_WorkDone(),
+		m_Task(nullptr),
+		m_TaskCount(0),
+		m_Remaining(0),
+		m_Generation(0),
+		m_Quit(false)
+	{
+	}
+
+	CullWorkers::~CullWorkers()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Quit = true;
+		}
+		m_WorkReady.notify_all();
+		for (size_t i = 0; i < m_Threads.size(); ++i) {
+			m_Threads[i].join();
+		}
+	}
+
+	void CullWorkers::Run(size_t task_count, const std::function<void(size_t)> &task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			// New workers start from the current generation, so they pick up this run and not an older one
+			while (m_Threads.size() + 1 < task_count) {
+				m_Threads.push_back(std::thread(&CullWorkers::WorkerLoop, this, m_Threads.size() + 1, m_Generation));
+			}
+			m_Task = &task;
+			m_TaskCount = task_count;
+			m_Remaining = task_count - 1;
+			++m_Generation;
+		}
+		m_WorkReady.notify_all();
+
+		task(0);
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_WorkDone.wait(lock, [this]() { return m_Remaining == 0; });
+		m_Task = nullptr;
+	}
+
+	void CullWorkers::WorkerLoop(size_t index, uint64_t generation)
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		while (true) {
+			m_WorkReady.wait(lock, [&]() { return m_Quit || (m_Generation != generation); });
+			if (m_Quit) {
+				return;
+			}
+			generation = m_Generation;
+			// Runs needing fewer threads leave the rest of them asleep
+			if (index >= m_TaskCount) {
+				continue;
+			}
+			const std::function<void(size_t)> *task = m_Task;
+			lock.unlock();
+			(*task)(index);
+			lock.lock();
+			if (--m_Remaining == 0) {
+				m_WorkDone.notify_one();
+			}
+		}
+	}
+
+	bool IsAvxCullingSupported()
+	{
+#ifdef SPRITE_CULLING_X86
+		static const bool supported = DetectAvx();
+		return supported;
+#else
+		return false;
+#endif
+	}
+
+	SpriteBounds::SpriteBounds() :
+		m_Left(),
+		m_Top(),
+		m_Right(),
+		m_Bottom(),
+		m_Workers()
+	{
+	}
+
+	SpriteBounds::~SpriteBounds()
+	{
+	}
+
+	void SpriteBounds::Resize(size_t count)
+	{
+		m_Left.resize(count);
+		m_Top.resize(count);
+		m_Right.resize(count);
+		m_Bottom.resize(count);
+	}
+
+	void SpriteBounds::Clear()
+	{
+		Resize(0);
+	}
+
+	size_t SpriteBounds::GetCount() const
+	{
+		return m_Left.size();
+	}
+
+	size_t SpriteBounds::CullRange(const CullRect &view, size_t begin, size_t end, uint32_t *visible, CullMethod method) const
+	{
+#ifdef SPRITE_CULLING_X86
+		if (method == CullMethod::Simd) {
+			if (IsAvxCullingSupported()) {
+				return CullAvx(view, &m_Left[0], &m_Top[0], &m_Right[0], &m_Bottom[0], begin, end, visible);
+			}
+			return CullSse(view, &m_Left[0], &m_Top[0], &m_Right[0], &m_Bottom[0], begin, end, visible);
+		}
+#endif
+		return CullScalar(view, &m_Left[0], &m_Top[0], &m_Right[0], &m_Bottom[0], begin, end, visible);
+	}
+
+	void SpriteBounds::Cull(const CullRect &view, std::vector<uint32_t> &visible, const CullSettings &settings) const
+	{
+		size_t count = GetCount();
+		// Sized for the worst case up front, kernels write without bounds checks
+		visible.resize(count);
+		if (count == 0) {
+			return;
+		}
+
+		size_t chunk_size = std::max<size_t>(settings.chunkSize, SIMD_WIDTH) / SIMD_WIDTH * SIMD_WIDTH;
+		size_t chunk_count = (count + chunk_size - 1) / chunk_size;
+		size_t thread_count = std::min<size_t>(settings.threadCount, chunk_count);
+		if (thread_count <= 1) {
+			visible.resize(CullRange(view, 0, count, &visible[0], settings.method));
+			return;
+		}
+
+		// Every chunk compacts into its own slice of the output, the slices are joined afterwards
+		std::vector<size_t> chunk_visible(chunk_count);
+		std::function<void(size_t)> cull_chunks = [&](size_t first_chunk) {
+			for (size_t chunk = first_chunk; chunk < chunk_count; chunk += thread_count) {
+				size_t begin = chunk * chunk_size;
+				size_t end = std::min(begin + chunk_size, count);
+				chunk_visible[chunk] = CullRange(view, begin, end, &visible[begin], settings.method);
+			}
+		};
+		if (!m_Workers) {
+			m_Workers.reset(new CullWorkers());
+		}
+		m_Workers->Run(thread_count, cull_chunks);
+
+		size_t visible_count = chunk_visible[0];
+		for (size_t chunk = 1; chunk < chunk_count; ++chunk) {
+			memmove(&visible[visible_count], &visible[chunk * chunk_size], chunk_visible[chunk] * sizeof(uint32_t));
+			visible_count += chunk_visible[chunk];
+		}
+		visible.resize(visible_count);
+	}
+}
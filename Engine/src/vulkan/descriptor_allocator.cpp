@@ -0,0 +1,283 @@
+#ifdef USE_RENDER_VULKAN
+#include "descriptor_allocator.h"
+#include <algorithm>
+#include <iostream>
+
+namespace HelloEngine
+{
+	// The first pool of a list holds this many sets, each following one twice as many up to the limit
+	static const uint32_t DESCRIPTOR_POOL_BASE_SETS = 16;
+	static const uint32_t DESCRIPTOR_POOL_MAX_SETS = 1024;
+
+	// Descriptors of each type reserved per set; enough for the mesh, sprite and culling layouts
+	static const VkDescriptorPoolSize DESCRIPTOR_POOL_RATIOS[] = {
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 }
+	};
+
+	// FNV-1a over the raw bytes of each field; image infos end in padding, so they are hashed member by member
+	template<class T>
+	static void HashValue(uint64_t &hash, const T &value)
+	{
+		const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&value);
+		for (size_t i = 0; i < sizeof(value); ++i) {
+			hash = (hash ^ bytes[i]) * 1099511628211ULL;
+		}
+	}
+
+	DescriptorSetDesc::DescriptorSetDesc(VkDescriptorSetLayout set_layout) :
+		layout(set_layout),
+		bindings()
+	{
+	}
+
+	void DescriptorSetDesc::AddImage(uint32_t binding, VkDescriptorType type, VkSampler sampler, VkImageView view, VkImageLayout image_layout)
+	{
+		Binding image_binding = {
+			binding,
+			type,
+			{ sampler, view, image_layout },
+			{ VK_NULL_HANDLE, 0, 0 }
+		};
+		bindings.push_back(image_binding);
+	}
+
+	void DescriptorSetDesc::AddBuffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		Binding buffer_binding = {
+			binding,
+			type,
+			{ VK_NULL_HANDLE, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED },
+			{ buffer, offset, range }
+		};
+		bindings.push_back(buffer_binding);
+	}
+
+	uint64_t DescriptorSetDesc::GetHash() const
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		HashValue(hash, layout);
+		for (size_t i = 0; i < bindings.size(); ++i) {
+			HashValue(hash, bindings[i].binding);
+			HashValue(hash, bindings[i].type);
+			HashValue(hash, bindings[i].image.sampler);
+			HashValue(hash, bindings[i].image.imageView);
+			HashValue(hash, bindings[i].image.imageLayout);
+			HashValue(hash, bindings[i].buffer.buffer);
+			HashValue(hash, bindings[i].buffer.offset);
+			HashValue(hash, bindings[i].buffer.range);
+		}
+		return hash;
+	}
+
+	bool DescriptorSetDesc::operator==(const DescriptorSetDesc &other) const
+	{
+		if ((layout != other.layout) || (bindings.size() != other.bindings.size())) {
+			return false;
+		}
+		for (size_t i = 0; i < bindings.size(); ++i) {
+			const Binding &left = bindings[i];
+			const Binding &right = other.bindings[i];
+			if ((left.binding != right.binding) ||
+				(left.type != right.type) ||
+				(left.image.sampler != right.image.sampler) ||
+				(left.image.imageView != right.image.imageView) ||
+				(left.image.imageLayout != right.image.imageLayout) ||
+				(left.buffer.buffer != right.buffer.buffer) ||
+				(left.buffer.offset != right.buffer.offset) ||
+				(left.buffer.range != right.buffer.range)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	DescriptorAllocator::DescriptorAllocator() :
+		m_Device(nullptr),
+		m_PersistentPools(),
+		m_FramePools(),
+		m_FrameIndex(0),
+		m_CachedSets(),
+		m_CachedSetsByHash(),
+		m_CacheHits(0)
+	{
+	}
+
+	DescriptorAllocator::~DescriptorAllocator()
+	{
+		Destroy();
+	}
+
+	void DescriptorAllocator::Initialize(VkDevice device, uint32_t frame_count)
+	{
+		m_Device = device;
+		m_FramePools.resize(frame_count);
+		m_FrameIndex = 0;
+	}
+
+	void DescriptorAllocator::Destroy()
+	{
+		DestroyList(m_PersistentPools);
+		for (size_t i = 0; i < m_FramePools.size(); ++i) {
+			DestroyList(m_FramePools[i]);
+		}
+		m_FramePools.clear();
+		m_CachedSets.clear();
+		m_CachedSetsByHash.clear();
+	}
+
+	void DescriptorAllocator::BeginFrame(uint32_t frame_index)
+	{
+		// The caller has waited for the last frame that used these pools
+		m_FrameIndex = frame_index;
+		PoolList &list = m_FramePools[m_FrameIndex];
+		for (size_t i = 0; (i <= list.current) && (i < list.pools.size()); ++i) {
+			vkResetDescriptorPool(m_Device, list.pools[i], 0);
+		}
+		list.current = 0;
+	}
+
+	bool DescriptorAllocator::Allocate(VkDescriptorSetLayout layout, VkDescriptorSet &set)
+	{
+		return AllocateFromList(m_PersistentPools, layout, set);
+	}
+
+	bool DescriptorAllocator::AllocateFrameSet(VkDescriptorSetLayout layout, VkDescriptorSet &set)
+	{
+		return AllocateFromList(m_FramePools[m_FrameIndex], layout, set);
+	}
+
+	bool DescriptorAllocator::GetCachedSet(const DescriptorSetDesc &desc, VkDescriptorSet &set)
+	{
+		uint64_t hash = desc.GetHash();
+		typedef std::unordered_multimap<uint64_t, uint32_t>::const_iterator HashIterator;
+		std::pair<HashIterator, HashIterator> range = m_CachedSetsByHash.equal_range(hash);
+		for (HashIterator it = range.first; it != range.second; ++it) {
+			if (m_CachedSets[it->second].desc == desc) {
+				++m_CacheHits;
+				set = m_CachedSets[it->second].set;
+				return true;
+			}
+		}
+
+		if (!Allocate(desc.layout, set)) {
+			return false;
+		}
+		// Written exactly once; buffer and image infos are addressed by index into these arrays
+		std::vector<VkWriteDescriptorSet> descriptor_writes(desc.bindings.size());
+		for (size_t i = 0; i < desc.bindings.size(); ++i) {
+			const DescriptorSetDesc::Binding &binding = desc.bindings[i];
+			bool is_image = binding.image.imageView != VK_NULL_HANDLE;
+			descriptor_writes[i] = {
+				VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,             // VkStructureType                sType
+				nullptr,                                            // const void                    *pNext
+				set,                                                // VkDescriptorSet                dstSet
+				binding.binding,                                    // uint32_t                       dstBinding
+				0,                                                  // uint32_t                       dstArrayElement
+				1,                                                  // uint32_t                       descriptorCount
+				binding.type,                                       // VkDescriptorType               descriptorType
+				is_image ? &binding.image : nullptr,                // const VkDescriptorImageInfo   *pImageInfo
+				is_image ? nullptr : &binding.buffer,               // const VkDescriptorBufferInfo  *pBufferInfo
+				nullptr                                             // const VkBufferView            *pTexelBufferView
+			};
+		}
+		if (!descriptor_writes.empty()) {
+			vkUpdateDescriptorSets(m_Device, static_cast<uint32_t>(descriptor_writes.size()), &descriptor_writes[0], 0, nullptr);
+		}
+
+		CachedSet cached_set = { desc, set };
+		m_CachedSetsByHash.insert(std::make_pair(hash, static_cast<uint32_t>(m_CachedSets.size())));
+		m_CachedSets.push_back(cached_set);
+		return true;
+	}
+
+	uint32_t DescriptorAllocator::GetPoolCount() const
+	{
+		size_t count = m_PersistentPools.pools.size();
+		for (size_t i = 0; i < m_FramePools.size(); ++i) {
+			count += m_FramePools[i].pools.size();
+		}
+		return static_cast<uint32_t>(count);
+	}
+
+	uint32_t DescriptorAllocator::GetCachedSetCount() const
+	{
+		return static_cast<uint32_t>(m_CachedSets.size());
+	}
+
+	uint64_t DescriptorAllocator::GetCacheHitCount() const
+	{
+		return m_CacheHits;
+	}
+
+	bool DescriptorAllocator::AllocateFromList(PoolList &list, VkDescriptorSetLayout layout, VkDescriptorSet &set)
+	{
+		VkDescriptorSetAllocateInfo descriptor_set_allocate_info = {
+			VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,     // VkStructureType                sType
+			nullptr,                                            // const void                    *pNext
+			VK_NULL_HANDLE,                                     // VkDescriptorPool               descriptorPool
+			1,                                                  // uint32_t                       descriptorSetCount
+			&layout                                             // const VkDescriptorSetLayout   *pSetLayouts
+		};
+
+		// An exhausted pool is left behind for good (or until its frame comes around again);
+		// a pool that was just created failing means the layout itself cannot be allocated
+		while (true) {
+			bool new_pool = false;
+			if (list.current == list.pools.size()) {
+				uint32_t max_sets = std::min(DESCRIPTOR_POOL_BASE_SETS << std::min<size_t>(list.pools.size(), 6), DESCRIPTOR_POOL_MAX_SETS);
+				VkDescriptorPool pool;
+				if (!CreatePool(max_sets, pool)) {
+					return false;
+				}
+				list.pools.push_back(pool);
+				new_pool = true;
+			}
+			descriptor_set_allocate_info.descriptorPool = list.pools[list.current];
+			if (vkAllocateDescriptorSets(m_Device, &descriptor_set_allocate_info, &set) == VK_SUCCESS) {
+				return true;
+			}
+			if (new_pool) {
+				std::cout << "Could not allocate descriptor set!" << std::endl;
+				return false;
+			}
+			++list.current;
+		}
+	}
+
+	bool DescriptorAllocator::CreatePool(uint32_t max_sets, VkDescriptorPool &pool) const
+	{
+		const uint32_t type_count = sizeof(DESCRIPTOR_POOL_RATIOS) / sizeof(DESCRIPTOR_POOL_RATIOS[0]);
+		VkDescriptorPoolSize pool_sizes[type_count];
+		for (uint32_t i = 0; i < type_count; ++i) {
+			pool_sizes[i].type = DESCRIPTOR_POOL_RATIOS[i].type;
+			pool_sizes[i].descriptorCount = DESCRIPTOR_POOL_RATIOS[i].descriptorCount * max_sets;
+		}
+
+		VkDescriptorPoolCreateInfo descriptor_pool_create_info = {
+			VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,      // VkStructureType                sType
+			nullptr,                                            // const void                    *pNext
+			0,                                                  // VkDescriptorPoolCreateFlags    flags
+			max_sets,                                           // uint32_t                       maxSets
+			type_count,                                         // uint32_t                       poolSizeCount
+			pool_sizes                                          // const VkDescriptorPoolSize    *pPoolSizes
+		};
+		if (vkCreateDescriptorPool(m_Device, &descriptor_pool_create_info, nullptr, &pool) != VK_SUCCESS) {
+			std::cout << "Could not create descriptor pool!" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	void DescriptorAllocator::DestroyList(PoolList &list)
+	{
+		for (size_t i = 0; i < list.pools.size(); ++i) {
+			vkDestroyDescriptorPool(m_Device, list.pools[i], nullptr);
+		}
+		list.pools.clear();
+		list.current = 0;
+	}
+}
+#endif
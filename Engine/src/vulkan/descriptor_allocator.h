@@ -0,0 +1,83 @@
+#ifdef USE_RENDER_VULKAN
+#ifndef DESCRIPTOR_ALLOCATOR_H
+#define DESCRIPTOR_ALLOCATOR_H
+#pragma once
+#include <unordered_map>
+#include <vector>
+#include "vulkan_functions.h"
+
+namespace HelloEngine
+{
+	// Contents of a descriptor set that is written once and never changed:
+	// its layout and the resource behind every binding.
+	struct DescriptorSetDesc {
+		struct Binding {
+			uint32_t                binding;
+			VkDescriptorType        type;
+			VkDescriptorImageInfo   image;
+			VkDescriptorBufferInfo  buffer;
+		};
+
+		VkDescriptorSetLayout       layout;
+		std::vector<Binding>        bindings;
+
+		explicit DescriptorSetDesc(VkDescriptorSetLayout set_layout = VK_NULL_HANDLE);
+
+		void     AddImage(uint32_t binding, VkDescriptorType type, VkSampler sampler, VkImageView view, VkImageLayout image_layout);
+		void     AddBuffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+		uint64_t GetHash() const;
+		bool     operator==(const DescriptorSetDesc &other) const;
+	};
+
+	// Hands out descriptor sets from pools that are created as they run out,
+	// each one larger than the last. Sets live in one of two places:
+	// - persistent pools, for sets that stay valid until Destroy(); the ones
+	//   described by a DescriptorSetDesc are cached, so asking for the same
+	//   bindings again returns the same set without another update,
+	// - per frame pools, reset as a whole by BeginFrame() once the frame that
+	//   used them has finished, instead of freeing every set on its own.
+	class DescriptorAllocator {
+	public:
+		DescriptorAllocator();
+		~DescriptorAllocator();
+
+		void					Initialize(VkDevice device, uint32_t frame_count);
+		void					Destroy();
+		void					BeginFrame(uint32_t frame_index);
+		bool					Allocate(VkDescriptorSetLayout layout, VkDescriptorSet &set);
+		bool					AllocateFrameSet(VkDescriptorSetLayout layout, VkDescriptorSet &set);
+		bool					GetCachedSet(const DescriptorSetDesc &desc, VkDescriptorSet &set);
+		uint32_t				GetPoolCount() const;
+		uint32_t				GetCachedSetCount() const;
+		uint64_t				GetCacheHitCount() const;
+	private:
+		struct PoolList {
+			std::vector<VkDescriptorPool>  pools;
+			size_t                         current;
+
+			PoolList() :
+				pools(),
+				current(0) {
+			}
+		};
+
+		struct CachedSet {
+			DescriptorSetDesc              desc;
+			VkDescriptorSet                set;
+		};
+
+		bool					AllocateFromList(PoolList &list, VkDescriptorSetLayout layout, VkDescriptorSet &set);
+		bool					CreatePool(uint32_t max_sets, VkDescriptorPool &pool) const;
+		void					DestroyList(PoolList &list);
+
+		VkDevice										m_Device;
+		PoolList										m_PersistentPools;
+		std::vector<PoolList>							m_FramePools;
+		uint32_t										m_FrameIndex;
+		std::vector<CachedSet>							m_CachedSets;
+		std::unordered_multimap<uint64_t, uint32_t>		m_CachedSetsByHash;
+		uint64_t										m_CacheHits;
+	};
+}
+#endif
+#endif
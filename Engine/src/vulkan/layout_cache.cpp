@@ -0,0 +1,170 @@
+#ifdef USE_RENDER_VULKAN
+#include "layout_cache.h"
+#include <algorithm>
+#include <iostream>
+
+namespace HelloEngine
+{
+	LayoutCache::LayoutCache() :
+		m_Device(nullptr),
+		m_DescriptorSetLayouts(),
+		m_PipelineLayouts(),
+		m_SharedCount(0)
+	{
+	}
+
+	LayoutCache::~LayoutCache()
+	{
+		Destroy();
+	}
+
+	void LayoutCache::Initialize(VkDevice device)
+	{
+		m_Device = device;
+	}
+
+	void LayoutCache::Destroy()
+	{
+		for (std::map<LayoutKey, VkPipelineLayout>::iterator it = m_PipelineLayouts.begin(); it != m_PipelineLayouts.end(); ++it) {
+			vkDestroyPipelineLayout(m_Device, it->second, nullptr);
+		}
+		m_PipelineLayouts.clear();
+		for (std::map<LayoutKey, VkDescriptorSetLayout>::iterator it = m_DescriptorSetLayouts.begin(); it != m_DescriptorSetLayouts.end(); ++it) {
+			vkDestroyDescriptorSetLayout(m_Device, it->second, nullptr);
+		}
+		m_DescriptorSetLayouts.clear();
+	}
+
+	bool LayoutCache::GetLayout(const ShaderReflection *const *stages, uint32_t stage_count, bool dynamic_uniform_buffers, ReflectedLayout &layout)
+	{
+		// Bindings declared by several stages are merged into one visible to all of them
+		std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>> sets;
+		VkPushConstantRange push_constant_range = { 0, 0, 0 };
+		for (uint32_t i = 0; i < stage_count; ++i) {
+			const std::vector<ReflectedBinding> &bindings = stages[i]->GetBindings();
+			for (size_t j = 0; j < bindings.size(); ++j) {
+				VkDescriptorSetLayoutBinding binding = bindings[j].binding;
+				if (dynamic_uniform_buffers && (binding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)) {
+					binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+				}
+				std::vector<VkDescriptorSetLayoutBinding> &set = sets[bindings[j].set];
+				size_t k = 0;
+				while ((k < set.size()) && (set[k].binding != binding.binding)) {
+					++k;
+				}
+				if (k == set.size()) {
+					set.push_back(binding);
+				}
+				else if ((set[k].descriptorType != binding.descriptorType) || (set[k].descriptorCount != binding.descriptorCount)) {
+					std::cout << "Shader stages disagree on set " << bindings[j].set << " binding " << binding.binding << "!" << std::endl;
+					return false;
+				}
+				else {
+					set[k].stageFlags |= binding.stageFlags;
+				}
+			}
+			// One range covering the largest block, visible to every stage using push constants
+			if (stages[i]->GetPushConstantSize() != 0) {
+				push_constant_range.stageFlags |= stages[i]->GetStage();
+				push_constant_range.size = std::max(push_constant_range.size, stages[i]->GetPushConstantSize());
+			}
+		}
+
+		layout.setLayouts.clear();
+		layout.pushConstantRanges.clear();
+		// Set numbers index the layout array, so unused numbers below the highest get empty layouts
+		uint32_t set_count = sets.empty() ? 0 : sets.rbegin()->first + 1;
+		for (uint32_t i = 0; i < set_count; ++i) {
+			VkDescriptorSetLayout set_layout = GetDescriptorSetLayout(sets[i]);
+			if (set_layout == VK_NULL_HANDLE) {
+				return false;
+			}
+			layout.setLayouts.push_back(set_layout);
+		}
+		if (push_constant_range.size != 0) {
+			layout.pushConstantRanges.push_back(push_constant_range);
+		}
+		layout.pipelineLayout = GetPipelineLayout(layout.setLayouts, layout.pushConstantRanges);
+		return layout.pipelineLayout != VK_NULL_HANDLE;
+	}
+
+	VkDescriptorSetLayout LayoutCache::GetDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings)
+	{
+		std::vector<VkDescriptorSetLayoutBinding> sorted_bindings = bindings;
+		std::sort(sorted_bindings.begin(), sorted_bindings.end(), [](const VkDescriptorSetLayoutBinding &left, const VkDescriptorSetLayoutBinding &right) {
+			return left.binding < right.binding;
+		});
+		LayoutKey key;
+		for (size_t i = 0; i < sorted_bindings.size(); ++i) {
+			key.push_back((static_cast<uint64_t>(sorted_bindings[i].binding) << 32) | sorted_bindings[i].descriptorType);
+			key.push_back((static_cast<uint64_t>(sorted_bindings[i].descriptorCount) << 32) | sorted_bindings[i].stageFlags);
+		}
+		std::map<LayoutKey, VkDescriptorSetLayout>::const_iterator it = m_DescriptorSetLayouts.find(key);
+		if (it != m_DescriptorSetLayouts.end()) {
+			++m_SharedCount;
+			return it->second;
+		}
+
+		VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {
+			VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,  // VkStructureType                      sType
+			nullptr,                                              // const void                          *pNext
+			0,                                                    // VkDescriptorSetLayoutCreateFlags     flags
+			static_cast<uint32_t>(sorted_bindings.size()),        // uint32_t                             bindingCount
+			sorted_bindings.empty() ? nullptr : &sorted_bindings[0] // const VkDescriptorSetLayoutBinding *pBindings
+		};
+		VkDescriptorSetLayout set_layout;
+		if (vkCreateDescriptorSetLayout(m_Device, &descriptor_set_layout_create_info, nullptr, &set_layout) != VK_SUCCESS) {
+			std::cout << "Could not create descriptor set layout!" << std::endl;
+			return VK_NULL_HANDLE;
+		}
+		m_DescriptorSetLayouts[key] = set_layout;
+		return set_layout;
+	}
+
+	VkPipelineLayout LayoutCache::GetPipelineLayout(const std::vector<VkDescriptorSetLayout> &set_layouts, const std::vector<VkPushConstantRange> &push_constant_ranges)
+	{
+		// Set layouts are deduplicated above, so their handles identify them
+		LayoutKey key;
+		key.push_back(set_layouts.size());
+		for (size_t i = 0; i < set_layouts.size(); ++i) {
+			key.push_back(reinterpret_cast<uint64_t>(set_layouts[i]));
+		}
+		for (size_t i = 0; i < push_constant_ranges.size(); ++i) {
+			key.push_back(push_constant_ranges[i].stageFlags);
+			key.push_back((static_cast<uint64_t>(push_constant_ranges[i].offset) << 32) | push_constant_ranges[i].size);
+		}
+		std::map<LayoutKey, VkPipelineLayout>::const_iterator it = m_PipelineLayouts.find(key);
+		if (it != m_PipelineLayouts.end()) {
+			++m_SharedCount;
+			return it->second;
+		}
+
+		VkPipelineLayoutCreateInfo layout_create_info = {
+			VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,      // VkStructureType                sType
+			nullptr,                                            // const void                    *pNext
+			0,                                                  // VkPipelineLayoutCreateFlags    flags
+			static_cast<uint32_t>(set_layouts.size()),          // uint32_t                       setLayoutCount
+			set_layouts.empty() ? nullptr : &set_layouts[0],    // const VkDescriptorSetLayout   *pSetLayouts
+			static_cast<uint32_t>(push_constant_ranges.size()), // uint32_t                       pushConstantRangeCount
+			push_constant_ranges.empty() ? nullptr : &push_constant_ranges[0] // const VkPushConstantRange *pPushConstantRanges
+		};
+		VkPipelineLayout pipeline_layout;
+		if (vkCreatePipelineLayout(m_Device, &layout_create_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
+			std::cout << "Could not create pipeline layout!" << std::endl;
+			return VK_NULL_HANDLE;
+		}
+		m_PipelineLayouts[key] = pipeline_layout;
+		return pipeline_layout;
+	}
+
+	uint32_t LayoutCache::GetLayoutCount() const
+	{
+		return static_cast<uint32_t>(m_DescriptorSetLayouts.size() + m_PipelineLayouts.size());
+	}
+
+	uint64_t LayoutCache::GetSharedCount() const
+	{
+		return m_SharedCount;
+	}
+}
+#endif
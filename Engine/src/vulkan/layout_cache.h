@@ -0,0 +1,49 @@
+#ifdef USE_RENDER_VULKAN
+#ifndef LAYOUT_CACHE_H
+#define LAYOUT_CACHE_H
+#pragma once
+#include <map>
+#include <vector>
+#include "shader_reflection.h"
+
+namespace HelloEngine
+{
+	struct ReflectedLayout {
+		std::vector<VkDescriptorSetLayout>   setLayouts;
+		std::vector<VkPushConstantRange>     pushConstantRanges;
+		VkPipelineLayout                     pipelineLayout;
+
+		ReflectedLayout() :
+			setLayouts(),
+			pushConstantRanges(),
+			pipelineLayout(VK_NULL_HANDLE) {
+		}
+	};
+
+	// Builds descriptor set and pipeline layouts from reflected shader stages
+	// and owns them. Layouts are looked up by their full contents, so pipelines
+	// whose shaders declare the same interface share the same Vulkan objects.
+	class LayoutCache {
+	public:
+		LayoutCache();
+		~LayoutCache();
+
+		void					Initialize(VkDevice device);
+		void					Destroy();
+		// Uniform buffers become dynamic ones when dynamic_uniform_buffers is set, the shaders cannot tell
+		bool					GetLayout(const ShaderReflection *const *stages, uint32_t stage_count, bool dynamic_uniform_buffers, ReflectedLayout &layout);
+		VkDescriptorSetLayout	GetDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings);
+		VkPipelineLayout		GetPipelineLayout(const std::vector<VkDescriptorSetLayout> &set_layouts, const std::vector<VkPushConstantRange> &push_constant_ranges);
+		uint32_t				GetLayoutCount() const;
+		uint64_t				GetSharedCount() const;
+	private:
+		typedef std::vector<uint64_t> LayoutKey;
+
+		VkDevice									m_Device;
+		std::map<LayoutKey, VkDescriptorSetLayout>	m_DescriptorSetLayouts;
+		std::map<LayoutKey, VkPipelineLayout>		m_PipelineLayouts;
+		uint64_t									m_SharedCount;
+	};
+}
+#endif
+#endif
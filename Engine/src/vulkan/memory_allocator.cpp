@@ -0,0 +1,307 @@
+#ifdef USE_RENDER_VULKAN
+#include "memory_allocator.h"
+#include <iostream>
+
+namespace HelloEngine
+{
+	static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+	}
+
+	static VkDeviceSize AlignDown(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return alignment > 1 ? value / alignment * alignment : value;
+	}
+
+	MemoryAllocator::MemoryAllocator() :
+		m_Device(nullptr),
+		m_MemoryProperties(),
+		m_BufferImageGranularity(1),
+		m_NonCoherentAtomSize(1),
+		m_BlockSize(DEFAULT_BLOCK_SIZE),
+		m_Pools()
+	{
+	}
+
+	MemoryAllocator::~MemoryAllocator()
+	{
+		Destroy();
+	}
+
+	void MemoryAllocator::Initialize(VkPhysicalDevice physical_device, VkDevice device, VkDeviceSize block_size)
+	{
+		VkPhysicalDeviceProperties device_properties;
+		vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+		vkGetPhysicalDeviceMemoryProperties(physical_device, &m_MemoryProperties);
+
+		m_Device = device;
+		m_BlockSize = block_size;
+		m_BufferImageGranularity = device_properties.limits.bufferImageGranularity;
+		m_NonCoherentAtomSize = device_properties.limits.nonCoherentAtomSize;
+		// Linear and optimal resources get separate pools, so they never share a granularity page
+		m_Pools.resize(m_MemoryProperties.memoryTypeCount * 2);
+	}
+
+	void MemoryAllocator::Destroy()
+	{
+		if (m_Device == nullptr) {
+			return;
+		}
+		for (size_t i = 0; i < m_Pools.size(); ++i) {
+			for (size_t j = 0; j < m_Pools[i].size(); ++j) {
+				if (m_Pools[i][j].allocationCount != 0) {
+					std::cout << "Memory block destroyed with " << m_Pools[i][j].allocationCount << " live allocations!" << std::endl;
+				}
+				DestroyBlock(m_Pools[i][j]);
+			}
+		}
+		m_Pools.clear();
+		m_Device = nullptr;
+	}
+
+	bool MemoryAllocator::Allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, bool linear, MemoryAllocation &allocation)
+	{
+		for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; ++i) {
+			if ((requirements.memoryTypeBits & (1 << i)) &&
+				((m_MemoryProperties.memoryTypes[i].propertyFlags & properties) == properties)) {
+				if (AllocateFromType(i, requirements, linear, allocation)) {
+					return true;
+				}
+			}
+		}
+		std::cout << "Could not find memory for an allocation of " << requirements.size << " bytes!" << std::endl;
+		return false;
+	}
+
+	void MemoryAllocator::Free(MemoryAllocation &allocation)
+	{
+		if (allocation.handle == VK_NULL_HANDLE) {
+			return;
+		}
+		MemoryPool &pool = GetPool(allocation.memoryTypeIndex, allocation.linear);
+		for (size_t i = 0; i < pool.size(); ++i) {
+			if (pool[i].handle != allocation.handle) {
+				continue;
+			}
+			ReleaseToBlock(pool[i], allocation.offset, allocation.size);
+			// Keep one empty block around so a free/allocate pattern does not thrash vkAllocateMemory
+			if ((pool[i].allocationCount == 0) && (pool.size() > 1)) {
+				DestroyBlock(pool[i]);
+				pool.erase(pool.begin() + i);
+			}
+			break;
+		}
+		allocation = MemoryAllocation();
+	}
+
+	void MemoryAllocator::Flush(const MemoryAllocation &allocation, VkDeviceSize offset, VkDeviceSize size) const
+	{
+		if ((size == 0) ||
+			(m_MemoryProperties.memoryTypes[allocation.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+			return;
+		}
+		const MemoryBlock *block = FindBlock(allocation);
+		if (block == nullptr) {
+			return;
+		}
+		VkDeviceSize begin = AlignDown(allocation.offset + offset, m_NonCoherentAtomSize);
+		VkDeviceSize end = AlignUp(allocation.offset + offset + size, m_NonCoherentAtomSize);
+
+		VkMappedMemoryRange flush_range = {
+			VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,              // VkStructureType                        sType
+			nullptr,                                            // const void                            *pNext
+			allocation.handle,                                  // VkDeviceMemory                         memory
+			begin,                                              // VkDeviceSize                           offset
+			end < block->size ? end - begin : VK_WHOLE_SIZE     // VkDeviceSize                           size
+		};
+		vkFlushMappedMemoryRanges(m_Device, 1, &flush_range);
+	}
+
+	MemoryStatistics MemoryAllocator::GetStatistics() const
+	{
+		MemoryStatistics statistics;
+		uint64_t free_bytes = 0;
+		for (size_t i = 0; i < m_Pools.size(); ++i) {
+			for (size_t j = 0; j < m_Pools[i].size(); ++j) {
+				const MemoryBlock &block = m_Pools[i][j];
+				++statistics.blockCount;
+				statistics.allocationCount += block.allocationCount;
+				statistics.reservedBytes += block.size;
+				statistics.usedBytes += block.used;
+				statistics.freeRangeCount += static_cast<uint32_t>(block.freeRanges.size());
+				for (size_t k = 0; k < block.freeRanges.size(); ++k) {
+					free_bytes += block.freeRanges[k].size;
+					if (block.freeRanges[k].size > statistics.largestFreeRange) {
+						statistics.largestFreeRange = block.freeRanges[k].size;
+					}
+				}
+			}
+		}
+		if (free_bytes > 0) {
+			statistics.fragmentation = 1.0f - static_cast<float>(statistics.largestFreeRange) / static_cast<float>(free_bytes);
+		}
+		return statistics;
+	}
+
+	MemoryAllocator::MemoryPool& MemoryAllocator::GetPool(uint32_t memory_type_index, bool linear)
+	{
+		return m_Pools[memory_type_index * 2 + (linear ? 0 : 1)];
+	}
+
+	const MemoryAllocator::MemoryBlock* MemoryAllocator::FindBlock(const MemoryAllocation &allocation) const
+	{
+		const MemoryPool &pool = m_Pools[allocation.memoryTypeIndex * 2 + (allocation.linear ? 0 : 1)];
+		for (size_t i = 0; i < pool.size(); ++i) {
+			if (pool[i].handle == allocation.handle) {
+				return &pool[i];
+			}
+		}
+		return nullptr;
+	}
+
+	bool MemoryAllocator::AllocateFromType(uint32_t memory_type_index, const VkMemoryRequirements &requirements, bool linear, MemoryAllocation &allocation)
+	{
+		if (m_BufferImageGranularity <= 1) {
+			linear = true;
+		}
+		MemoryPool &pool = GetPool(memory_type_index, linear);
+		VkDeviceSize offset = 0;
+		size_t block_index = pool.size();
+
+		for (size_t i = 0; i < pool.size(); ++i) {
+			if (AllocateFromBlock(pool[i], requirements.size, requirements.alignment, offset)) {
+				block_index = i;
+				break;
+			}
+		}
+
+		if (block_index == pool.size()) {
+			// Small heaps, such as host visible device local memory, must not be exhausted by a single block
+			VkDeviceSize heap_size = m_MemoryProperties.memoryHeaps[m_MemoryProperties.memoryTypes[memory_type_index].heapIndex].size;
+			VkDeviceSize block_size = m_BlockSize;
+			if (block_size > heap_size / 8) {
+				block_size = heap_size / 8;
+			}
+			if (block_size < requirements.size) {
+				block_size = requirements.size;
+			}
+
+			MemoryBlock block;
+			if (!CreateBlock(memory_type_index, block_size, block)) {
+				return false;
+			}
+			pool.push_back(block);
+			block_index = pool.size() - 1;
+			if (!AllocateFromBlock(pool[block_index], requirements.size, requirements.alignment, offset)) {
+				return false;
+			}
+		}
+
+		const MemoryBlock &block = pool[block_index];
+		allocation.handle = block.handle;
+		allocation.offset = offset;
+		allocation.size = requirements.size;
+		allocation.mappedData = block.mappedData != nullptr ? static_cast<char*>(block.mappedData) + offset : nullptr;
+		allocation.memoryTypeIndex = memory_type_index;
+		allocation.linear = linear;
+		return true;
+	}
+
+	bool MemoryAllocator::CreateBlock(uint32_t memory_type_index, VkDeviceSize size, MemoryBlock &block) const
+	{
+		VkMemoryAllocateInfo memory_allocate_info = {
+			VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,     // VkStructureType                        sType
+			nullptr,                                    // const void                            *pNext
+			size,                                       // VkDeviceSize                           allocationSize
+			memory_type_index                           // uint32_t                               memoryTypeIndex
+		};
+
+		block.handle = VK_NULL_HANDLE;
+		block.size = size;
+		block.used = 0;
+		block.allocationCount = 0;
+		block.mappedData = nullptr;
+		block.freeRanges.assign(1, FreeRange{ 0, size });
+
+		if (vkAllocateMemory(m_Device, &memory_allocate_info, nullptr, &block.handle) != VK_SUCCESS) {
+			return false;
+		}
+		if (m_MemoryProperties.memoryTypes[memory_type_index].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			if (vkMapMemory(m_Device, block.handle, 0, VK_WHOLE_SIZE, 0, &block.mappedData) != VK_SUCCESS) {
+				std::cout << "Could not map memory block!" << std::endl;
+				vkFreeMemory(m_Device, block.handle, nullptr);
+				block.handle = VK_NULL_HANDLE;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void MemoryAllocator::DestroyBlock(MemoryBlock &block) const
+	{
+		if (block.handle == VK_NULL_HANDLE) {
+			return;
+		}
+		if (block.mappedData != nullptr) {
+			vkUnmapMemory(m_Device, block.handle);
+			block.mappedData = nullptr;
+		}
+		vkFreeMemory(m_Device, block.handle, nullptr);
+		block.handle = VK_NULL_HANDLE;
+	}
+
+	bool MemoryAllocator::AllocateFromBlock(MemoryBlock &block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset)
+	{
+		for (size_t i = 0; i < block.freeRanges.size(); ++i) {
+			FreeRange range = block.freeRanges[i];
+			VkDeviceSize aligned_offset = AlignUp(range.offset, alignment);
+			VkDeviceSize padding = aligned_offset - range.offset;
+			if (padding + size > range.size) {
+				continue;
+			}
+
+			// The alignment padding stays on the free list, so Free() only has to return [offset, offset + size)
+			VkDeviceSize tail_offset = aligned_offset + size;
+			VkDeviceSize tail_size = range.offset + range.size - tail_offset;
+			block.freeRanges.erase(block.freeRanges.begin() + i);
+			if (tail_size > 0) {
+				block.freeRanges.insert(block.freeRanges.begin() + i, FreeRange{ tail_offset, tail_size });
+			}
+			if (padding > 0) {
+				block.freeRanges.insert(block.freeRanges.begin() + i, FreeRange{ range.offset, padding });
+			}
+
+			block.used += size;
+			++block.allocationCount;
+			offset = aligned_offset;
+			return true;
+		}
+		return false;
+	}
+
+	void MemoryAllocator::ReleaseToBlock(MemoryBlock &block, VkDeviceSize offset, VkDeviceSize size)
+	{
+		// Free ranges are kept sorted by offset, neighbours are coalesced on release
+		size_t index = 0;
+		while ((index < block.freeRanges.size()) && (block.freeRanges[index].offset < offset)) {
+			++index;
+		}
+		block.freeRanges.insert(block.freeRanges.begin() + index, FreeRange{ offset, size });
+
+		if ((index + 1 < block.freeRanges.size()) &&
+			(block.freeRanges[index].offset + block.freeRanges[index].size == block.freeRanges[index + 1].offset)) {
+			block.freeRanges[index].size += block.freeRanges[index + 1].size;
+			block.freeRanges.erase(block.freeRanges.begin() + index + 1);
+		}
+		if ((index > 0) &&
+			(block.freeRanges[index - 1].offset + block.freeRanges[index - 1].size == block.freeRanges[index].offset)) {
+			block.freeRanges[index - 1].size += block.freeRanges[index].size;
+			block.freeRanges.erase(block.freeRanges.begin() + index);
+		}
+
+		block.used -= size;
+		--block.allocationCount;
+	}
+}
+#endif
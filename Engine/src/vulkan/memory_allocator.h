@@ -0,0 +1,80 @@
+#ifdef USE_RENDER_VULKAN
+#ifndef MEMORY_ALLOCATOR_H
+#define MEMORY_ALLOCATOR_H
+#pragma once
+#include <vector>
+#include "vulkan_functions.h"
+#include "renderer.h"
+
+namespace HelloEngine
+{
+	struct MemoryAllocation {
+		VkDeviceMemory                handle;
+		VkDeviceSize                  offset;
+		VkDeviceSize                  size;
+		void                         *mappedData;
+		uint32_t                      memoryTypeIndex;
+		bool                          linear;
+
+		MemoryAllocation() :
+			handle(VK_NULL_HANDLE),
+			offset(0),
+			size(0),
+			mappedData(nullptr),
+			memoryTypeIndex(0),
+			linear(true) {
+		}
+	};
+
+	// Sub-allocates buffers and images from large VkDeviceMemory blocks, one
+	// pool of blocks per memory type. Host visible blocks stay mapped for their
+	// whole lifetime and hand out pointers through MemoryAllocation::mappedData.
+	class MemoryAllocator {
+	public:
+		static const VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+
+		MemoryAllocator();
+		~MemoryAllocator();
+
+		void					Initialize(VkPhysicalDevice physical_device, VkDevice device, VkDeviceSize block_size = DEFAULT_BLOCK_SIZE);
+		void					Destroy();
+		bool					Allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, bool linear, MemoryAllocation &allocation);
+		void					Free(MemoryAllocation &allocation);
+		void					Flush(const MemoryAllocation &allocation, VkDeviceSize offset, VkDeviceSize size) const;
+		MemoryStatistics		GetStatistics() const;
+	private:
+		struct FreeRange {
+			VkDeviceSize offset;
+			VkDeviceSize size;
+		};
+
+		struct MemoryBlock {
+			VkDeviceMemory           handle;
+			VkDeviceSize             size;
+			VkDeviceSize             used;
+			uint32_t                 allocationCount;
+			void                    *mappedData;
+			std::vector<FreeRange>   freeRanges;
+		};
+
+		typedef std::vector<MemoryBlock> MemoryPool;
+
+		VkDevice							m_Device;
+		VkPhysicalDeviceMemoryProperties	m_MemoryProperties;
+		VkDeviceSize						m_BufferImageGranularity;
+		VkDeviceSize						m_NonCoherentAtomSize;
+		VkDeviceSize						m_BlockSize;
+		std::vector<MemoryPool>				m_Pools;
+
+		MemoryPool&			GetPool(uint32_t memory_type_index, bool linear);
+		const MemoryBlock*	FindBlock(const MemoryAllocation &allocation) const;
+		bool				AllocateFromType(uint32_t memory_type_index, const VkMemoryRequirements &requirements, bool linear, MemoryAllocation &allocation);
+		bool				CreateBlock(uint32_t memory_type_index, VkDeviceSize size, MemoryBlock &block) const;
+		void				DestroyBlock(MemoryBlock &block) const;
+
+		static bool			AllocateFromBlock(MemoryBlock &block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset);
+		static void			ReleaseToBlock(MemoryBlock &block, VkDeviceSize offset, VkDeviceSize size);
+	};
+}
+#endif
+#endif
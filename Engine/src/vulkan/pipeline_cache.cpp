@@ -0,0 +1,218 @@
+#ifdef USE_RENDER_VULKAN
+#include "pipeline_cache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace HelloEngine
+{
+	static const uint32_t PIPELINE_CACHE_MAGIC = 0x43504548; // "HEPC"
+	static const uint32_t PIPELINE_CACHE_VERSION = 1;
+
+	// FNV-1a, enough to notice a truncated or corrupted blob before the driver sees it
+	static uint32_t GetChecksum(const char *data, size_t size)
+	{
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < size; ++i) {
+			hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+		}
+		return hash;
+	}
+
+	PipelineCache::PipelineCache() :
+		m_Device(nullptr),
+		m_Handle(VK_NULL_HANDLE),
+		m_DeviceProperties(),
+		m_Filename(),
+		m_Warm(false),
+		m_ColdCreationMicroseconds(0)
+	{
+	}
+
+	PipelineCache::~PipelineCache()
+	{
+		Destroy();
+	}
+
+	bool PipelineCache::Initialize(VkPhysicalDevice physical_device, VkDevice device, const char *filename)
+	{
+		m_Device = device;
+		m_Filename = filename;
+		vkGetPhysicalDeviceProperties(physical_device, &m_DeviceProperties);
+
+		std::vector<char> data;
+		m_Warm = Load(data);
+
+		VkPipelineCacheCreateInfo pipeline_cache_create_info = {
+			VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,   // VkStructureType                sType
+			nullptr,                                        // const void                    *pNext
+			0,                                              // VkPipelineCacheCreateFlags     flags
+			data.size(),                                    // size_t                         initialDataSize
+			data.empty() ? nullptr : &data[0]               // const void                    *pInitialData
+		};
+		if (vkCreatePipelineCache(m_Device, &pipeline_cache_create_info, nullptr, &m_Handle) == VK_SUCCESS) {
+			return true;
+		}
+		if (!m_Warm) {
+			std::cout << "Could not create pipeline cache!" << std::endl;
+			return false;
+		}
+		// The driver still refused the blob, start from an empty cache instead
+		std::cout << "Pipeline cache \"" << m_Filename << "\" was rejected by the driver, ignoring it!" << std::endl;
+		m_Warm = false;
+		pipeline_cache_create_info.initialDataSize = 0;
+		pipeline_cache_create_info.pInitialData = nullptr;
+		if (vkCreatePipelineCache(m_Device, &pipeline_cache_create_info, nullptr, &m_Handle) != VK_SUCCESS) {
+			std::cout << "Could not create pipeline cache!" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	bool PipelineCache::Load(std::vector<char> &data)
+	{
+		std::ifstream file(m_Filename.c_str(), std::ios::binary);
+		if (file.fail()) {
+			// First run, nothing to report
+			return false;
+		}
+		std::vector<char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		file.close();
+
+		FileHeader header;
+		FileHeader expected;
+		FillHeader(expected);
+		if (contents.size() < sizeof(header)) {
+			std::cout << "Pipeline cache \"" << m_Filename << "\" is truncated, ignoring it!" << std::endl;
+			return false;
+		}
+		memcpy(&header, &contents[0], sizeof(header));
+		if ((header.magic != expected.magic) || (header.version != expected.version)) {
+			std::cout << "Pipeline cache \"" << m_Filename << "\" has an unknown format, ignoring it!" << std::endl;
+			return false;
+		}
+		if ((header.vendorID != expected.vendorID) ||
+			(header.deviceID != expected.deviceID) ||
+			(header.driverVersion != expected.driverVersion) ||
+			(memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) != 0)) {
+			std::cout << "Pipeline cache \"" << m_Filename << "\" was created by a different device or driver, ignoring it!" << std::endl;
+			return false;
+		}
+		const char *blob = &contents[0] + sizeof(header);
+		if ((contents.size() - sizeof(header) != header.dataSize) || (GetChecksum(blob, header.dataSize) != header.dataChecksum)) {
+			std::cout << "Pipeline cache \"" << m_Filename << "\" is corrupted, ignoring it!" << std::endl;
+			return false;
+		}
+
+		// The blob repeats vendor, device and UUID in VkPipelineCacheHeaderVersionOne, check it agrees
+		uint32_t blob_header[4];
+		if (header.dataSize >= sizeof(blob_header) + VK_UUID_SIZE) {
+			memcpy(blob_header, blob, sizeof(blob_header));
+		}
+		if ((header.dataSize < sizeof(blob_header) + VK_UUID_SIZE) ||
+			(blob_header[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) ||
+			(blob_header[2] != expected.vendorID) ||
+			(blob_header[3] != expected.deviceID) ||
+			(memcmp(blob + sizeof(blob_header), expected.pipelineCacheUUID, VK_UUID_SIZE) != 0)) {
+			std::cout << "Pipeline cache \"" << m_Filename << "\" does not match this device, ignoring it!" << std::endl;
+			return false;
+		}
+
+		m_ColdCreationMicroseconds = header.coldCreationMicroseconds;
+		data.assign(blob, blob + header.dataSize);
+		return true;
+	}
+
+	void PipelineCache::FillHeader(FileHeader &header) const
+	{
+		memset(&header, 0, sizeof(header));
+		header.magic = PIPELINE_CACHE_MAGIC;
+		header.version = PIPELINE_CACHE_VERSION;
+		header.vendorID = m_DeviceProperties.vendorID;
+		header.deviceID = m_DeviceProperties.deviceID;
+		header.driverVersion = m_DeviceProperties.driverVersion;
+		header.coldCreationMicroseconds = m_ColdCreationMicroseconds;
+		memcpy(header.pipelineCacheUUID, m_DeviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+	}
+
+	bool PipelineCache::Save()
+	{
+		if (m_Handle == VK_NULL_HANDLE) {
+			return false;
+		}
+		size_t data_size = 0;
+		if ((vkGetPipelineCacheData(m_Device, m_Handle, &data_size, nullptr) != VK_SUCCESS) || (data_size == 0)) {
+			std::cout << "Could not get pipeline cache data!" << std::endl;
+			return false;
+		}
+		std::vector<char> data(data_size);
+		if (vkGetPipelineCacheData(m_Device, m_Handle, &data_size, &data[0]) != VK_SUCCESS) {
+			std::cout << "Could not get pipeline cache data!" << std::endl;
+			return false;
+		}
+		data.resize(data_size);
+
+		FileHeader header;
+		FillHeader(header);
+		header.dataSize = static_cast<uint32_t>(data.size());
+		header.dataChecksum = GetChecksum(&data[0], data.size());
+
+		// Written next to the target and renamed over it, readers see the old file or the new one
+		std::string temporary_filename = m_Filename + ".tmp";
+		{
+			std::ofstream file(temporary_filename.c_str(), std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(&data[0], data.size());
+			file.close();
+			if (file.fail()) {
+				std::cout << "Could not write \"" << temporary_filename << "\" file!" << std::endl;
+				std::remove(temporary_filename.c_str());
+				return false;
+			}
+		}
+	#if defined(USE_PLATFORM_WIN32_KHR)
+		bool renamed = MoveFileExA(temporary_filename.c_str(), m_Filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+	#else
+		bool renamed = std::rename(temporary_filename.c_str(), m_Filename.c_str()) == 0;
+	#endif
+		if (!renamed) {
+			std::cout << "Could not replace \"" << m_Filename << "\" file!" << std::endl;
+			std::remove(temporary_filename.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	void PipelineCache::Destroy()
+	{
+		if (m_Handle != VK_NULL_HANDLE) {
+			vkDestroyPipelineCache(m_Device, m_Handle, nullptr);
+			m_Handle = VK_NULL_HANDLE;
+		}
+	}
+
+	VkPipelineCache PipelineCache::GetHandle() const
+	{
+		return m_Handle;
+	}
+
+	bool PipelineCache::IsWarm() const
+	{
+		return m_Warm;
+	}
+
+	void PipelineCache::SetCreationTime(double milliseconds)
+	{
+		// Only a run that compiled everything from scratch tells what the cache saves
+		if (!m_Warm) {
+			m_ColdCreationMicroseconds = static_cast<uint32_t>(milliseconds * 1000.0);
+		}
+	}
+
+	double PipelineCache::GetColdCreationTime() const
+	{
+		return m_ColdCreationMicroseconds / 1000.0;
+	}
+}
+#endif
@@ -0,0 +1,52 @@
+#ifdef USE_RENDER_VULKAN
+#ifndef PIPELINE_CACHE_H
+#define PIPELINE_CACHE_H
+#pragma once
+#include <string>
+#include <vector>
+#include "vulkan_functions.h"
+
+namespace HelloEngine
+{
+	// Keeps a VkPipelineCache across runs. The blob is stored behind a header
+	// naming the device, driver and cache UUID it came from; a blob written by
+	// anything else is dropped and the cache starts empty. Save() replaces the
+	// file atomically, so an interrupted write never leaves a torn cache behind.
+	class PipelineCache {
+	public:
+		PipelineCache();
+		~PipelineCache();
+
+		bool					Initialize(VkPhysicalDevice physical_device, VkDevice device, const char *filename);
+		void					Destroy();
+		bool					Save();
+		VkPipelineCache			GetHandle() const;
+		bool					IsWarm() const;
+		void					SetCreationTime(double milliseconds);
+		double					GetColdCreationTime() const;
+	private:
+		struct FileHeader {
+			uint32_t magic;
+			uint32_t version;
+			uint32_t vendorID;
+			uint32_t deviceID;
+			uint32_t driverVersion;
+			uint32_t dataSize;
+			uint32_t dataChecksum;
+			uint32_t coldCreationMicroseconds;
+			uint8_t  pipelineCacheUUID[VK_UUID_SIZE];
+		};
+
+		bool					Load(std::vector<char> &data);
+		void					FillHeader(FileHeader &header) const;
+
+		VkDevice					m_Device;
+		VkPipelineCache				m_Handle;
+		VkPhysicalDeviceProperties	m_DeviceProperties;
+		std::string					m_Filename;
+		bool						m_Warm;
+		uint32_t					m_ColdCreationMicroseconds;
+	};
+}
+#endif
+#endif
@@ -0,0 +1,605 @@
+#ifdef USE_RENDER_VULKAN
+#include "pipeline_registry.h"
+#include "tools.h"
+#include <cstring>
+#include <iostream>
+
+namespace HelloEngine
+{
+	// FNV-1a over the raw bytes of each field; the Vulkan structs hashed here have no padding
+	static void HashBytes(uint64_t &hash, const void *data, size_t size)
+	{
+		const uint8_t *bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i) {
+			hash = (hash ^ bytes[i]) * 1099511628211ULL;
+		}
+	}
+
+	template<class T>
+	static void HashValue(uint64_t &hash, const T &value)
+	{
+		HashBytes(hash, &value, sizeof(value));
+	}
+
+	template<class T>
+	static void HashVector(uint64_t &hash, const std::vector<T> &values)
+	{
+		HashValue(hash, values.size());
+		if (!values.empty()) {
+			HashBytes(hash, &values[0], values.size() * sizeof(T));
+		}
+	}
+
+	static void HashString(uint64_t &hash, const std::string &value)
+	{
+		HashValue(hash, value.size());
+		HashBytes(hash, value.data(), value.size());
+	}
+
+	template<class T>
+	static bool EqualBytes(const T &left, const T &right)
+	{
+		return memcmp(&left, &right, sizeof(T)) == 0;
+	}
+
+	template<class T>
+	static bool EqualVectors(const std::vector<T> &left, const std::vector<T> &right)
+	{
+		return (left.size() == right.size()) && (left.empty() || (memcmp(&left[0], &right[0], left.size() * sizeof(T)) == 0));
+	}
+
+	SpecializationConstants::SpecializationConstants() :
+		m_Entries(),
+		m_Data()
+	{
+	}
+
+	void SpecializationConstants::Set(uint32_t constant_id, uint32_t value)
+	{
+		for (size_t i = 0; i < m_Entries.size(); ++i) {
+			if (m_Entries[i].constantID == constant_id) {
+				m_Data[i] = value;
+				return;
+			}
+		}
+		VkSpecializationMapEntry entry = {
+			constant_id,                                                // uint32_t                                       constantID
+			static_cast<uint32_t>(m_Data.size() * sizeof(uint32_t)),    // uint32_t                                       offset
+			sizeof(uint32_t)                                            // size_t                                         size
+		};
+		m_Entries.push_back(entry);
+		m_Data.push_back(value);
+	}
+
+	bool SpecializationConstants::IsEmpty() const
+	{
+		return m_Entries.empty();
+	}
+
+	VkSpecializationInfo SpecializationConstants::GetInfo() const
+	{
+		VkSpecializationInfo specialization_info = {
+			static_cast<uint32_t>(m_Entries.size()),                    // uint32_t                                       mapEntryCount
+			m_Entries.empty() ? nullptr : &m_Entries[0],                // const VkSpecializationMapEntry                *pMapEntries
+			m_Data.size() * sizeof(uint32_t),                           // size_t                                         dataSize
+			m_Data.empty() ? nullptr : &m_Data[0]                       // const void                                    *pData
+		};
+		return specialization_info;
+	}
+
+	void SpecializationConstants::Hash(uint64_t &hash) const
+	{
+		// Entries are hashed by ID and value so the order they were set in does not matter
+		uint64_t combined = 0;
+		for (size_t i = 0; i < m_Entries.size(); ++i) {
+			uint64_t entry_hash = 14695981039346656037ULL;
+			HashValue(entry_hash, m_Entries[i].constantID);
+			HashValue(entry_hash, m_Data[i]);
+			combined += entry_hash;
+		}
+		HashValue(hash, m_Entries.size());
+		HashValue(hash, combined);
+	}
+
+	bool SpecializationConstants::operator==(const SpecializationConstants &other) const
+	{
+		if (m_Entries.size() != other.m_Entries.size()) {
+			return false;
+		}
+		for (size_t i = 0; i < m_Entries.size(); ++i) {
+			size_t j = 0;
+			while ((j < other.m_Entries.size()) && (other.m_Entries[j].constantID != m_Entries[i].constantID)) {
+				++j;
+			}
+			if ((j == other.m_Entries.size()) || (other.m_Data[j] != m_Data[i])) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	GraphicsPipelineDesc::GraphicsPipelineDesc() :
+		vertexShader(),
+		fragmentShader(),
+		vertexConstants(),
+		fragmentConstants(),
+		vertexBindings(),
+		vertexAttributes(),
+		topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST),
+		cullMode(VK_CULL_MODE_BACK_BIT),
+		frontFace(VK_FRONT_FACE_COUNTER_CLOCKWISE),
+		blend(),
+		layout(VK_NULL_HANDLE),
+		renderPass(VK_NULL_HANDLE),
+		subpass(0)
+	{
+		VkPipelineColorBlendAttachmentState opaque = {
+			VK_FALSE,                                                     // VkBool32                                       blendEnable
+			VK_BLEND_FACTOR_ONE,                                          // VkBlendFactor                                  srcColorBlendFactor
+			VK_BLEND_FACTOR_ZERO,                                         // VkBlendFactor                                  dstColorBlendFactor
+			VK_BLEND_OP_ADD,                                              // VkBlendOp                                      colorBlendOp
+			VK_BLEND_FACTOR_ONE,                                          // VkBlendFactor                                  srcAlphaBlendFactor
+			VK_BLEND_FACTOR_ZERO,                                         // VkBlendFactor                                  dstAlphaBlendFactor
+			VK_BLEND_OP_ADD,                                              // VkBlendOp                                      alphaBlendOp
+			VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |         // VkColorComponentFlags                          colorWriteMask
+			VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+		};
+		blend = opaque;
+	}
+
+	uint64_t GraphicsPipelineDesc::GetHash() const
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		HashString(hash, vertexShader);
+		HashString(hash, fragmentShader);
+		vertexConstants.Hash(hash);
+		fragmentConstants.Hash(hash);
+		HashVector(hash, vertexBindings);
+		HashVector(hash, vertexAttributes);
+		HashValue(hash, topology);
+		HashValue(hash, cullMode);
+		HashValue(hash, frontFace);
+		HashValue(hash, blend);
+		HashValue(hash, layout);
+		HashValue(hash, renderPass);
+		HashValue(hash, subpass);
+		return hash;
+	}
+
+	bool GraphicsPipelineDesc::operator==(const GraphicsPipelineDesc &other) const
+	{
+		return (vertexShader == other.vertexShader) &&
+			(fragmentShader == other.fragmentShader) &&
+			(vertexConstants == other.vertexConstants) &&
+			(fragmentConstants == other.fragmentConstants) &&
+			EqualVectors(vertexBindings, other.vertexBindings) &&
+			EqualVectors(vertexAttributes, other.vertexAttributes) &&
+			(topology == other.topology) &&
+			(cullMode == other.cullMode) &&
+			(frontFace == other.frontFace) &&
+			EqualBytes(blend, other.blend) &&
+			(layout == other.layout) &&
+			(renderPass == other.renderPass) &&
+			(subpass == other.subpass);
+	}
+
+	PipelineRegistry::PipelineRegistry() :
+		m_Device(nullptr),
+		m_PipelineCache(VK_NULL_HANDLE),
+		m_Pipelines(),
+		m_PipelinesByHash(),
+		m_DeduplicatedCount(0),
+		m_Workers(),
+		m_Queue(),
+		m_QueueMutex(),
+		m_QueueCondition(),
+		m_CompletedCondition(),
+		m_PendingCount(0),
+		m_CompletedCount(0),
+		m_CollectedCount(0),
+		m_Stopping(false),
+		m_ShaderModules(),
+		m_ShaderMutex()
+	{
+	}
+
+	PipelineRegistry::~PipelineRegistry()
+	{
+		Destroy();
+	}
+
+	void PipelineRegistry::Initialize(VkDevice device, VkPipelineCache pipeline_cache, uint32_t worker_count)
+	{
+		m_Device = device;
+		m_PipelineCache = pipeline_cache;
+		m_Stopping = false;
+		for (uint32_t i = 0; i < worker_count; ++i) {
+			m_Workers.push_back(std::thread(&PipelineRegistry::WorkerLoop, this));
+		}
+	}
+
+	void PipelineRegistry::Destroy()
+	{
+		// Workers finish the pipeline they are compiling, whatever is still queued is dropped
+		{
+			std::lock_guard<std::mutex> lock(m_QueueMutex);
+			m_Stopping = true;
+			m_Queue.clear();
+		}
+		m_QueueCondition.notify_all();
+		for (size_t i = 0; i < m_Workers.size(); ++i) {
+			m_Workers[i].join();
+		}
+		m_Workers.clear();
+
+		for (size_t i = 0; i < m_Pipelines.size(); ++i) {
+			if (m_Pipelines[i]->handle != VK_NULL_HANDLE) {
+				vkDestroyPipeline(m_Device, m_Pipelines[i]->handle, nullptr);
+			}
+		}
+		m_Pipelines.clear();
+		m_PipelinesByHash.clear();
+		for (std::map<std::string, VkShaderModule>::iterator it = m_ShaderModules.begin(); it != m_ShaderModules.end(); ++it) {
+			if (it->second != VK_NULL_HANDLE) {
+				vkDestroyShaderModule(m_Device, it->second, nullptr);
+			}
+		}
+		m_ShaderModules.clear();
+		m_PendingCount = 0;
+		m_CompletedCount = 0;
+		m_CollectedCount = 0;
+	}
+
+	uint32_t PipelineRegistry::Request(const GraphicsPipelineDesc &desc, uint32_t fallback)
+	{
+		uint64_t hash = desc.GetHash();
+		typedef std::unordered_multimap<uint64_t, uint32_t>::const_iterator HashIterator;
+		std::pair<HashIterator, HashIterator> range = m_PipelinesByHash.equal_range(hash);
+		for (HashIterator it = range.first; it != range.second; ++it) {
+			if (m_Pipelines[it->second]->desc == desc) {
+				++m_DeduplicatedCount;
+				return it->second;
+			}
+		}
+
+		uint32_t pipeline = static_cast<uint32_t>(m_Pipelines.size());
+		std::unique_ptr<PipelineEntry> entry(new PipelineEntry());
+		entry->desc = desc;
+		entry->hash = hash;
+		entry->fallback = fallback;
+		entry->handle = VK_NULL_HANDLE;
+		entry->state = PIPELINE_PENDING;
+		PipelineEntry *compiled_entry = entry.get();
+		m_Pipelines.push_back(std::move(entry));
+		m_PipelinesByHash.insert(std::make_pair(hash, pipeline));
+		++m_PendingCount;
+
+		if (m_Workers.empty()) {
+			Compile(*compiled_entry);
+			return pipeline;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_QueueMutex);
+			m_Queue.push_back(compiled_entry);
+		}
+		m_QueueCondition.notify_one();
+		return pipeline;
+	}
+
+	bool PipelineRegistry::Wait(uint32_t pipeline)
+	{
+		if (pipeline >= m_Pipelines.size()) {
+			return false;
+		}
+		PipelineEntry &entry = *m_Pipelines[pipeline];
+		std::unique_lock<std::mutex> lock(m_QueueMutex);
+		m_CompletedCondition.wait(lock, [&entry]() { return entry.state != PIPELINE_PENDING; });
+		return entry.state == PIPELINE_READY;
+	}
+
+	VkPipeline PipelineRegistry::Get(uint32_t pipeline) const
+	{
+		// Fallbacks may themselves be pending, so the chain is followed to the first ready one
+		while (pipeline < m_Pipelines.size()) {
+			const PipelineEntry &entry = *m_Pipelines[pipeline];
+			if (entry.state == PIPELINE_READY) {
+				return entry.handle;
+			}
+			pipeline = entry.fallback;
+		}
+		return VK_NULL_HANDLE;
+	}
+
+	const GraphicsPipelineDesc &PipelineRegistry::GetDesc(uint32_t pipeline) const
+	{
+		return m_Pipelines[pipeline]->desc;
+	}
+
+	bool PipelineRegistry::IsReady(uint32_t pipeline) const
+	{
+		return (pipeline < m_Pipelines.size()) && (m_Pipelines[pipeline]->state == PIPELINE_READY);
+	}
+
+	bool PipelineRegistry::CollectCompleted()
+	{
+		uint32_t completed_count = m_CompletedCount;
+		if (completed_count == m_CollectedCount) {
+			return false;
+		}
+		m_CollectedCount = completed_count;
+		return true;
+	}
+
+	uint32_t PipelineRegistry::GetPipelineCount() const
+	{
+		return static_cast<uint32_t>(m_Pipelines.size());
+	}
+
+	uint32_t PipelineRegistry::GetPendingCount() const
+	{
+		return m_PendingCount;
+	}
+
+	uint64_t PipelineRegistry::GetDeduplicatedCount() const
+	{
+		return m_DeduplicatedCount;
+	}
+
+	void PipelineRegistry::WorkerLoop()
+	{
+		for (;;) {
+			PipelineEntry *entry = nullptr;
+			{
+				std::unique_lock<std::mutex> lock(m_QueueMutex);
+				m_QueueCondition.wait(lock, [this]() { return m_Stopping || !m_Queue.empty(); });
+				if (m_Stopping) {
+					return;
+				}
+				entry = m_Queue.front();
+				m_Queue.pop_front();
+			}
+			Compile(*entry);
+		}
+	}
+
+	VkShaderModule PipelineRegistry::GetShaderModule(const std::string &filename)
+	{
+		// Variants mostly differ in fixed function state, so modules are loaded once and shared
+		std::lock_guard<std::mutex> lock(m_ShaderMutex);
+		std::map<std::string, VkShaderModule>::iterator it = m_ShaderModules.find(filename);
+		if (it != m_ShaderModules.end()) {
+			return it->second;
+		}
+
+		VkShaderModule shader_module = VK_NULL_HANDLE;
+		const std::vector<char> code = GetBinaryFileContents(filename.c_str());
+		if (code.size() != 0) {
+			VkShaderModuleCreateInfo shader_module_create_info{};
+			shader_module_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+			shader_module_create_info.codeSize = code.size();
+			shader_module_create_info.pCode = reinterpret_cast<const uint32_t*>(&code[0]);
+			if (vkCreateShaderModule(m_Device, &shader_module_create_info, nullptr, &shader_module) != VK_SUCCESS) {
+				std::cout << "Could not create shader module from a \"" << filename << "\" file!\n";
+				shader_module = VK_NULL_HANDLE;
+			}
+		}
+		m_ShaderModules[filename] = shader_module;
+		return shader_module;
+	}
+
+	void PipelineRegistry::Compile(PipelineEntry &entry)
+	{
+		const GraphicsPipelineDesc &desc = entry.desc;
+		VkShaderModule vertex_shader_module = GetShaderModule(desc.vertexShader);
+		VkShaderModule fragment_shader_module = GetShaderModule(desc.fragmentShader);
+		VkPipeline pipeline = VK_NULL_HANDLE;
+
+		if ((vertex_shader_module != VK_NULL_HANDLE) && (fragment_shader_module != VK_NULL_HANDLE)) {
+			VkSpecializationInfo vertex_specialization_info = desc.vertexConstants.GetInfo();
+			VkSpecializationInfo fragment_specialization_info = desc.fragmentConstants.GetInfo();
+
+			VkPipelineShaderStageCreateInfo shader_stage_create_infos[] = {
+				{
+					VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,        // VkStructureType                                sType
+					nullptr,                                                    // const void                                    *pNext
+					0,                                                          // VkPipelineShaderStageCreateFlags               flags
+					VK_SHADER_STAGE_VERTEX_BIT,                                 // VkShaderStageFlagBits                          stage
+					vertex_shader_module,                                       // VkShaderModule                                 module
+					"main",                                                     // const char                                    *pName
+					desc.vertexConstants.IsEmpty() ? nullptr : &vertex_specialization_info // const VkSpecializationInfo       *pSpecializationInfo
+				},
+				{
+					VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,        // VkStructureType                                sType
+					nullptr,                                                    // const void                                    *pNext
+					0,                                                          // VkPipelineShaderStageCreateFlags               flags
+					VK_SHADER_STAGE_FRAGMENT_BIT,                               // VkShaderStageFlagBits                          stage
+					fragment_shader_module,                                     // VkShaderModule                                 module
+					"main",                                                     // const char                                    *pName
+					desc.fragmentConstants.IsEmpty() ? nullptr : &fragment_specialization_info // const VkSpecializationInfo   *pSpecializationInfo
+				}
+			};
+
+			VkPipelineVertexInputStateCreateInfo vertex_input_state_create_info = {
+				VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,    // VkStructureType                                sType
+				nullptr,                                                      // const void                                    *pNext
+				0,                                                            // VkPipelineVertexInputStateCreateFlags          flags;
+				static_cast<uint32_t>(desc.vertexBindings.size()),            // uint32_t                                       vertexBindingDescriptionCount
+				desc.vertexBindings.empty() ? nullptr : &desc.vertexBindings[0], // const VkVertexInputBindingDescription      *pVertexBindingDescriptions
+				static_cast<uint32_t>(desc.vertexAttributes.size()),          // uint32_t                                       vertexAttributeDescriptionCount
+				desc.vertexAttributes.empty() ? nullptr : &desc.vertexAttributes[0] // const VkVertexInputAttributeDescription *pVertexAttributeDescriptions
+			};
+
+			VkPipelineInputAssemblyStateCreateInfo input_assembly_state_create_info = {
+				VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,  // VkStructureType                                sType
+				nullptr,                                                      // const void                                    *pNext
+				0,                                                            // VkPipelineInputAssemblyStateCreateFlags        flags
+				desc.topology,                                                // VkPrimitiveTopology                            topology
+				VK_FALSE                                                      // VkBool32                                       primitiveRestartEnable
+			};
+
+			VkPipelineViewportStateCreateInfo viewport_state_create_info = {
+				VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,        // VkStructureType                                sType
+				nullptr,                                                      // const void                                    *pNext
+				0,                                                            // VkPipelineViewportStateCreateFlags             flags
+				1,                                                            // uint32_t                                       viewportCount
+				nullptr,                                                      // const VkViewport                              *pViewports
+				1,                                                            // uint32_t                                       scissorCount
+				nullptr                                                       // const VkRect2D                                *pScissors
+			};
+
+			VkPipelineRasterizationStateCreateInfo rasterization_state_create_info = {
+				VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,   // VkStructureType                                sType
+				nullptr,                                                      // const void                                    *pNext
+				0,                                                            // VkPipelineRasterizationStateCreateFlags        flags
+				VK_FALSE,                                                     // VkBool32                                       depthClampEnable
+				VK_FALSE,                                                     // VkBool32                                       rasterizerDiscardEnable
+				VK_POLYGON_MODE_FILL,                                         // VkPolygonMode                                  polygonMode
+				desc.cullMode,                                                // VkCullModeFlags                                cullMode
+				desc.frontFace,                                               // VkFrontFace                                    frontFace
+				VK_FALSE,                                                     // VkBool32                                       depthBiasEnable
+				0.0f,                                                         // float                                          depthBiasConstantFactor
+				0.0f,                                                         // float                                          depthBiasClamp
+				0.0f,                                                         // float                                          depthBiasSlopeFactor
+				1.0f                                                          // float                                          lineWidth
+			};
+
+			VkPipelineMultisampleStateCreateInfo multisample_state_create_info = {
+				VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,     // VkStructureType                                sType
+				nullptr,                                                      // const void                                    *pNext
+				0,                                                            // VkPipelineMultisampleStateCreateFlags          flags
+				VK_SAMPLE_COUNT_1_BIT,                                        // VkSampleCountFlagBits                          rasterizationSamples
+				VK_FALSE,                                                     // VkBool32                                       sampleShadingEnable
+				1.0f,                                                         // float                                          minSampleShading
+				nullptr,                                                      // const VkSampleMask                            *pSampleMask
+				VK_FALSE,                                                     // VkBool32                                       alphaToCoverageEnable
+				VK_FALSE                                                      // VkBool32                                       alphaToOneEnable
+			};
+
+			VkPipelineColorBlendStateCreateInfo color_blend_state_create_info = {
+				VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,     // VkStructureType                                sType
+				nullptr,                                                      // const void                                    *pNext
+				0,                                                            // VkPipelineColorBlendStateCreateFlags           flags
+				VK_FALSE,                                                     // VkBool32                                       logicOpEnable
+				VK_LOGIC_OP_COPY,                                             // VkLogicOp                                      logicOp
+				1,                                                            // uint32_t                                       attachmentCount
+				&desc.blend,                                                  // const VkPipelineColorBlendAttachmentState     *pAttachments
+				{ 0.0f, 0.0f, 0.0f, 0.0f }                                    // float                                          blendConstants[4]
+			};
+
+			VkDynamicState dynamic_states[] = {
+				VK_DYNAMIC_STATE_VIEWPORT,
+				VK_DYNAMIC_STATE_SCISSOR,
+			};
+
+			VkPipelineDynamicStateCreateInfo dynamic_state_create_info = {
+				VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,         // VkStructureType                                sType
+				nullptr,                                                      // const void                                    *pNext
+				0,                                                            // VkPipelineDynamicStateCreateFlags              flags
+				2,                                                            // uint32_t                                       dynamicStateCount
+				dynamic_states                                                // const VkDynamicState                          *pDynamicStates
+			};
+
+			VkGraphicsPipelineCreateInfo pipeline_create_info = {
+				VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,              // VkStructureType                                sType
+				nullptr,                                                      // const void                                    *pNext
+				0,                                                            // VkPipelineCreateFlags                          flags
+				2,                                                            // uint32_t                                       stageCount
+				shader_stage_create_infos,                                    // const VkPipelineShaderStageCreateInfo         *pStages
+				&vertex_input_state_create_info,                              // const VkPipelineVertexInputStateCreateInfo    *pVertexInputState;
+				&input_assembly_state_create_info,                            // const VkPipelineInputAssemblyStateCreateInfo  *pInputAssemblyState
+				nullptr,                                                      // const VkPipelineTessellationStateCreateInfo   *pTessellationState
+				&viewport_state_create_info,                                  // const VkPipelineViewportStateCreateInfo       *pViewportState
+				&rasterization_state_create_info,                             // const VkPipelineRasterizationStateCreateInfo  *pRasterizationState
+				&multisample_state_create_info,                               // const VkPipelineMultisampleStateCreateInfo    *pMultisampleState
+				nullptr,                                                      // const VkPipelineDepthStencilStateCreateInfo   *pDepthStencilState
+				&color_blend_state_create_info,                               // const VkPipelineColorBlendStateCreateInfo     *pColorBlendState
+				&dynamic_state_create_info,                                   // const VkPipelineDynamicStateCreateInfo        *pDynamicState
+				desc.layout,                                                  // VkPipelineLayout                               layout
+				desc.renderPass,                                              // VkRenderPass                                   renderPass
+				desc.subpass,                                                 // uint32_t                                       subpass
+				VK_NULL_HANDLE,                                               // VkPipeline                                     basePipelineHandle
+				-1                                                            // int32_t                                        basePipelineIndex
+			};
+
+			// The pipeline cache is internally synchronized, workers share it
+			if (vkCreateGraphicsPipelines(m_Device, m_PipelineCache, 1, &pipeline_create_info, nullptr, &pipeline) != VK_SUCCESS) {
+				std::cout << "Could not create graphics pipeline from \"" << desc.vertexShader << "\" and \"" << desc.fragmentShader << "\"!" << std::endl;
+				pipeline = VK_NULL_HANDLE;
+			}
+		}
+
+		// Published under the lock so Wait() cannot miss the notification
+		{
+			std::lock_guard<std::mutex> lock(m_QueueMutex);
+			entry.handle = pipeline;
+			entry.state = (pipeline != VK_NULL_HANDLE) ? PIPELINE_READY : PIPELINE_FAILED;
+			--m_PendingCount;
+			++m_CompletedCount;
+		}
+		m_CompletedCondition.notify_all();
+	}
+
+	PipelinePermutations::PipelinePermutations() :
+		m_Registry(nullptr),
+		m_BaseDesc(),
+		m_BaseFeatures(0),
+		m_BasePipeline(PipelineRegistry::INVALID_PIPELINE),
+		m_Features(),
+		m_Variants()
+	{
+	}
+
+	void PipelinePermutations::Initialize(PipelineRegistry *registry, const GraphicsPipelineDesc &base_desc, uint32_t base_features)
+	{
+		m_Registry = registry;
+		m_BaseDesc = base_desc;
+		m_BaseFeatures = base_features;
+		m_BasePipeline = PipelineRegistry::INVALID_PIPELINE;
+		m_Features.clear();
+		m_Variants.clear();
+	}
+
+	void PipelinePermutations::AddFeature(uint32_t feature_bit, VkShaderStageFlagBits stage, uint32_t constant_id)
+	{
+		Feature feature = { feature_bit, stage, constant_id };
+		m_Features.push_back(feature);
+	}
+
+	uint32_t PipelinePermutations::Get(uint32_t features)
+	{
+		if (m_Registry == nullptr) {
+			return PipelineRegistry::INVALID_PIPELINE;
+		}
+		// Looked up every frame, so the description is only built and hashed once per variant
+		std::map<uint32_t, uint32_t>::const_iterator it = m_Variants.find(features);
+		if (it != m_Variants.end()) {
+			return it->second;
+		}
+		if ((features != m_BaseFeatures) && (m_BasePipeline == PipelineRegistry::INVALID_PIPELINE)) {
+			m_BasePipeline = Get(m_BaseFeatures);
+		}
+
+		GraphicsPipelineDesc desc = m_BaseDesc;
+		for (size_t i = 0; i < m_Features.size(); ++i) {
+			uint32_t value = (features & m_Features[i].bit) ? VK_TRUE : VK_FALSE;
+			if (m_Features[i].stage == VK_SHADER_STAGE_VERTEX_BIT) {
+				desc.vertexConstants.Set(m_Features[i].constantID, value);
+			}
+			else {
+				desc.fragmentConstants.Set(m_Features[i].constantID, value);
+			}
+		}
+		uint32_t pipeline = m_Registry->Request(desc, (features != m_BaseFeatures) ? m_BasePipeline : PipelineRegistry::INVALID_PIPELINE);
+		if (features == m_BaseFeatures) {
+			m_BasePipeline = pipeline;
+		}
+		m_Variants[features] = pipeline;
+		return pipeline;
+	}
+
+	uint32_t PipelinePermutations::GetVariantCount() const
+	{
+		return static_cast<uint32_t>(m_Variants.size());
+	}
+}
+#endif
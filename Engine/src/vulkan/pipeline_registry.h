@@ -0,0 +1,147 @@
+#ifdef USE_RENDER_VULKAN
+#ifndef PIPELINE_REGISTRY_H
+#define PIPELINE_REGISTRY_H
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "vulkan_functions.h"
+
+namespace HelloEngine
+{
+	// Values for a shader stage's specialization constants, laid out the way
+	// VkSpecializationInfo expects. Constant IDs the module does not declare are ignored.
+	class SpecializationConstants {
+	public:
+		SpecializationConstants();
+
+		void					Set(uint32_t constant_id, uint32_t value);
+		bool					IsEmpty() const;
+		VkSpecializationInfo	GetInfo() const;
+		void					Hash(uint64_t &hash) const;
+		bool					operator==(const SpecializationConstants &other) const;
+	private:
+		std::vector<VkSpecializationMapEntry>	m_Entries;
+		std::vector<uint32_t>					m_Data;
+	};
+
+	// Everything a graphics pipeline is built from. Viewport and scissor are
+	// dynamic and multisampling is off in every pipeline, so they are not part of it.
+	struct GraphicsPipelineDesc {
+		std::string                                    vertexShader;
+		std::string                                    fragmentShader;
+		SpecializationConstants                        vertexConstants;
+		SpecializationConstants                        fragmentConstants;
+		std::vector<VkVertexInputBindingDescription>   vertexBindings;
+		std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+		VkPrimitiveTopology                            topology;
+		VkCullModeFlags                                cullMode;
+		VkFrontFace                                    frontFace;
+		VkPipelineColorBlendAttachmentState            blend;
+		VkPipelineLayout                               layout;
+		VkRenderPass                                   renderPass;
+		uint32_t                                       subpass;
+
+		GraphicsPipelineDesc();
+
+		uint64_t GetHash() const;
+		bool     operator==(const GraphicsPipelineDesc &other) const;
+	};
+
+	// Owns every graphics pipeline, keyed by a hash of its description, so
+	// identical requests share one VkPipeline. Pipelines are compiled by worker
+	// threads; until one is ready Get() returns the fallback it was requested
+	// with, letting new variants show up without stalling a frame.
+	// Request(), Get() and CollectCompleted() belong to the render thread.
+	class PipelineRegistry {
+	public:
+		static const uint32_t	INVALID_PIPELINE = UINT32_MAX;
+
+		PipelineRegistry();
+		~PipelineRegistry();
+
+		void					Initialize(VkDevice device, VkPipelineCache pipeline_cache, uint32_t worker_count);
+		void					Destroy();
+		uint32_t				Request(const GraphicsPipelineDesc &desc, uint32_t fallback = INVALID_PIPELINE);
+		bool					Wait(uint32_t pipeline);
+		VkPipeline				Get(uint32_t pipeline) const;
+		const GraphicsPipelineDesc &GetDesc(uint32_t pipeline) const;
+		bool					IsReady(uint32_t pipeline) const;
+		bool					CollectCompleted();
+		uint32_t				GetPipelineCount() const;
+		uint32_t				GetPendingCount() const;
+		uint64_t				GetDeduplicatedCount() const;
+	private:
+		enum PipelineState {
+			PIPELINE_PENDING,
+			PIPELINE_READY,
+			PIPELINE_FAILED
+		};
+
+		struct PipelineEntry {
+			GraphicsPipelineDesc     desc;
+			uint64_t                 hash;
+			uint32_t                 fallback;
+			VkPipeline               handle;
+			std::atomic<uint32_t>    state;
+		};
+
+		void					WorkerLoop();
+		void					Compile(PipelineEntry &entry);
+		VkShaderModule			GetShaderModule(const std::string &filename);
+
+		VkDevice										m_Device;
+		VkPipelineCache									m_PipelineCache;
+		std::vector<std::unique_ptr<PipelineEntry>>		m_Pipelines;
+		std::unordered_multimap<uint64_t, uint32_t>		m_PipelinesByHash;
+		uint64_t										m_DeduplicatedCount;
+		std::vector<std::thread>						m_Workers;
+		std::deque<PipelineEntry*>						m_Queue;
+		std::mutex										m_QueueMutex;
+		std::condition_variable							m_QueueCondition;
+		std::condition_variable							m_CompletedCondition;
+		std::atomic<uint32_t>							m_PendingCount;
+		std::atomic<uint32_t>							m_CompletedCount;
+		uint32_t										m_CollectedCount;
+		bool											m_Stopping;
+		std::map<std::string, VkShaderModule>			m_ShaderModules;
+		std::mutex										m_ShaderMutex;
+	};
+
+	// Variants of one pipeline told apart by feature bits, each bit switching a
+	// boolean specialization constant so the driver folds the branches it guards.
+	// A variant is requested from the registry the first time its bits are asked
+	// for and draws with the base pipeline until it has been compiled.
+	class PipelinePermutations {
+	public:
+		PipelinePermutations();
+
+		void					Initialize(PipelineRegistry *registry, const GraphicsPipelineDesc &base_desc, uint32_t base_features);
+		void					AddFeature(uint32_t feature_bit, VkShaderStageFlagBits stage, uint32_t constant_id);
+		// INVALID_PIPELINE until Initialize() has run
+		uint32_t				Get(uint32_t features);
+		uint32_t				GetVariantCount() const;
+	private:
+		struct Feature {
+			uint32_t              bit;
+			VkShaderStageFlagBits stage;
+			uint32_t              constantID;
+		};
+
+		PipelineRegistry				   *m_Registry;
+		GraphicsPipelineDesc				m_BaseDesc;
+		uint32_t							m_BaseFeatures;
+		uint32_t							m_BasePipeline;
+		std::vector<Feature>				m_Features;
+		std::map<uint32_t, uint32_t>		m_Variants;
+	};
+}
+#endif
+#endif
@@ -0,0 +1,292 @@
+#ifdef USE_RENDER_VULKAN
+#include "render_graph.h"
+
+namespace HelloEngine
+{
+	namespace
+	{
+		struct AccessInfo {
+			VkPipelineStageFlags stage;
+			VkAccessFlags        access;
+			VkImageLayout        layout;
+		};
+
+		AccessInfo GetAccessInfo(GraphAccess access)
+		{
+			switch (access) {
+			case GraphAccess::TransferRead:
+				return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+			case GraphAccess::TransferWrite:
+				return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+			case GraphAccess::ComputeRead:
+				return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL };
+			case GraphAccess::ComputeWrite:
+				return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+			case GraphAccess::IndirectRead:
+				return { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+			case GraphAccess::VertexAttributeRead:
+				return { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+			case GraphAccess::UniformRead:
+				return { VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+			case GraphAccess::FragmentSampledRead:
+				return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+			case GraphAccess::ColorAttachmentWrite:
+				return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+			case GraphAccess::Present:
+			default:
+				return { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+			}
+		}
+
+		const VkAccessFlags WRITE_ACCESS_MASK =
+			VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+			VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	}
+
+	RenderGraph::RenderGraph() :
+		m_Resources(),
+		m_Passes(),
+		m_FinalBarrier(),
+		m_BarrierCount(0),
+		m_CulledPassCount(0)
+	{
+	}
+
+	void RenderGraph::Reset()
+	{
+		m_Resources.clear();
+		m_Passes.clear();
+	}
+
+	uint32_t RenderGraph::ImportBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkPipelineStageFlags stage, VkAccessFlags access)
+	{
+		Resource resource = {};
+		resource.buffer = buffer;
+		resource.offset = offset;
+		resource.size = size;
+		// Earlier writes have to become visible, earlier reads only have to finish before the next write
+		resource.state.writeStage = (access & WRITE_ACCESS_MASK) ? stage : 0;
+		resource.state.writeAccess = access & WRITE_ACCESS_MASK;
+		resource.state.readStages = (access & WRITE_ACCESS_MASK) ? 0 : stage;
+		resource.state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		m_Resources.push_back(resource);
+		return static_cast<uint32_t>(m_Resources.size() - 1);
+	}
+
+	uint32_t RenderGraph::ImportImage(VkImage image, const VkImageSubresourceRange &range, VkImageLayout layout, VkPipelineStageFlags stage, VkAccessFlags access)
+	{
+		uint32_t index = ImportBuffer(VK_NULL_HANDLE, 0, 0, stage, access);
+		Resource &resource = m_Resources[index];
+		resource.isImage = true;
+		resource.image = image;
+		resource.range = range;
+		resource.state.layout = layout;
+		return index;
+	}
+
+	void RenderGraph::SetOutput(uint32_t resource, GraphAccess access, uint32_t src_family, uint32_t dst_family)
+	{
+		m_Resources[resource].output = true;
+		m_Resources[resource].outputAccess = access;
+		m_Resources[resource].srcFamily = src_family;
+		m_Resources[resource].dstFamily = dst_family;
+	}
+
+	uint32_t RenderGraph::AddPass(const char *name, PassCallback callback)
+	{
+		Pass pass;
+		pass.name = name;
+		pass.callback = callback;
+		pass.alive = false;
+		m_Passes.push_back(pass);
+		return static_cast<uint32_t>(m_Passes.size() - 1);
+	}
+
+	void RenderGraph::Read(uint32_t pass, uint32_t resource, GraphAccess access)
+	{
+		PassAccess pass_access = { resource, access, false };
+		m_Passes[pass].accesses.push_back(pass_access);
+	}
+
+	void RenderGraph::Write(uint32_t pass, uint32_t resource, GraphAccess access)
+	{
+		PassAccess pass_access = { resource, access, true };
+		m_Passes[pass].accesses.push_back(pass_access);
+	}
+
+	bool RenderGraph::CullPasses()
+	{
+		// Walking backwards, a pass survives if it writes an output or something a surviving pass reads
+		std::vector<bool> needed(m_Resources.size(), false);
+		for (size_t i = 0; i < m_Resources.size(); ++i) {
+			needed[i] = m_Resources[i].output;
+		}
+		m_CulledPassCount = 0;
+		for (size_t i = m_Passes.size(); i-- > 0;) {
+			Pass &pass = m_Passes[i];
+			pass.alive = false;
+			for (size_t j = 0; j < pass.accesses.size(); ++j) {
+				if (pass.accesses[j].write && needed[pass.accesses[j].resource]) {
+					pass.alive = true;
+				}
+			}
+			if (!pass.alive) {
+				++m_CulledPassCount;
+				continue;
+			}
+			for (size_t j = 0; j < pass.accesses.size(); ++j) {
+				const PassAccess &access = pass.accesses[j];
+				if (!access.write) {
+					needed[access.resource] = true;
+				}
+			}
+		}
+		return true;
+	}
+
+	void RenderGraph::AddBarrier(Barrier &barrier, Resource &resource, GraphAccess access, bool write, uint32_t src_family, uint32_t dst_family)
+	{
+		AccessInfo info = GetAccessInfo(access);
+		ResourceState &state = resource.state;
+		bool layout_change = resource.isImage && (info.layout != state.layout);
+		bool family_change = (src_family != dst_family);
+
+		VkPipelineStageFlags src_stage = state.writeStage;
+		bool needed;
+		if (write || layout_change) {
+			// Writes and layout transitions wait for earlier reads too, not only for earlier writes
+			src_stage |= state.readStages;
+			needed = (src_stage != 0) || layout_change || family_change;
+		}
+		else {
+			bool visible = (state.writeAccess == 0) ||
+				(((info.stage & ~state.visibleStages) == 0) && ((info.access & ~state.visibleAccess) == 0));
+			needed = !visible || family_change;
+		}
+
+		if (needed) {
+			barrier.srcStage |= src_stage;
+			barrier.dstStage |= info.stage;
+			if (resource.isImage) {
+				VkImageMemoryBarrier image_memory_barrier = {
+					VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,             // VkStructureType                        sType
+					nullptr,                                            // const void                            *pNext
+					state.writeAccess,                                  // VkAccessFlags                          srcAccessMask
+					info.access,                                        // VkAccessFlags                          dstAccessMask
+					state.layout,                                       // VkImageLayout                          oldLayout
+					info.layout,                                        // VkImageLayout                          newLayout
+					family_change ? src_family : VK_QUEUE_FAMILY_IGNORED, // uint32_t                               srcQueueFamilyIndex
+					family_change ? dst_family : VK_QUEUE_FAMILY_IGNORED, // uint32_t                               dstQueueFamilyIndex
+					resource.image,                                     // VkImage                                image
+					resource.range                                      // VkImageSubresourceRange                subresourceRange
+				};
+				barrier.imageBarriers.push_back(image_memory_barrier);
+			}
+			else {
+				VkBufferMemoryBarrier buffer_memory_barrier = {
+					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,            // VkStructureType                        sType
+					nullptr,                                            // const void                            *pNext
+					state.writeAccess,                                  // VkAccessFlags                          srcAccessMask
+					info.access,                                        // VkAccessFlags                          dstAccessMask
+					family_change ? src_family : VK_QUEUE_FAMILY_IGNORED, // uint32_t                               srcQueueFamilyIndex
+					family_change ? dst_family : VK_QUEUE_FAMILY_IGNORED, // uint32_t                               dstQueueFamilyIndex
+					resource.buffer,                                    // VkBuffer                               buffer
+					resource.offset,                                    // VkDeviceSize                           offset
+					resource.size                                       // VkDeviceSize                           size
+				};
+				barrier.bufferBarriers.push_back(buffer_memory_barrier);
+			}
+			++m_BarrierCount;
+		}
+
+		if (write) {
+			state.writeStage = info.stage;
+			state.writeAccess = info.access & WRITE_ACCESS_MASK;
+			state.readStages = 0;
+			state.visibleStages = 0;
+			state.visibleAccess = 0;
+		}
+		else if (layout_change) {
+			// The transition made everything written before visible to this access
+			state.writeStage = 0;
+			state.writeAccess = 0;
+			state.readStages = info.stage;
+		}
+		else {
+			state.readStages |= info.stage;
+			if (needed) {
+				state.visibleStages |= info.stage;
+				state.visibleAccess |= info.access;
+			}
+		}
+		if (resource.isImage) {
+			state.layout = info.layout;
+		}
+	}
+
+	bool RenderGraph::Compile()
+	{
+		m_BarrierCount = 0;
+		if (!CullPasses()) {
+			return false;
+		}
+
+		for (size_t i = 0; i < m_Passes.size(); ++i) {
+			Pass &pass = m_Passes[i];
+			pass.barrier = Barrier();
+			if (!pass.alive) {
+				continue;
+			}
+			for (size_t j = 0; j < pass.accesses.size(); ++j) {
+				const PassAccess &access = pass.accesses[j];
+				AddBarrier(pass.barrier, m_Resources[access.resource], access.access, access.write, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+			}
+		}
+
+		m_FinalBarrier = Barrier();
+		for (size_t i = 0; i < m_Resources.size(); ++i) {
+			Resource &resource = m_Resources[i];
+			if (resource.output) {
+				AddBarrier(m_FinalBarrier, resource, resource.outputAccess, false, resource.srcFamily, resource.dstFamily);
+			}
+		}
+		return true;
+	}
+
+	void RenderGraph::RecordBarrier(VkCommandBuffer command_buffer, const Barrier &barrier)
+	{
+		if (barrier.bufferBarriers.empty() && barrier.imageBarriers.empty()) {
+			return;
+		}
+		vkCmdPipelineBarrier(command_buffer,
+			(barrier.srcStage != 0) ? barrier.srcStage : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT),
+			(barrier.dstStage != 0) ? barrier.dstStage : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT),
+			0, 0, nullptr,
+			static_cast<uint32_t>(barrier.bufferBarriers.size()), barrier.bufferBarriers.empty() ? nullptr : &barrier.bufferBarriers[0],
+			static_cast<uint32_t>(barrier.imageBarriers.size()), barrier.imageBarriers.empty() ? nullptr : &barrier.imageBarriers[0]);
+	}
+
+	void RenderGraph::Execute(VkCommandBuffer command_buffer)
+	{
+		for (size_t i = 0; i < m_Passes.size(); ++i) {
+			const Pass &pass = m_Passes[i];
+			if (!pass.alive) {
+				continue;
+			}
+			RecordBarrier(command_buffer, pass.barrier);
+			pass.callback(command_buffer);
+		}
+		RecordBarrier(command_buffer, m_FinalBarrier);
+	}
+
+	uint32_t RenderGraph::GetBarrierCount() const
+	{
+		return m_BarrierCount;
+	}
+
+	uint32_t RenderGraph::GetCulledPassCount() const
+	{
+		return m_CulledPassCount;
+	}
+}
+#endif
@@ -0,0 +1,104 @@
+#ifdef USE_RENDER_VULKAN
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+#pragma once
+#include <functional>
+#include <vector>
+#include "vulkan_functions.h"
+
+namespace HelloEngine
+{
+	// How a pass touches a resource; each access implies a stage, access mask and image layout
+	enum class GraphAccess {
+		TransferRead, TransferWrite,
+		ComputeRead, ComputeWrite,
+		IndirectRead, VertexAttributeRead, UniformRead,
+		FragmentSampledRead, ColorAttachmentWrite,
+		Present
+	};
+
+	// Passes declare the buffers and images they read and write; Compile()
+	// drops passes whose results nobody uses and places the barriers and
+	// layout transitions between the rest. A graph is rebuilt every time a
+	// command buffer is recorded.
+	class RenderGraph {
+	public:
+		typedef std::function<void(VkCommandBuffer)> PassCallback;
+
+		RenderGraph();
+
+		void					Reset();
+
+		// Resources created outside the graph, with the last stage and access that touched them
+		uint32_t				ImportBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkPipelineStageFlags stage, VkAccessFlags access);
+		uint32_t				ImportImage(VkImage image, const VkImageSubresourceRange &range, VkImageLayout layout, VkPipelineStageFlags stage, VkAccessFlags access);
+		// Leaves the resource in access when the graph ends, handing it from src_family to dst_family if they differ
+		void					SetOutput(uint32_t resource, GraphAccess access, uint32_t src_family = VK_QUEUE_FAMILY_IGNORED, uint32_t dst_family = VK_QUEUE_FAMILY_IGNORED);
+
+		uint32_t				AddPass(const char *name, PassCallback callback);
+		void					Read(uint32_t pass, uint32_t resource, GraphAccess access);
+		void					Write(uint32_t pass, uint32_t resource, GraphAccess access);
+
+		bool					Compile();
+		void					Execute(VkCommandBuffer command_buffer);
+
+		uint32_t				GetBarrierCount() const;
+		uint32_t				GetCulledPassCount() const;
+	private:
+		struct ResourceState {
+			VkPipelineStageFlags   writeStage;
+			VkAccessFlags          writeAccess;
+			VkPipelineStageFlags   readStages;
+			VkPipelineStageFlags   visibleStages;
+			VkAccessFlags          visibleAccess;
+			VkImageLayout          layout;
+		};
+
+		struct Resource {
+			bool                    isImage;
+			VkBuffer                buffer;
+			VkDeviceSize            offset;
+			VkDeviceSize            size;
+			VkImage                 image;
+			VkImageSubresourceRange range;
+			ResourceState           state;
+			bool                    output;
+			GraphAccess             outputAccess;
+			uint32_t                srcFamily;
+			uint32_t                dstFamily;
+		};
+
+		struct PassAccess {
+			uint32_t                resource;
+			GraphAccess             access;
+			bool                    write;
+		};
+
+		struct Barrier {
+			VkPipelineStageFlags                srcStage;
+			VkPipelineStageFlags                dstStage;
+			std::vector<VkBufferMemoryBarrier>  bufferBarriers;
+			std::vector<VkImageMemoryBarrier>   imageBarriers;
+		};
+
+		struct Pass {
+			const char             *name;
+			PassCallback            callback;
+			std::vector<PassAccess> accesses;
+			bool                    alive;
+			Barrier                 barrier;
+		};
+
+		bool					CullPasses();
+		void					AddBarrier(Barrier &barrier, Resource &resource, GraphAccess access, bool write, uint32_t src_family, uint32_t dst_family);
+		static void				RecordBarrier(VkCommandBuffer command_buffer, const Barrier &barrier);
+
+		std::vector<Resource>				m_Resources;
+		std::vector<Pass>					m_Passes;
+		Barrier								m_FinalBarrier;
+		uint32_t							m_BarrierCount;
+		uint32_t							m_CulledPassCount;
+	};
+}
+#endif
+#endif
@@ -4,12 +4,21 @@
 #include "renderer.h"
 #include <string.h>
 #include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cstddef>
+#include <cmath>
 
 namespace HelloEngine
 {
-	bool Renderer::Initialize(WindowParameters *parameters, const std::vector<float>& vertex_data, Color color)
+	bool Renderer::Initialize(WindowParameters *parameters, const std::vector<float>& vertex_data, Color color, uint32_t frames_in_flight)
 	{
-		return m_Params->Initialize(parameters, vertex_data, color);
+		return m_Params->Initialize(parameters, vertex_data, std::vector<uint32_t>(), color, frames_in_flight);
+	}
+
+	bool Renderer::Initialize(WindowParameters *parameters, const Mesh& mesh, Color color, uint32_t frames_in_flight)
+	{
+		return m_Params->Initialize(parameters, mesh.vertices, mesh.indices, color, frames_in_flight);
 	}
 
 	bool Renderer::OnWindowSizeChanged()
@@ -27,6 +36,91 @@ namespace HelloEngine
 		return m_Params->Draw();
 	}	
 
+	RendererStatistics Renderer::GetStatistics() const
+	{
+		return m_Params->GetStatistics();
+	}
+
+	MemoryStatistics Renderer::GetMemoryStatistics() const
+	{
+		return m_Params->GetMemoryStatistics();
+	}
+
+	void Renderer::SetCommandBufferMode(CommandBufferMode mode)
+	{
+		m_Params->SetCommandBufferMode(mode);
+	}
+
+	void Renderer::MarkSceneDirty()
+	{
+		m_Params->MarkDirty(DIRTY_SCENE_BIT);
+	}
+
+	bool Renderer::SetPresentMode(PresentMode mode)
+	{
+		return m_Params->SetPresentMode(mode);
+	}
+
+	PresentMode Renderer::GetPresentMode() const
+	{
+		return m_Params->GetPresentMode();
+	}
+
+	bool Renderer::UpdateVertexData(const std::vector<float>& vertex_data, uint32_t offset)
+	{
+		return m_Params->UpdateVertexData(vertex_data, offset);
+	}
+
+	bool Renderer::AppendVertexData(const std::vector<float>& vertex_data)
+	{
+		return m_Params->AppendVertexData(vertex_data);
+	}
+
+	bool Renderer::SetVertexData(const std::vector<float>& vertex_data)
+	{
+		return m_Params->SetVertexData(vertex_data);
+	}
+
+	bool Renderer::DrawSprites(const std::vector<Sprite>& sprites)
+	{
+		return m_Params->DrawSprites(sprites);
+	}
+
+	void Renderer::SetSpriteCullSettings(const CullSettings& settings)
+	{
+		m_Params->SetSpriteCullSettings(settings);
+	}
+
+	bool Renderer::SetSpriteLayerTint(uint32_t layer, Color tint)
+	{
+		return m_Params->SetSpriteLayerTint(layer, tint);
+	}
+
+	CullRect Renderer::GetViewRect() const
+	{
+		return m_Params->GetViewRect();
+	}
+
+	bool Renderer::DrawInstances(const std::vector<Instance>& instances)
+	{
+		return m_Params->DrawInstances(instances);
+	}
+
+	bool Renderer::SetGpuCulling(bool enabled)
+	{
+		return m_Params->SetGpuCulling(enabled);
+	}
+
+	void Renderer::SetSpriteBlending(bool enabled)
+	{
+		m_Params->SetSpriteBlending(enabled);
+	}
+
+	void Renderer::SetInstanceFeatures(uint32_t features)
+	{
+		m_Params->SetInstanceFeatures(features);
+	}
+
 	RenderParameters::RenderParameters() :
 		m_CanRender(false),
 	    m_Instance(nullptr),
@@ -36,25 +130,94 @@ namespace HelloEngine
 		m_PresentQueueCmdPool(VK_NULL_HANDLE),
 		m_RenderPass(VK_NULL_HANDLE),
 		m_GraphicsPipeline(VK_NULL_HANDLE),
+		m_TriangleListPipeline(VK_NULL_HANDLE),
+		m_InstancedPipeline(VK_NULL_HANDLE),
+		m_InstancedTriangleListPipeline(VK_NULL_HANDLE),
 		m_CommandPool(VK_NULL_HANDLE),
+		m_TransferCommandPool(VK_NULL_HANDLE),
 		m_Window(),
 		m_GraphicsQueue(),
 		m_PresentQueue(),
+		m_TransferQueue(),
+		m_TransferImageGranularity(),
+		m_TransferSubmitCount(0),
 		m_SwapChain(),
 		m_VertexBuffer(),
+		m_IndexBuffer(),
+		m_IndexType(VK_INDEX_TYPE_UINT16),
+		m_IndexCount(0),
+		m_IndexedVertexCount(0),
+		m_VertexStream(),
+		m_DynamicVertexBuffers(),
+		m_DynamicVertexCapacity(0),
+		m_RetiredBuffers(),
+		m_SpriteBatch(),
+		m_SpriteDraws(),
+		m_RenderQueue(),
+		m_RenderGraph(),
+		m_PipelineCache(),
+		m_PipelineRegistry(),
+		m_LayoutCache(),
+		m_MeshLayout(),
+		m_DescriptorAllocator(),
+		m_SpritePipeline(PipelineRegistry::INVALID_PIPELINE),
+		m_BlendedSpritePipeline(PipelineRegistry::INVALID_PIPELINE),
+		m_SpriteBlending(false),
+		m_InstancedPermutations(),
+		m_InstanceFeatures(INSTANCE_FEATURE_TINT_BIT),
+		m_SpriteVertexBuffers(),
+		m_SpriteIndexBuffer(),
+		m_SpriteCapacity(0),
+		m_SpriteCullSettings(),
+		m_SpriteLayerTints(MAX_SPRITE_LAYER + 1, Color{ 1.0f, 1.0f, 1.0f }),
+		m_Instances(),
+		m_InstanceBuffers(),
+		m_InstanceCount(0),
+		m_MeshRadius(0.0f),
+		m_GpuCulling(false),
+		m_VisibleInstanceBuffers(),
+		m_IndirectBuffers(),
+		m_CullDescriptorSetLayout(VK_NULL_HANDLE),
+		m_CullPipelineLayout(VK_NULL_HANDLE),
+		m_CullPipeline(VK_NULL_HANDLE),
 		m_StagingBuffer(),
+		m_StagingRing(),
+		m_BufferUploads(),
+		m_ImageUploads(),
+		m_UploadSubmits(),
 		m_UniformBuffer(),
+		m_UniformRing(),
 		m_Image(),
 		m_DescriptorSet(),
+		m_TextureDescriptorSets(),
 		m_PipelineLayout(),
-		m_RenderingResources(RESOURCE_COUNT),
-		m_VulkanLibrary()
+		m_RenderingResources(),
+		m_ResourceIndex(0),
+		m_FrameIndex(0),
+		m_SubmitCount(0),
+		m_GraphicsTimeline(VK_NULL_HANDLE),
+		m_InstanceExtensions(),
+		m_DeviceExtensions(),
+		m_RetiredSwapChains(),
+		m_CommandBufferMode(CommandBufferMode::RecordEachFrame),
+		m_RequestedPresentMode(PresentMode::LowLatency),
+		m_PresentMode(VK_PRESENT_MODE_FIFO_KHR),
+		m_RecordedCommandBuffers(),
+		m_VulkanLibrary(),
+		m_MemoryAllocator(),
+		m_Statistics()
 	{
 	}
 
-	bool RenderParameters::Initialize(WindowParameters *parameters, const std::vector<float>& vertex_data, Color color) {
+	bool RenderParameters::Initialize(WindowParameters *parameters, const std::vector<float>& vertex_data, const std::vector<uint32_t>& index_data, Color color, uint32_t frames_in_flight) {
 		m_Window = parameters;
 		m_ClearColor = color;
+		if (frames_in_flight == 0) {
+			std::cout << "At least one frame in flight is required!" << std::endl;
+			return false;
+		}
+		m_RenderingResources.resize(frames_in_flight);
+		m_ResourceIndex = 0;
 		if (!LoadVulkanLibrary()) {
 			return false;
 		}
@@ -82,6 +245,9 @@ namespace HelloEngine
 		if (!GetDeviceQueue()) {
 			return false;
 		}
+		m_MemoryAllocator.Initialize(m_PhysicalDevice, m_Device);
+		m_LayoutCache.Initialize(m_Device);
+		m_DescriptorAllocator.Initialize(m_Device, frames_in_flight);
 		if (!CreateSwapChain()) {
 			return false;
 		}		
@@ -100,27 +266,50 @@ namespace HelloEngine
 		if (!CreateUniformBuffer()) {
 			return false;
 		}
-		if (!CreateDescriptorPool()) {
-			return false;
-		}
-		if (!AllocateDescriptorSet()) {
-			return false;
-		}
 		if (!UpdateDescriptorSet()) {
 			return false;
 		}
 		if (!CreateRenderPass()) {
 			return false;
 		}
+		if (!CreateFramebuffers()) {
+			return false;
+		}
 		if (!CreatePipelineLayout()) {
 			return false;
 		}
+		if (!m_PipelineCache.Initialize(m_PhysicalDevice, m_Device, PIPELINE_CACHE_FILENAME)) {
+			std::cout << "Pipelines will be compiled without a cache!" << std::endl;
+		}
+		m_PipelineRegistry.Initialize(m_Device, m_PipelineCache.GetHandle(), PIPELINE_COMPILE_THREADS);
+		auto pipeline_start = std::chrono::high_resolution_clock::now();
 		if (!CreatePipeline()) {
 			return false;
 		}
+		if (!CreateCullingResources()) {
+			std::cout << "GPU culling is not available!" << std::endl;
+		}
+		std::chrono::duration<double, std::milli> pipeline_time = std::chrono::high_resolution_clock::now() - pipeline_start;
+		m_PipelineCache.SetCreationTime(pipeline_time.count());
+		m_Statistics.pipelineCreationMilliseconds = pipeline_time.count();
+		if (m_PipelineCache.IsWarm()) {
+			m_Statistics.pipelineCacheSavedMilliseconds = m_PipelineCache.GetColdCreationTime() - pipeline_time.count();
+		}
 		if (!CreateVertexBuffer(vertex_data)) {
 			return false;
 		}
+		if (!CreateIndexBuffer(index_data)) {
+			return false;
+		}
+		// All startup data goes to the GPU in one submission and is handed over to the
+		// graphics queue right away; frames are ordered after it, so nothing waits here
+		uint64_t upload_token;
+		if (!SubmitUploads(upload_token)) {
+			return false;
+		}
+		if (!SubmitHandOffs(true)) {
+			return false;
+		}
 		return true;
 	}	
 
@@ -129,35 +318,142 @@ namespace HelloEngine
 		return m_CanRender;
 	}
 
-	bool RenderParameters::OnWindowSizeChanged()
+	RendererStatistics RenderParameters::GetStatistics() const
+	{
+		RendererStatistics statistics = m_Statistics;
+		statistics.graphicsPipelines = m_PipelineRegistry.GetPipelineCount();
+		statistics.pendingGraphicsPipelines = m_PipelineRegistry.GetPendingCount();
+		statistics.deduplicatedPipelineRequests = m_PipelineRegistry.GetDeduplicatedCount();
+		statistics.descriptorPools = m_DescriptorAllocator.GetPoolCount();
+		statistics.cachedDescriptorSets = m_DescriptorAllocator.GetCachedSetCount();
+		statistics.descriptorSetCacheHits = m_DescriptorAllocator.GetCacheHitCount();
+		return statistics;
+	}
+
+	MemoryStatistics RenderParameters::GetMemoryStatistics() const
+	{
+		return m_MemoryAllocator.GetStatistics();
+	}
+
+	void RenderParameters::SetCommandBufferMode(CommandBufferMode mode)
+	{
+		if (m_CommandBufferMode != mode) {
+			m_CommandBufferMode = mode;
+			MarkDirty(DIRTY_SCENE_BIT);
+		}
+	}
+
+	bool RenderParameters::SetPresentMode(PresentMode mode)
+	{
+		if (m_RequestedPresentMode == mode) {
+			return true;
+		}
+		m_RequestedPresentMode = mode;
+		if (m_SwapChain.handle == VK_NULL_HANDLE) {
+			return true;
+		}
+		return OnWindowSizeChanged();
+	}
+
+	PresentMode RenderParameters::GetPresentMode() const
+	{
+		switch (m_PresentMode) {
+		case VK_PRESENT_MODE_MAILBOX_KHR:
+			return PresentMode::LowLatency;
+		case VK_PRESENT_MODE_IMMEDIATE_KHR:
+			return PresentMode::Uncapped;
+		default:
+			return PresentMode::VSync;
+		}
+	}
+
+	void RenderParameters::MarkDirty(uint32_t dirty_flags)
+	{
+		if (dirty_flags == 0) {
+			return;
+		}
+		for (size_t i = 0; i < m_RecordedCommandBuffers.size(); ++i) {
+			m_RecordedCommandBuffers[i].dirty = true;
+		}
+	}
+
+	bool RenderParameters::GetRecordedCommandBuffer(uint32_t image_index, VkCommandBuffer &command_buffer)
 	{
-		if (CreateSwapChain()) {
-			if (m_CanRender) {
-				if (m_Device != nullptr && m_StagingBuffer.handle != VK_NULL_HANDLE) {
-					vkDeviceWaitIdle(m_Device);
-					return CopyUniformBufferData();
+		// Buffers of a previous, larger swap chain may still be pending, so the list only ever grows
+		if (m_RecordedCommandBuffers.size() < m_SwapChain.images.size()) {
+			size_t first_new = m_RecordedCommandBuffers.size();
+			m_RecordedCommandBuffers.resize(m_SwapChain.images.size());
+			for (size_t i = first_new; i < m_RecordedCommandBuffers.size(); ++i) {
+				if (!AllocateCommandBuffers(m_CommandPool, 1, &m_RecordedCommandBuffers[i].handle)) {
+					std::cout << "Could not allocate command buffer!" << std::endl;
+					return false;
 				}
-				return true;
 			}
-			return true;
 		}
-		return false;
+
+		RecordedCommandBufferData &recorded = m_RecordedCommandBuffers[image_index];
+		if (recorded.dirty) {
+			if ((recorded.submitIndex != 0) && !WaitForSubmit(recorded.submitIndex)) {
+				return false;
+			}
+			if (!PrepareFrame(recorded.handle, m_SwapChain.images[image_index], m_SwapChain.framebuffers[image_index], VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT)) {
+				return false;
+			}
+			recorded.dirty = false;
+		}
+		recorded.submitIndex = m_SubmitCount + 1;
+		command_buffer = recorded.handle;
+		return true;
+	}
+
+	void RenderParameters::DestroyRecordedCommandBuffers()
+	{
+		for (size_t i = 0; i < m_RecordedCommandBuffers.size(); ++i) {
+			if (m_RecordedCommandBuffers[i].handle != nullptr) {
+				vkFreeCommandBuffers(m_Device, m_CommandPool, 1, &m_RecordedCommandBuffers[i].handle);
+			}
+		}
+		m_RecordedCommandBuffers.clear();
+	}
+
+	bool RenderParameters::OnWindowSizeChanged()
+	{
+		// Every frame writes the projection for the current extent, so only the swap chain changes
+		return CreateSwapChain();
 	}
 
 	bool RenderParameters::Draw()
 	{
-		static size_t           resource_index = 0;
-		RenderingResourcesData &current_rendering_resource = m_RenderingResources[resource_index];
+		RenderingResourcesData &current_rendering_resource = m_RenderingResources[m_ResourceIndex];
+		uint32_t                frame_index = static_cast<uint32_t>(m_ResourceIndex);
 		VkSwapchainKHR          swap_chain = m_SwapChain.handle;
 		uint32_t                image_index;
 
-		resource_index = (resource_index + 1) % RESOURCE_COUNT;
+		m_ResourceIndex = (m_ResourceIndex + 1) % m_RenderingResources.size();
 
-		if (vkWaitForFences(m_Device, 1, &current_rendering_resource.fence, VK_FALSE, 1000000000) != VK_SUCCESS) {
-			std::cout << "Waiting for fence takes too long!" << std::endl;
+		if (!IsSubmitCompleted(current_rendering_resource.submitIndex)) {
+			auto wait_start = std::chrono::high_resolution_clock::now();
+			if (!WaitForSubmit(current_rendering_resource.submitIndex)) {
+				return false;
+			}
+			std::chrono::duration<double, std::milli> wait_time = std::chrono::high_resolution_clock::now() - wait_start;
+			++m_Statistics.fenceWaits;
+			m_Statistics.fenceWaitMilliseconds += wait_time.count();
+		}
+		ReleaseRetiredSwapChains(false);
+		ReleaseRetiredBuffers(false);
+		ReclaimStagingMemory();
+		m_FrameIndex = frame_index;
+		// The frame that used this uniform region last has finished above
+		m_UniformRing.BeginFrame(frame_index);
+		m_DescriptorAllocator.BeginFrame(frame_index);
+		if (!SubmitHandOffs(false)) {
 			return false;
 		}
-		vkResetFences(m_Device, 1, &current_rendering_resource.fence);
+		// Pipelines finished in the background replace their fallbacks in recorded command buffers too
+		if (m_PipelineRegistry.CollectCompleted()) {
+			MarkDirty(DIRTY_SCENE_BIT);
+		}
 
 		VkResult result = vkAcquireNextImageKHR(m_Device, swap_chain, UINT64_MAX, current_rendering_resource.imageAvailableSemaphore, VK_NULL_HANDLE, &image_index);
 		switch (result) {
@@ -171,10 +467,38 @@ namespace HelloEngine
 			return false;
 		}
 
-		if (!PrepareFrame(current_rendering_resource.commandBuffer, m_SwapChain.images[image_index], current_rendering_resource.framebuffer)) {
+		if (!BuildSpriteBatch() || !BuildInstanceData()) {
 			return false;
 		}
 
+		// A replayed command buffer cannot follow per-frame geometry
+		VkCommandBuffer command_buffer = current_rendering_resource.commandBuffer;
+		if ((m_CommandBufferMode == CommandBufferMode::PreRecorded) && !UsesPerFrameGeometry()) {
+			if (!GetRecordedCommandBuffer(image_index, command_buffer)) {
+				return false;
+			}
+		}
+		else {
+			if (!PrepareFrame(command_buffer, m_SwapChain.images[image_index], m_SwapChain.framebuffers[image_index], VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT)) {
+				return false;
+			}
+		}
+		m_MemoryAllocator.Flush(m_UniformBuffer.memory, m_UniformRing.GetFrameOffset(), m_UniformRing.GetFrameUsedSize());
+
+		// With a timeline semaphore the frame signals its submit index instead of a fence
+		uint64_t    submit_index = m_SubmitCount + 1;
+		uint64_t    signal_values[] = { 0, submit_index };
+		VkSemaphore signal_semaphores[] = { current_rendering_resource.finishedRenderingSemaphore, m_GraphicsTimeline };
+		VkFence     submit_fence = current_rendering_resource.fence;
+		VkTimelineSemaphoreSubmitInfoKHR timeline_submit_info = {
+			VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,   // VkStructureType              sType
+			nullptr,                                                // const void                  *pNext
+			0,                                                      // uint32_t                     waitSemaphoreValueCount
+			nullptr,                                                // const uint64_t              *pWaitSemaphoreValues
+			2,                                                      // uint32_t                     signalSemaphoreValueCount
+			signal_values                                           // const uint64_t              *pSignalSemaphoreValues
+		};
+
 		VkPipelineStageFlags wait_dst_stage_mask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 		VkSubmitInfo submit_info = {
 			VK_STRUCTURE_TYPE_SUBMIT_INFO,                          // VkStructureType              sType
@@ -183,14 +507,25 @@ namespace HelloEngine
 			&current_rendering_resource.imageAvailableSemaphore,    // const VkSemaphore           *pWaitSemaphores
 			&wait_dst_stage_mask,                                   // const VkPipelineStageFlags  *pWaitDstStageMask;
 			1,                                                      // uint32_t                     commandBufferCount
-			&current_rendering_resource.commandBuffer,              // const VkCommandBuffer       *pCommandBuffers
+			&command_buffer,                                        // const VkCommandBuffer       *pCommandBuffers
 			1,                                                      // uint32_t                     signalSemaphoreCount
-			&current_rendering_resource.finishedRenderingSemaphore  // const VkSemaphore           *pSignalSemaphores
+			signal_semaphores                                       // const VkSemaphore           *pSignalSemaphores
 		};
+		if (m_GraphicsTimeline != VK_NULL_HANDLE) {
+			submit_info.pNext = &timeline_submit_info;
+			submit_info.signalSemaphoreCount = 2;
+			submit_fence = VK_NULL_HANDLE;
+		}
+		else {
+			// Reset right before the submission so an early return never leaves the fence unsignaled
+			vkResetFences(m_Device, 1, &current_rendering_resource.fence);
+		}
 
-		if (vkQueueSubmit(m_GraphicsQueue.handle, 1, &submit_info, current_rendering_resource.fence) != VK_SUCCESS) {
+		if (vkQueueSubmit(m_GraphicsQueue.handle, 1, &submit_info, submit_fence) != VK_SUCCESS) {
 			return false;
 		}
+		current_rendering_resource.submitIndex = m_SubmitCount = submit_index;
+		m_StagingRing.Tag(submit_index);
 
 		VkPresentInfoKHR present_info = {
 			VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,                     // VkStructureType              sType
@@ -215,6 +550,7 @@ namespace HelloEngine
 			return false;
 		}
 
+		++m_Statistics.frameCount;
 		return true;
 	}
 
@@ -246,6 +582,11 @@ namespace HelloEngine
 				return false;
 			}
 		}
+		// Optional, needed to query timeline semaphore support
+		if (CheckExtensionAvailability(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME, available_extensions)) {
+			instance_extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+		}
+		m_InstanceExtensions = instance_extensions;
 		VkApplicationInfo app_info{};
 		app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
 		app_info.pEngineName = "Test Engine";
@@ -275,6 +616,15 @@ namespace HelloEngine
 		return false;
 	}
 
+	bool RenderParameters::IsExtensionEnabled(const char *extension_name, const std::vector<const char*> &enabled_extensions) {
+		for (size_t i = 0; i < enabled_extensions.size(); ++i) {
+			if (strcmp(enabled_extensions[i], extension_name) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
 	bool RenderParameters::CreateDevice() {
 		uint32_t num_devices = 0;
 		if ((vkEnumeratePhysicalDevices(m_Instance, &num_devices, nullptr) != VK_SUCCESS) ||
@@ -325,13 +675,37 @@ namespace HelloEngine
 			});
 		}
 
+		uint32_t selected_transfer_queue_family_index = GetTransferQueueFamilyIndex(m_PhysicalDevice, selected_graphics_queue_family_index, m_TransferImageGranularity);
+		if ((selected_transfer_queue_family_index != selected_graphics_queue_family_index) &&
+			(selected_transfer_queue_family_index != selected_present_queue_family_index)) {
+			queue_create_infos.push_back({
+				VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,     // VkStructureType              sType
+				nullptr,                                        // const void                  *pNext
+				0,                                              // VkDeviceQueueCreateFlags     flags
+				selected_transfer_queue_family_index,           // uint32_t                     queueFamilyIndex
+				static_cast<uint32_t>(queue_priorities.size()), // uint32_t                     queueCount
+				&queue_priorities[0]                            // const float                 *pQueuePriorities
+			});
+		}
+
 		std::vector<const char*> extensions = {
 			VK_KHR_SWAPCHAIN_EXTENSION_NAME
 		};
 
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_semaphore_features = {
+			VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR, // VkStructureType       sType
+			nullptr,                                                           // void                 *pNext
+			VK_TRUE                                                            // VkBool32              timelineSemaphore
+		};
+		const void *device_create_info_next = nullptr;
+		if (CheckTimelineSemaphoreSupport(m_PhysicalDevice)) {
+			extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+			device_create_info_next = &timeline_semaphore_features;
+		}
+
 		VkDeviceCreateInfo device_create_info = {
 			VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,             // VkStructureType                    sType
-			nullptr,                                          // const void                        *pNext
+			device_create_info_next,                          // const void                        *pNext
 			0,                                                // VkDeviceCreateFlags                flags
 			static_cast<uint32_t>(queue_create_infos.size()), // uint32_t                           queueCreateInfoCount
 			&queue_create_infos[0],                           // const VkDeviceQueueCreateInfo     *pQueueCreateInfos
@@ -347,11 +721,67 @@ namespace HelloEngine
 			return false;
 		}
 
+		m_DeviceExtensions = extensions;
 		m_GraphicsQueue.familyIndex = selected_graphics_queue_family_index;
 		m_PresentQueue.familyIndex = selected_present_queue_family_index;
+		m_TransferQueue.familyIndex = selected_transfer_queue_family_index;
 		return true;
 	}
 
+	uint32_t RenderParameters::GetTransferQueueFamilyIndex(VkPhysicalDevice physical_device, uint32_t graphics_queue_family_index, VkExtent3D &image_granularity)
+	{
+		uint32_t queue_families_count = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_families_count, nullptr);
+		std::vector<VkQueueFamilyProperties> queue_family_properties(queue_families_count);
+		if (queue_families_count > 0) {
+			vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_families_count, &queue_family_properties[0]);
+		}
+
+		// A family that can only copy is usually backed by a DMA engine running next to the graphics work
+		for (uint32_t i = 0; i < queue_families_count; ++i) {
+			if ((queue_family_properties[i].queueCount > 0) &&
+				(queue_family_properties[i].queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+				!(queue_family_properties[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+				image_granularity = queue_family_properties[i].minImageTransferGranularity;
+				return i;
+			}
+		}
+		image_granularity.width = image_granularity.height = image_granularity.depth = 1;
+		return graphics_queue_family_index;
+	}
+
+	bool RenderParameters::HasDedicatedTransferQueue() const
+	{
+		return m_TransferQueue.familyIndex != m_GraphicsQueue.familyIndex;
+	}
+
+	bool RenderParameters::CheckTimelineSemaphoreSupport(VkPhysicalDevice physical_device) const
+	{
+		if (!IsExtensionEnabled(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME, m_InstanceExtensions)) {
+			return false;
+		}
+
+		uint32_t extensions_count = 0;
+		if ((vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extensions_count, nullptr) != VK_SUCCESS) ||
+			(extensions_count == 0)) {
+			return false;
+		}
+		std::vector<VkExtensionProperties> available_extensions(extensions_count);
+		if ((vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extensions_count, &available_extensions[0]) != VK_SUCCESS) ||
+			!CheckExtensionAvailability(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME, available_extensions)) {
+			return false;
+		}
+
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_semaphore_features = {};
+		timeline_semaphore_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		VkPhysicalDeviceFeatures2KHR device_features = {};
+		device_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		device_features.pNext = &timeline_semaphore_features;
+		vkGetPhysicalDeviceFeatures2KHR(physical_device, &device_features);
+
+		return timeline_semaphore_features.timelineSemaphore == VK_TRUE;
+	}
+
 	bool RenderParameters::CheckPhysicalDeviceProperties(VkPhysicalDevice physical_device, uint32_t &selected_graphics_queue_family_index, uint32_t &selected_present_queue_family_index) const
 	{
 		uint32_t extensions_count = 0;
@@ -442,6 +872,7 @@ namespace HelloEngine
 	bool RenderParameters::GetDeviceQueue() {
 		vkGetDeviceQueue(m_Device, m_GraphicsQueue.familyIndex, 0, &m_GraphicsQueue.handle);
 		vkGetDeviceQueue(m_Device, m_PresentQueue.familyIndex, 0, &m_PresentQueue.handle);
+		vkGetDeviceQueue(m_Device, m_TransferQueue.familyIndex, 0, &m_TransferQueue.handle);
 		return true;
 	}
 
@@ -456,6 +887,31 @@ namespace HelloEngine
 		if (!CreateFences()) {
 			return false;
 		}
+		if (!CreateTimelineSemaphore()) {
+			return false;
+		}
+		return true;
+	}
+
+	bool RenderParameters::CreateTimelineSemaphore()
+	{
+		if (!IsExtensionEnabled(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME, m_DeviceExtensions)) {
+			return true;
+		}
+
+		VkSemaphoreTypeCreateInfoKHR semaphore_type_create_info = {
+			VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR, // VkStructureType                sType
+			nullptr,                                          // const void                    *pNext
+			VK_SEMAPHORE_TYPE_TIMELINE_KHR,                   // VkSemaphoreType                semaphoreType
+			m_SubmitCount                                     // uint64_t                       initialValue
+		};
+		VkSemaphoreCreateInfo semaphore_create_info{};
+		semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphore_create_info.pNext = &semaphore_type_create_info;
+		if (vkCreateSemaphore(m_Device, &semaphore_create_info, nullptr, &m_GraphicsTimeline) != VK_SUCCESS) {
+			std::cout << "Could not create timeline semaphore!" << std::endl;
+			return false;
+		}
 		return true;
 	}
 
@@ -475,10 +931,6 @@ namespace HelloEngine
 	bool RenderParameters::CreateSwapChain() {
 		m_CanRender = false;
 
-		if (m_Device != nullptr) {
-			vkDeviceWaitIdle(m_Device);
-		}
-
 		VkSurfaceCapabilitiesKHR surface_capabilities;
 		if (vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_PhysicalDevice, m_PresentationSurface, &surface_capabilities) != VK_SUCCESS) {
 			std::cout << "Could not check presentation surface capabilities!\n";
@@ -516,7 +968,7 @@ namespace HelloEngine
 		VkExtent2D                    desired_extent = GetSwapChainExtent(surface_capabilities);
 		VkImageUsageFlags             desired_usage = GetSwapChainUsageFlags(surface_capabilities);
 		VkSurfaceTransformFlagBitsKHR desired_transform = GetSwapChainTransform(surface_capabilities);
-		VkPresentModeKHR              desired_present_mode = GetSwapChainPresentMode(present_modes);
+		VkPresentModeKHR              desired_present_mode = GetSwapChainPresentMode(present_modes, m_RequestedPresentMode);
 		VkSwapchainKHR                old_swap_chain = m_SwapChain.handle;
 
 		if (static_cast<int>(desired_usage) == -1) {
@@ -549,10 +1001,9 @@ namespace HelloEngine
 			std::cout << "Could not create swap chain!\n";
 			return false;
 		}
-		if (old_swap_chain != VK_NULL_HANDLE) {
-			vkDestroySwapchainKHR(m_Device, old_swap_chain, nullptr);
-		}
+		RetireSwapChain(old_swap_chain);
 		m_SwapChain.format = desired_format.format;
+		m_PresentMode = desired_present_mode;
 		uint32_t image_count = 0;
 		if ((vkGetSwapchainImagesKHR(m_Device, m_SwapChain.handle, &image_count, nullptr) != VK_SUCCESS) ||
 			(image_count == 0)) {
@@ -570,6 +1021,7 @@ namespace HelloEngine
 			m_SwapChain.images[i].handle = images[i];
 		}
 		m_SwapChain.extent = desired_extent;
+		MarkDirty(DIRTY_EXTENT_BIT);
 
 		return CreateSwapChainImageViews();
 	}
@@ -595,223 +1047,828 @@ namespace HelloEngine
 				return false;
 			}
 		}
+		// During initialization the render pass does not exist yet, framebuffers are created right after it
+		if (m_RenderPass != VK_NULL_HANDLE && !CreateFramebuffers()) {
+			return false;
+		}
 		m_CanRender = true;
 		return true;
 	}
 
-	bool RenderParameters::CreateFramebuffer(VkFramebuffer &framebuffer, VkImageView image_view) const
+	bool RenderParameters::CreateFramebuffers()
 	{
-		if (framebuffer != VK_NULL_HANDLE) {
-			vkDestroyFramebuffer(m_Device, framebuffer, nullptr);
-			framebuffer = VK_NULL_HANDLE;
-		}
-
-		VkFramebufferCreateInfo framebuffer_create_info{};
-		framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebuffer_create_info.renderPass = m_RenderPass;
-		framebuffer_create_info.attachmentCount = 1;
-		framebuffer_create_info.pAttachments = &image_view;
-		framebuffer_create_info.width = m_SwapChain.extent.width;
-		framebuffer_create_info.height = m_SwapChain.extent.height;
-		framebuffer_create_info.layers = 1;
-
-		if (vkCreateFramebuffer(m_Device, &framebuffer_create_info, nullptr, &framebuffer) != VK_SUCCESS) {
-			std::cout << "Could not create a framebuffer!\n";
-			return false;
+		m_SwapChain.framebuffers.resize(m_SwapChain.images.size(), VK_NULL_HANDLE);
+		for (size_t i = 0; i < m_SwapChain.images.size(); ++i) {
+			if (!CreateFramebuffer(m_SwapChain.framebuffers[i], m_SwapChain.images[i].view)) {
+				return false;
+			}
 		}
 		return true;
 	}
 
-	AutoDeleter<VkShaderModule, PFN_vkDestroyShaderModule> RenderParameters::CreateShaderModule(const char* filename) const
+	void RenderParameters::DestroySwapChainImageViews()
 	{
-		const std::vector<char> code = GetBinaryFileContents(filename);
-		if (code.size() == 0) {
-			return AutoDeleter<VkShaderModule, PFN_vkDestroyShaderModule>();
+		for (size_t i = 0; i < m_SwapChain.framebuffers.size(); ++i) {
+			if (m_SwapChain.framebuffers[i] != VK_NULL_HANDLE) {
+				vkDestroyFramebuffer(m_Device, m_SwapChain.framebuffers[i], nullptr);
+			}
 		}
-		VkShaderModuleCreateInfo shader_module_create_info{};
-		shader_module_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		shader_module_create_info.codeSize = code.size();
-		shader_module_create_info.pCode = reinterpret_cast<const uint32_t*>(&code[0]);
-
-		VkShaderModule shader_module;
-		if (vkCreateShaderModule(m_Device, &shader_module_create_info, nullptr, &shader_module) != VK_SUCCESS) {
-			std::cout << "Could not create shader module from a \"" << filename << "\" file!\n";
-			return AutoDeleter<VkShaderModule, PFN_vkDestroyShaderModule>();
+		m_SwapChain.framebuffers.clear();
+		for (size_t i = 0; i < m_SwapChain.images.size(); ++i) {
+			if (m_SwapChain.images[i].view != VK_NULL_HANDLE) {
+				vkDestroyImageView(m_Device, m_SwapChain.images[i].view, nullptr);
+				m_SwapChain.images[i].view = VK_NULL_HANDLE;
+			}
 		}
-		return AutoDeleter<VkShaderModule, PFN_vkDestroyShaderModule>(shader_module, vkDestroyShaderModule, m_Device);
 	}
 
-	bool RenderParameters::CreatePipeline() {
-		auto vertex_shader_module = CreateShaderModule("shaders/vert.spv");
-		auto fragment_shader_module = CreateShaderModule("shaders/frag.spv");
-
-		if (!vertex_shader_module || !fragment_shader_module) {
-			return false;
+	void RenderParameters::RetireSwapChain(VkSwapchainKHR swap_chain)
+	{
+		RetiredSwapChainData retired;
+		retired.handle = swap_chain;
+		retired.framebuffers.swap(m_SwapChain.framebuffers);
+		for (size_t i = 0; i < m_SwapChain.images.size(); ++i) {
+			if (m_SwapChain.images[i].view != VK_NULL_HANDLE) {
+				retired.views.push_back(m_SwapChain.images[i].view);
+				m_SwapChain.images[i].view = VK_NULL_HANDLE;
+			}
 		}
+		// Every submission issued so far may still reference the old images
+		retired.submitIndex = m_SubmitCount;
+		m_RetiredSwapChains.push_back(std::move(retired));
+	}
 
-		std::vector<VkPipelineShaderStageCreateInfo> shader_stage_create_infos = {
-			{
-				VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,        // VkStructureType                                sType
-				nullptr,                                                    // const void                                    *pNext
-				0,                                                          // VkPipelineShaderStageCreateFlags               flags
-				VK_SHADER_STAGE_VERTEX_BIT,                                 // VkShaderStageFlagBits                          stage
-				vertex_shader_module.Get(),                                 // VkShaderModule                                 module
-				"main",                                                     // const char                                    *pName
-				nullptr                                                     // const VkSpecializationInfo                    *pSpecializationInfo
-			},		
-			{
-				VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,        // VkStructureType                                sType
-				nullptr,                                                    // const void                                    *pNext
-				0,                                                          // VkPipelineShaderStageCreateFlags               flags
-				VK_SHADER_STAGE_FRAGMENT_BIT,                               // VkShaderStageFlagBits                          stage
-				fragment_shader_module.Get(),                               // VkShaderModule                                 module
-				"main",                                                     // const char                                    *pName
-				nullptr                                                     // const VkSpecializationInfo                    *pSpecializationInfo
+	void RenderParameters::ReleaseRetiredSwapChains(bool force)
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < m_RetiredSwapChains.size(); ++i) {
+			RetiredSwapChainData &retired = m_RetiredSwapChains[i];
+			if (!force && !IsSubmitCompleted(retired.submitIndex)) {
+				if (kept != i) {
+					m_RetiredSwapChains[kept] = std::move(retired);
+				}
+				++kept;
+				continue;
 			}
-		};
-
-		VkVertexInputBindingDescription vertex_binding_description = {
-			0,                                                          // uint32_t                                       binding
-			sizeof(VertexData),                                         // uint32_t                                       stride
-			VK_VERTEX_INPUT_RATE_VERTEX                                 // VkVertexInputRate                              inputRate
-		};
-
-		VkVertexInputAttributeDescription vertex_attribute_descriptions[] = {
-			{
-				0,                                                          // uint32_t                                       location
-				vertex_binding_description.binding,                         // uint32_t                                       binding
-				VK_FORMAT_R32G32B32A32_SFLOAT,                              // VkFormat                                       format
-				0                                                           // uint32_t                                       offset
-			},
-			{
-				1,                                                          // uint32_t                                       location
-				vertex_binding_description.binding,                         // uint32_t                                       binding
-				VK_FORMAT_R32G32_SFLOAT,                                    // VkFormat                                       format
-				4 * sizeof(float)                                           // uint32_t                                       offset
+			for (size_t j = 0; j < retired.framebuffers.size(); ++j) {
+				if (retired.framebuffers[j] != VK_NULL_HANDLE) {
+					vkDestroyFramebuffer(m_Device, retired.framebuffers[j], nullptr);
+				}
 			}
-		};
+			for (size_t j = 0; j < retired.views.size(); ++j) {
+				vkDestroyImageView(m_Device, retired.views[j], nullptr);
+			}
+			if (retired.handle != VK_NULL_HANDLE) {
+				vkDestroySwapchainKHR(m_Device, retired.handle, nullptr);
+			}
+		}
+		m_RetiredSwapChains.resize(kept);
+	}
 
-		VkPipelineVertexInputStateCreateInfo vertex_input_state_create_info = {
-			VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,    // VkStructureType                                sType
-			nullptr,                                                      // const void                                    *pNext
-			0,                                                            // VkPipelineVertexInputStateCreateFlags          flags;
-			1,                                                            // uint32_t                                       vertexBindingDescriptionCount
-			&vertex_binding_description,                                  // const VkVertexInputBindingDescription         *pVertexBindingDescriptions
-			2,                                                            // uint32_t                                       vertexAttributeDescriptionCount
-			vertex_attribute_descriptions                                 // const VkVertexInputAttributeDescription       *pVertexAttributeDescriptions
-		};
+	bool RenderParameters::IsSubmitCompleted(uint64_t submit_index) const
+	{
+		if ((m_GraphicsTimeline != VK_NULL_HANDLE) && !(submit_index & TRANSFER_SUBMIT_BIT)) {
+			uint64_t completed_value = 0;
+			return (vkGetSemaphoreCounterValueKHR(m_Device, m_GraphicsTimeline, &completed_value) == VK_SUCCESS) &&
+				(completed_value >= submit_index);
+		}
+		std::vector<VkFence> fences;
+		GetSubmitFences(submit_index, fences);
+		for (size_t i = 0; i < fences.size(); ++i) {
+			if (vkGetFenceStatus(m_Device, fences[i]) != VK_SUCCESS) {
+				return false;
+			}
+		}
+		return true;
+	}
 
-		VkPipelineInputAssemblyStateCreateInfo input_assembly_state_create_info = {
-			VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,  // VkStructureType                                sType
-			nullptr,                                                      // const void                                    *pNext
-			0,                                                            // VkPipelineInputAssemblyStateCreateFlags        flags
-			VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,                         // VkPrimitiveTopology                            topology
-			VK_FALSE                                                      // VkBool32                                       primitiveRestartEnable
-		};
+	bool RenderParameters::WaitForSubmit(uint64_t submit_index) const
+	{
+		if ((m_GraphicsTimeline != VK_NULL_HANDLE) && !(submit_index & TRANSFER_SUBMIT_BIT)) {
+			VkSemaphoreWaitInfoKHR semaphore_wait_info = {
+				VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR,    // VkStructureType                sType
+				nullptr,                                      // const void                    *pNext
+				0,                                            // VkSemaphoreWaitFlags           flags
+				1,                                            // uint32_t                       semaphoreCount
+				&m_GraphicsTimeline,                          // const VkSemaphore             *pSemaphores
+				&submit_index                                 // const uint64_t                *pValues
+			};
+			if (vkWaitSemaphoresKHR(m_Device, &semaphore_wait_info, 1000000000) != VK_SUCCESS) {
+				std::cout << "Waiting for timeline semaphore takes too long!" << std::endl;
+				return false;
+			}
+			return true;
+		}
+		std::vector<VkFence> fences;
+		GetSubmitFences(submit_index, fences);
+		if (!fences.empty() && (vkWaitForFences(m_Device, static_cast<uint32_t>(fences.size()), &fences[0], VK_TRUE, 1000000000) != VK_SUCCESS)) {
+			std::cout << "Waiting for fence takes too long!" << std::endl;
+			return false;
+		}
+		return true;
+	}
 
-		VkPipelineViewportStateCreateInfo viewport_state_create_info = {
-			VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,        // VkStructureType                                sType
-			nullptr,                                                      // const void                                    *pNext
-			0,                                                            // VkPipelineViewportStateCreateFlags             flags
-			1,                                                            // uint32_t                                       viewportCount
-			nullptr,                                                      // const VkViewport                              *pViewports
-			1,                                                            // uint32_t                                       scissorCount
-			nullptr                                                       // const VkRect2D                                *pScissors
-		};
+	void RenderParameters::GetSubmitFences(uint64_t submit_index, std::vector<VkFence> &fences) const
+	{
+		// Frame and upload resources are only resubmitted after their fence signaled, so
+		// a resource whose last submission is newer than submit_index is done with it
+		if (submit_index & TRANSFER_SUBMIT_BIT) {
+			for (size_t i = 0; i < m_UploadSubmits.size(); ++i) {
+				const UploadSubmitData &upload = m_UploadSubmits[i];
+				if ((upload.transferSubmitIndex != 0) && (upload.transferSubmitIndex <= submit_index)) {
+					fences.push_back(upload.transferFence);
+				}
+			}
+			return;
+		}
+		for (size_t i = 0; i < m_RenderingResources.size(); ++i) {
+			const RenderingResourcesData &resource = m_RenderingResources[i];
+			if ((resource.submitIndex != 0) && (resource.submitIndex <= submit_index)) {
+				fences.push_back(resource.fence);
+			}
+		}
+		for (size_t i = 0; i < m_UploadSubmits.size(); ++i) {
+			const UploadSubmitData &upload = m_UploadSubmits[i];
+			if ((upload.submitIndex != 0) && (upload.submitIndex <= submit_index)) {
+				fences.push_back(upload.fence);
+			}
+		}
+	}
 
-		VkPipelineRasterizationStateCreateInfo rasterization_state_create_info = {
-			VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,   // VkStructureType                                sType
-			nullptr,                                                      // const void                                    *pNext
-			0,                                                            // VkPipelineRasterizationStateCreateFlags        flags
-			VK_FALSE,                                                     // VkBool32                                       depthClampEnable
-			VK_FALSE,                                                     // VkBool32                                       rasterizerDiscardEnable
-			VK_POLYGON_MODE_FILL,                                         // VkPolygonMode                                  polygonMode
-			VK_CULL_MODE_BACK_BIT,                                        // VkCullModeFlags                                cullMode
-			VK_FRONT_FACE_COUNTER_CLOCKWISE,                              // VkFrontFace                                    frontFace
-			VK_FALSE,                                                     // VkBool32                                       depthBiasEnable
-			0.0f,                                                         // float                                          depthBiasConstantFactor
-			0.0f,                                                         // float                                          depthBiasClamp
-			0.0f,                                                         // float                                          depthBiasSlopeFactor
-			1.0f                                                          // float                                          lineWidth
-		};
+	bool RenderParameters::AcquireUploadSubmit(size_t &index)
+	{
+		for (size_t i = 0; i < m_UploadSubmits.size(); ++i) {
+			const UploadSubmitData &upload = m_UploadSubmits[i];
+			if (!upload.handOffPending &&
+				IsSubmitCompleted(upload.submitIndex) &&
+				IsSubmitCompleted(upload.transferSubmitIndex)) {
+				index = i;
+				return true;
+			}
+		}
 
-		VkPipelineMultisampleStateCreateInfo multisample_state_create_info = {
-			VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,     // VkStructureType                                sType
-			nullptr,                                                      // const void                                    *pNext
-			0,                                                            // VkPipelineMultisampleStateCreateFlags          flags
-			VK_SAMPLE_COUNT_1_BIT,                                        // VkSampleCountFlagBits                          rasterizationSamples
-			VK_FALSE,                                                     // VkBool32                                       sampleShadingEnable
-			1.0f,                                                         // float                                          minSampleShading
-			nullptr,                                                      // const VkSampleMask                            *pSampleMask
-			VK_FALSE,                                                     // VkBool32                                       alphaToCoverageEnable
-			VK_FALSE                                                      // VkBool32                                       alphaToOneEnable
-		};
+		UploadSubmitData upload;
+		VkFenceCreateInfo fence_create_info{};
+		fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		VkSemaphoreCreateInfo semaphore_create_info{};
+		semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-		VkPipelineColorBlendAttachmentState color_blend_attachment_state = {
-			VK_FALSE,                                                     // VkBool32                                       blendEnable
-			VK_BLEND_FACTOR_ONE,                                          // VkBlendFactor                                  srcColorBlendFactor
-			VK_BLEND_FACTOR_ZERO,                                         // VkBlendFactor                                  dstColorBlendFactor
-			VK_BLEND_OP_ADD,                                              // VkBlendOp                                      colorBlendOp
-			VK_BLEND_FACTOR_ONE,                                          // VkBlendFactor                                  srcAlphaBlendFactor
-			VK_BLEND_FACTOR_ZERO,                                         // VkBlendFactor                                  dstAlphaBlendFactor
-			VK_BLEND_OP_ADD,                                              // VkBlendOp                                      alphaBlendOp
-			VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |         // VkColorComponentFlags                          colorWriteMask
-			VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
-		};
+		bool created = AllocateCommandBuffers(m_CommandPool, 1, &upload.commandBuffer) &&
+			(vkCreateFence(m_Device, &fence_create_info, nullptr, &upload.fence) == VK_SUCCESS);
+		if (created && HasDedicatedTransferQueue()) {
+			created = AllocateCommandBuffers(m_TransferCommandPool, 1, &upload.transferCommandBuffer) &&
+				(vkCreateFence(m_Device, &fence_create_info, nullptr, &upload.transferFence) == VK_SUCCESS) &&
+				(vkCreateSemaphore(m_Device, &semaphore_create_info, nullptr, &upload.handOffSemaphore) == VK_SUCCESS);
+		}
+		if (!created) {
+			std::cout << "Could not create upload resources!" << std::endl;
+			DestroyUploadSubmit(upload);
+			return false;
+		}
+		index = m_UploadSubmits.size();
+		m_UploadSubmits.push_back(upload);
+		return true;
+	}
 
-		VkPipelineColorBlendStateCreateInfo color_blend_state_create_info = {
-			VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,     // VkStructureType                                sType
-			nullptr,                                                      // const void                                    *pNext
-			0,                                                            // VkPipelineColorBlendStateCreateFlags           flags
-			VK_FALSE,                                                     // VkBool32                                       logicOpEnable
-			VK_LOGIC_OP_COPY,                                             // VkLogicOp                                      logicOp
-			1,                                                            // uint32_t                                       attachmentCount
-			&color_blend_attachment_state,                                // const VkPipelineColorBlendAttachmentState     *pAttachments
-			{ 0.0f, 0.0f, 0.0f, 0.0f }                                    // float                                          blendConstants[4]
+	void RenderParameters::DestroyUploadSubmit(UploadSubmitData &upload)
+	{
+		if (upload.commandBuffer != nullptr) {
+			vkFreeCommandBuffers(m_Device, m_CommandPool, 1, &upload.commandBuffer);
+		}
+		if (upload.fence != VK_NULL_HANDLE) {
+			vkDestroyFence(m_Device, upload.fence, nullptr);
+		}
+		if (upload.transferCommandBuffer != nullptr) {
+			vkFreeCommandBuffers(m_Device, m_TransferCommandPool, 1, &upload.transferCommandBuffer);
+		}
+		if (upload.transferFence != VK_NULL_HANDLE) {
+			vkDestroyFence(m_Device, upload.transferFence, nullptr);
+		}
+		if (upload.handOffSemaphore != VK_NULL_HANDLE) {
+			vkDestroySemaphore(m_Device, upload.handOffSemaphore, nullptr);
+		}
+		upload = UploadSubmitData();
+	}
+
+	void RenderParameters::DestroyUploadSubmits()
+	{
+		for (size_t i = 0; i < m_UploadSubmits.size(); ++i) {
+			DestroyUploadSubmit(m_UploadSubmits[i]);
+		}
+		m_UploadSubmits.clear();
+	}
+
+	bool RenderParameters::EnqueueBufferUpload(const void *data, VkDeviceSize size, VkBuffer buffer, VkAccessFlags dst_access, VkPipelineStageFlags dst_stage)
+	{
+		m_BufferUploads.push_back(BufferUploadData());
+		m_BufferUploads.back().buffer = buffer;
+		m_BufferUploads.back().dstAccessMask = dst_access;
+		m_BufferUploads.back().dstStageMask = dst_stage;
+
+		// Data larger than half of the ring is streamed in chunks, so one chunk can be filled while another is copied
+		const VkDeviceSize  chunk_limit = m_StagingRing.GetCapacity() / 2;
+		const char         *source = static_cast<const char*>(data);
+
+		for (VkDeviceSize copied = 0; copied < size; ) {
+			VkDeviceSize chunk_size = std::min(chunk_limit, size - copied);
+			VkDeviceSize staging_offset;
+			if (!AcquireStagingMemory(chunk_size, 4, staging_offset)) {
+				return false;
+			}
+			memcpy(static_cast<char*>(m_StagingBuffer.memory.mappedData) + staging_offset, source + copied, static_cast<size_t>(chunk_size));
+			m_MemoryAllocator.Flush(m_StagingBuffer.memory, staging_offset, chunk_size);
+
+			VkBufferCopy buffer_copy_info = {
+				staging_offset,                                     // VkDeviceSize                           srcOffset
+				copied,                                             // VkDeviceSize                           dstOffset
+				chunk_size                                          // VkDeviceSize                           size
+			};
+			m_BufferUploads.back().regions.push_back(buffer_copy_info);
+			copied += chunk_size;
+		}
+		m_BufferUploads.back().complete = true;
+		return true;
+	}
+
+	bool RenderParameters::EnqueueImageUpload(const Image &image, VkImage handle)
+	{
+		m_ImageUploads.push_back(ImageUploadData());
+		m_ImageUploads.back().image = handle;
+		m_ImageUploads.back().dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		m_ImageUploads.back().dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		m_ImageUploads.back().finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		// Textures bigger than half of the staging ring are streamed in bands of whole rows
+		const uint32_t     row_pitch = image.GetSize() / image.GetHeight();
+		uint32_t           rows_per_chunk = std::max<uint32_t>(1, static_cast<uint32_t>(m_StagingRing.GetCapacity() / 2 / row_pitch));
+		// Bands must start on the transfer queue's image granularity, zero means only whole images can be copied
+		const uint32_t     row_granularity = m_TransferImageGranularity.height;
+		if (row_granularity == 0) {
+			rows_per_chunk = image.GetHeight();
+		}
+		else {
+			rows_per_chunk = std::max(row_granularity, rows_per_chunk / row_granularity * row_granularity);
+		}
+
+		for (uint32_t row = 0; row < image.GetHeight(); ) {
+			uint32_t     row_count = std::min(rows_per_chunk, image.GetHeight() - row);
+			VkDeviceSize chunk_size = static_cast<VkDeviceSize>(row_count) * row_pitch;
+			VkDeviceSize staging_offset;
+			if (!AcquireStagingMemory(chunk_size, 4, staging_offset)) {
+				return false;
+			}
+			memcpy(static_cast<char*>(m_StagingBuffer.memory.mappedData) + staging_offset, image.GetData() + static_cast<size_t>(row) * row_pitch, static_cast<size_t>(chunk_size));
+			m_MemoryAllocator.Flush(m_StagingBuffer.memory, staging_offset, chunk_size);
+
+			VkBufferImageCopy buffer_image_copy_info = {
+				staging_offset,                                     // VkDeviceSize                           bufferOffset
+				0,                                                  // uint32_t                               bufferRowLength
+				0,                                                  // uint32_t                               bufferImageHeight
+				{                                                   // VkImageSubresourceLayers               imageSubresource
+					VK_IMAGE_ASPECT_COLOR_BIT,                          // VkImageAspectFlags                     aspectMask
+					0,                                                  // uint32_t                               mipLevel
+					0,                                                  // uint32_t                               baseArrayLayer
+					1                                                   // uint32_t                               layerCount
+				},
+				{                                                   // VkOffset3D                             imageOffset
+					0,                                                  // int32_t                                x
+					static_cast<int32_t>(row),                          // int32_t                                y
+					0                                                   // int32_t                                z
+				},
+				{                                                   // VkExtent3D                             imageExtent
+					image.GetWidth(),                                   // uint32_t                               width
+					row_count,                                          // uint32_t                               height
+					1                                                   // uint32_t                               depth
+				}
+			};
+			m_ImageUploads.back().regions.push_back(buffer_image_copy_info);
+			row += row_count;
+		}
+		m_ImageUploads.back().complete = true;
+		return true;
+	}
+
+	bool RenderParameters::SubmitUploads(uint64_t &token)
+	{
+		token = 0;
+		if (m_BufferUploads.empty() && m_ImageUploads.empty()) {
+			return true;
+		}
+		size_t upload_index;
+		if (!AcquireUploadSubmit(upload_index)) {
+			return false;
+		}
+		UploadSubmitData &upload = m_UploadSubmits[upload_index];
+
+		// With a dedicated transfer queue the copies run there and the graphics queue acquires
+		// the finished resources later, otherwise everything is recorded for the graphics queue
+		const bool      dedicated_transfer = HasDedicatedTransferQueue();
+		const uint32_t  src_queue_family_index = dedicated_transfer ? m_TransferQueue.familyIndex : VK_QUEUE_FAMILY_IGNORED;
+		const uint32_t  dst_queue_family_index = dedicated_transfer ? m_GraphicsQueue.familyIndex : VK_QUEUE_FAMILY_IGNORED;
+		VkCommandBuffer copy_command_buffer = dedicated_transfer ? upload.transferCommandBuffer : upload.commandBuffer;
+
+		VkCommandBufferBeginInfo command_buffer_begin_info = {
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,        // VkStructureType                        sType
+			nullptr,                                            // const void                            *pNext
+			VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,        // VkCommandBufferUsageFlags              flags
+			nullptr                                             // const VkCommandBufferInheritanceInfo  *pInheritanceInfo
 		};
+		vkBeginCommandBuffer(copy_command_buffer, &command_buffer_begin_info);
 
-		VkDynamicState dynamic_states[] = {
-			VK_DYNAMIC_STATE_VIEWPORT,
-			VK_DYNAMIC_STATE_SCISSOR,
+		VkImageSubresourceRange image_subresource_range = {
+			VK_IMAGE_ASPECT_COLOR_BIT,                          // VkImageAspectFlags                     aspectMask
+			0,                                                  // uint32_t                               baseMipLevel
+			1,                                                  // uint32_t                               levelCount
+			0,                                                  // uint32_t                               baseArrayLayer
+			1                                                   // uint32_t                               layerCount
 		};
 
-		VkPipelineDynamicStateCreateInfo dynamic_state_create_info = {
-			VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,         // VkStructureType                                sType
-			nullptr,                                                      // const void                                    *pNext
-			0,                                                            // VkPipelineDynamicStateCreateFlags              flags
-			2,                                                            // uint32_t                                       dynamicStateCount
-			dynamic_states                                                // const VkDynamicState                          *pDynamicStates
+		// Every image that starts receiving data in this batch moves to the transfer layout with a single barrier
+		std::vector<VkImageMemoryBarrier> image_barriers;
+		for (size_t i = 0; i < m_ImageUploads.size(); ++i) {
+			ImageUploadData &image_upload = m_ImageUploads[i];
+			if (image_upload.transitioned) {
+				continue;
+			}
+			VkImageMemoryBarrier image_memory_barrier_from_undefined_to_transfer_dst = {
+				VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,             // VkStructureType                        sType
+				nullptr,                                            // const void                            *pNext
+				0,                                                  // VkAccessFlags                          srcAccessMask
+				VK_ACCESS_TRANSFER_WRITE_BIT,                       // VkAccessFlags                          dstAccessMask
+				VK_IMAGE_LAYOUT_UNDEFINED,                          // VkImageLayout                          oldLayout
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,               // VkImageLayout                          newLayout
+				VK_QUEUE_FAMILY_IGNORED,                            // uint32_t                               srcQueueFamilyIndex
+				VK_QUEUE_FAMILY_IGNORED,                            // uint32_t                               dstQueueFamilyIndex
+				image_upload.image,                                 // VkImage                                image
+				image_subresource_range                             // VkImageSubresourceRange                subresourceRange
+			};
+			image_barriers.push_back(image_memory_barrier_from_undefined_to_transfer_dst);
+			image_upload.transitioned = true;
+		}
+		if (!image_barriers.empty()) {
+			vkCmdPipelineBarrier(copy_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(image_barriers.size()), &image_barriers[0]);
+		}
+
+		for (size_t i = 0; i < m_BufferUploads.size(); ++i) {
+			BufferUploadData &buffer_upload = m_BufferUploads[i];
+			if (!buffer_upload.regions.empty()) {
+				vkCmdCopyBuffer(copy_command_buffer, m_StagingBuffer.handle, buffer_upload.buffer, static_cast<uint32_t>(buffer_upload.regions.size()), &buffer_upload.regions[0]);
+				buffer_upload.regions.clear();
+			}
+		}
+		for (size_t i = 0; i < m_ImageUploads.size(); ++i) {
+			ImageUploadData &image_upload = m_ImageUploads[i];
+			if (!image_upload.regions.empty()) {
+				vkCmdCopyBufferToImage(copy_command_buffer, m_StagingBuffer.handle, image_upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(image_upload.regions.size()), &image_upload.regions[0]);
+				image_upload.regions.clear();
+			}
+		}
+
+		// Resources whose data is complete are handed over to their consumers with a single barrier,
+		// the ones still streaming stay in the transfer layout for the next batch
+		std::vector<VkBufferMemoryBarrier> buffer_barriers;
+		VkPipelineStageFlags               dst_stage_mask = 0;
+		image_barriers.clear();
+		for (size_t i = 0; i < m_BufferUploads.size(); ++i) {
+			const BufferUploadData &buffer_upload = m_BufferUploads[i];
+			if (!buffer_upload.complete) {
+				continue;
+			}
+			VkBufferMemoryBarrier buffer_memory_barrier = {
+				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,            // VkStructureType                        sType;
+				nullptr,                                            // const void                            *pNext
+				VK_ACCESS_TRANSFER_WRITE_BIT,                       // VkAccessFlags                          srcAccessMask
+				buffer_upload.dstAccessMask,                        // VkAccessFlags                          dstAccessMask
+				src_queue_family_index,                             // uint32_t                               srcQueueFamilyIndex
+				dst_queue_family_index,                             // uint32_t                               dstQueueFamilyIndex
+				buffer_upload.buffer,                               // VkBuffer                               buffer
+				0,                                                  // VkDeviceSize                           offset
+				VK_WHOLE_SIZE                                       // VkDeviceSize                           size
+			};
+			buffer_barriers.push_back(buffer_memory_barrier);
+			dst_stage_mask |= buffer_upload.dstStageMask;
+		}
+		for (size_t i = 0; i < m_ImageUploads.size(); ++i) {
+			const ImageUploadData &image_upload = m_ImageUploads[i];
+			if (!image_upload.complete) {
+				continue;
+			}
+			VkImageMemoryBarrier image_memory_barrier_from_transfer_to_shader_read = {
+				VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,             // VkStructureType                        sType
+				nullptr,                                            // const void                            *pNext
+				VK_ACCESS_TRANSFER_WRITE_BIT,                       // VkAccessFlags                          srcAccessMask
+				image_upload.dstAccessMask,                         // VkAccessFlags                          dstAccessMask
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,               // VkImageLayout                          oldLayout
+				image_upload.finalLayout,                           // VkImageLayout                          newLayout
+				src_queue_family_index,                             // uint32_t                               srcQueueFamilyIndex
+				dst_queue_family_index,                             // uint32_t                               dstQueueFamilyIndex
+				image_upload.image,                                 // VkImage                                image
+				image_subresource_range                             // VkImageSubresourceRange                subresourceRange
+			};
+			image_barriers.push_back(image_memory_barrier_from_transfer_to_shader_read);
+			dst_stage_mask |= image_upload.dstStageMask;
+		}
+
+		const uint32_t              buffer_barrier_count = static_cast<uint32_t>(buffer_barriers.size());
+		const uint32_t              image_barrier_count = static_cast<uint32_t>(image_barriers.size());
+		VkBufferMemoryBarrier      *buffer_barrier_data = buffer_barriers.empty() ? nullptr : &buffer_barriers[0];
+		VkImageMemoryBarrier       *image_barrier_data = image_barriers.empty() ? nullptr : &image_barriers[0];
+		if ((dst_stage_mask != 0) && dedicated_transfer) {
+			// The release half of the ownership transfer, its destination access is ignored
+			for (size_t i = 0; i < buffer_barriers.size(); ++i) {
+				buffer_barriers[i].dstAccessMask = 0;
+			}
+			for (size_t i = 0; i < image_barriers.size(); ++i) {
+				image_barriers[i].dstAccessMask = 0;
+			}
+			vkCmdPipelineBarrier(copy_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, buffer_barrier_count, buffer_barrier_data, image_barrier_count, image_barrier_data);
+		}
+		else if (dst_stage_mask != 0) {
+			vkCmdPipelineBarrier(copy_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage_mask, 0, 0, nullptr, buffer_barrier_count, buffer_barrier_data, image_barrier_count, image_barrier_data);
+		}
+		vkEndCommandBuffer(copy_command_buffer);
+
+		if ((dst_stage_mask != 0) && dedicated_transfer) {
+			// The acquire half is recorded now and submitted to the graphics queue once the copies are done
+			size_t buffer_barrier = 0;
+			for (size_t i = 0; i < m_BufferUploads.size(); ++i) {
+				if (m_BufferUploads[i].complete) {
+					buffer_barriers[buffer_barrier].srcAccessMask = 0;
+					buffer_barriers[buffer_barrier++].dstAccessMask = m_BufferUploads[i].dstAccessMask;
+				}
+			}
+			size_t image_barrier = 0;
+			for (size_t i = 0; i < m_ImageUploads.size(); ++i) {
+				if (m_ImageUploads[i].complete) {
+					image_barriers[image_barrier].srcAccessMask = 0;
+					image_barriers[image_barrier++].dstAccessMask = m_ImageUploads[i].dstAccessMask;
+				}
+			}
+			vkBeginCommandBuffer(upload.commandBuffer, &command_buffer_begin_info);
+			vkCmdPipelineBarrier(upload.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dst_stage_mask, 0, 0, nullptr, buffer_barrier_count, buffer_barrier_data, image_barrier_count, image_barrier_data);
+			vkEndCommandBuffer(upload.commandBuffer);
+		}
+
+		for (size_t i = m_BufferUploads.size(); i-- > 0; ) {
+			if (m_BufferUploads[i].complete) {
+				m_BufferUploads.erase(m_BufferUploads.begin() + i);
+			}
+		}
+		for (size_t i = m_ImageUploads.size(); i-- > 0; ) {
+			if (m_ImageUploads[i].complete) {
+				m_ImageUploads.erase(m_ImageUploads.begin() + i);
+			}
+		}
+
+		if (dedicated_transfer) {
+			VkSubmitInfo submit_info = {
+				VK_STRUCTURE_TYPE_SUBMIT_INFO,                      // VkStructureType                        sType
+				nullptr,                                            // const void                            *pNext
+				0,                                                  // uint32_t                               waitSemaphoreCount
+				nullptr,                                            // const VkSemaphore                     *pWaitSemaphores
+				nullptr,                                            // const VkPipelineStageFlags            *pWaitDstStageMask;
+				1,                                                  // uint32_t                               commandBufferCount
+				&upload.transferCommandBuffer,                      // const VkCommandBuffer                 *pCommandBuffers
+				dst_stage_mask != 0 ? 1U : 0U,                      // uint32_t                               signalSemaphoreCount
+				&upload.handOffSemaphore                            // const VkSemaphore                     *pSignalSemaphores
+			};
+			vkResetFences(m_Device, 1, &upload.transferFence);
+			if (vkQueueSubmit(m_TransferQueue.handle, 1, &submit_info, upload.transferFence) != VK_SUCCESS) {
+				std::cout << "Could not submit uploads to the transfer queue!" << std::endl;
+				return false;
+			}
+			upload.transferSubmitIndex = ++m_TransferSubmitCount | TRANSFER_SUBMIT_BIT;
+			upload.handOffPending = dst_stage_mask != 0;
+			upload.handOffStageMask = dst_stage_mask;
+			m_StagingRing.Tag(upload.transferSubmitIndex);
+			token = upload.transferSubmitIndex;
+			return true;
+		}
+
+		uint64_t submit_index = m_SubmitCount + 1;
+		VkTimelineSemaphoreSubmitInfoKHR timeline_submit_info = {
+			VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR, // VkStructureType                  sType
+			nullptr,                                            // const void                            *pNext
+			0,                                                  // uint32_t                               waitSemaphoreValueCount
+			nullptr,                                            // const uint64_t                        *pWaitSemaphoreValues
+			1,                                                  // uint32_t                               signalSemaphoreValueCount
+			&submit_index                                       // const uint64_t                        *pSignalSemaphoreValues
 		};
 
-		VkGraphicsPipelineCreateInfo pipeline_create_info = {
-			VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,              // VkStructureType                                sType
-			nullptr,                                                      // const void                                    *pNext
-			0,                                                            // VkPipelineCreateFlags                          flags
-			static_cast<uint32_t>(shader_stage_create_infos.size()),      // uint32_t                                       stageCount
-			&shader_stage_create_infos[0],                                // const VkPipelineShaderStageCreateInfo         *pStages
-			&vertex_input_state_create_info,                              // const VkPipelineVertexInputStateCreateInfo    *pVertexInputState;
-			&input_assembly_state_create_info,                            // const VkPipelineInputAssemblyStateCreateInfo  *pInputAssemblyState
-			nullptr,                                                      // const VkPipelineTessellationStateCreateInfo   *pTessellationState
-			&viewport_state_create_info,                                  // const VkPipelineViewportStateCreateInfo       *pViewportState
-			&rasterization_state_create_info,                             // const VkPipelineRasterizationStateCreateInfo  *pRasterizationState
-			&multisample_state_create_info,                               // const VkPipelineMultisampleStateCreateInfo    *pMultisampleState
-			nullptr,                                                      // const VkPipelineDepthStencilStateCreateInfo   *pDepthStencilState
-			&color_blend_state_create_info,                               // const VkPipelineColorBlendStateCreateInfo     *pColorBlendState
-			&dynamic_state_create_info,                                   // const VkPipelineDynamicStateCreateInfo        *pDynamicState
-			m_PipelineLayout,                                        // VkPipelineLayout                               layout
-			m_RenderPass,                                            // VkRenderPass                                   renderPass
-			0,                                                            // uint32_t                                       subpass
-			VK_NULL_HANDLE,                                               // VkPipeline                                     basePipelineHandle
-			-1                                                            // int32_t                                        basePipelineIndex
+		VkSubmitInfo submit_info = {
+			VK_STRUCTURE_TYPE_SUBMIT_INFO,                      // VkStructureType                        sType
+			nullptr,                                            // const void                            *pNext
+			0,                                                  // uint32_t                               waitSemaphoreCount
+			nullptr,                                            // const VkSemaphore                     *pWaitSemaphores
+			nullptr,                                            // const VkPipelineStageFlags            *pWaitDstStageMask;
+			1,                                                  // uint32_t                               commandBufferCount
+			&upload.commandBuffer,                              // const VkCommandBuffer                 *pCommandBuffers
+			0,                                                  // uint32_t                               signalSemaphoreCount
+			nullptr                                             // const VkSemaphore                     *pSignalSemaphores
 		};
+		VkFence submit_fence = upload.fence;
+		if (m_GraphicsTimeline != VK_NULL_HANDLE) {
+			submit_info.pNext = &timeline_submit_info;
+			submit_info.signalSemaphoreCount = 1;
+			submit_info.pSignalSemaphores = &m_GraphicsTimeline;
+			submit_fence = VK_NULL_HANDLE;
+		}
+		else {
+			vkResetFences(m_Device, 1, &upload.fence);
+		}
+
+		if (vkQueueSubmit(m_GraphicsQueue.handle, 1, &submit_info, submit_fence) != VK_SUCCESS) {
+			std::cout << "Could not submit uploads!" << std::endl;
+			return false;
+		}
+		upload.submitIndex = m_SubmitCount = submit_index;
+		m_StagingRing.Tag(submit_index);
+		token = submit_index;
+		return true;
+	}
+
+	bool RenderParameters::SubmitHandOffs(bool force)
+	{
+		for (size_t i = 0; i < m_UploadSubmits.size(); ++i) {
+			UploadSubmitData &upload = m_UploadSubmits[i];
+			// Waiting for copies that are still running would stall every frame behind them
+			if (!upload.handOffPending ||
+				(!force && !IsSubmitCompleted(upload.transferSubmitIndex))) {
+				continue;
+			}
+
+			uint64_t submit_index = m_SubmitCount + 1;
+			VkTimelineSemaphoreSubmitInfoKHR timeline_submit_info = {
+				VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR, // VkStructureType                  sType
+				nullptr,                                            // const void                            *pNext
+				0,                                                  // uint32_t                               waitSemaphoreValueCount
+				nullptr,                                            // const uint64_t                        *pWaitSemaphoreValues
+				1,                                                  // uint32_t                               signalSemaphoreValueCount
+				&submit_index                                       // const uint64_t                        *pSignalSemaphoreValues
+			};
+
+			VkSubmitInfo submit_info = {
+				VK_STRUCTURE_TYPE_SUBMIT_INFO,                      // VkStructureType                        sType
+				nullptr,                                            // const void                            *pNext
+				1,                                                  // uint32_t                               waitSemaphoreCount
+				&upload.handOffSemaphore,                           // const VkSemaphore                     *pWaitSemaphores
+				&upload.handOffStageMask,                           // const VkPipelineStageFlags            *pWaitDstStageMask;
+				1,                                                  // uint32_t                               commandBufferCount
+				&upload.commandBuffer,                              // const VkCommandBuffer                 *pCommandBuffers
+				0,                                                  // uint32_t                               signalSemaphoreCount
+				nullptr                                             // const VkSemaphore                     *pSignalSemaphores
+			};
+			VkFence submit_fence = upload.fence;
+			if (m_GraphicsTimeline != VK_NULL_HANDLE) {
+				submit_info.pNext = &timeline_submit_info;
+				submit_info.signalSemaphoreCount = 1;
+				submit_info.pSignalSemaphores = &m_GraphicsTimeline;
+				submit_fence = VK_NULL_HANDLE;
+			}
+			else {
+				vkResetFences(m_Device, 1, &upload.fence);
+			}
+
+			if (vkQueueSubmit(m_GraphicsQueue.handle, 1, &submit_info, submit_fence) != VK_SUCCESS) {
+				std::cout << "Could not submit ownership acquisition to the graphics queue!" << std::endl;
+				return false;
+			}
+			upload.submitIndex = m_SubmitCount = submit_index;
+			upload.handOffPending = false;
+		}
+		return true;
+	}
+
+	void RenderParameters::ReclaimStagingMemory()
+	{
+		while (m_StagingRing.HasPending() && IsSubmitCompleted(m_StagingRing.GetOldestSubmit())) {
+			m_StagingRing.ReleaseOldest();
+		}
+	}
+
+	bool RenderParameters::AcquireStagingMemory(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset)
+	{
+		ReclaimStagingMemory();
+		if (m_StagingRing.Allocate(size, alignment, offset)) {
+			return true;
+		}
+
+		if (m_StagingRing.HasUntagged()) {
+			// The ring is filled by uploads enqueued so far, submit them to make their ranges reclaimable
+			uint64_t token;
+			if (!SubmitUploads(token)) {
+				return false;
+			}
+		}
+
+		while (!m_StagingRing.Allocate(size, alignment, offset)) {
+			if (!m_StagingRing.HasPending()) {
+				std::cout << "Data does not fit into the staging buffer!" << std::endl;
+				return false;
+			}
+			uint64_t oldest_submit = m_StagingRing.GetOldestSubmit();
+			if (!WaitForSubmit(oldest_submit)) {
+				return false;
+			}
+			m_StagingRing.ReleaseOldest();
+		}
+		return true;
+	}
+
+	bool RenderParameters::CreateFramebuffer(VkFramebuffer &framebuffer, VkImageView image_view)
+	{
+		VkFramebufferCreateInfo framebuffer_create_info{};
+		framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebuffer_create_info.renderPass = m_RenderPass;
+		framebuffer_create_info.attachmentCount = 1;
+		framebuffer_create_info.pAttachments = &image_view;
+		framebuffer_create_info.width = m_SwapChain.extent.width;
+		framebuffer_create_info.height = m_SwapChain.extent.height;
+		framebuffer_create_info.layers = 1;
+
+		if (vkCreateFramebuffer(m_Device, &framebuffer_create_info, nullptr, &framebuffer) != VK_SUCCESS) {
+			std::cout << "Could not create a framebuffer!\n";
+			return false;
+		}
+		++m_Statistics.framebufferCreations;
+		return true;
+	}
+
+	AutoDeleter<VkShaderModule, PFN_vkDestroyShaderModule> RenderParameters::CreateShaderModule(const char* filename) const
+	{
+		const std::vector<char> code = GetBinaryFileContents(filename);
+		if (code.size() == 0) {
+			return AutoDeleter<VkShaderModule, PFN_vkDestroyShaderModule>();
+		}
+		VkShaderModuleCreateInfo shader_module_create_info{};
+		shader_module_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		shader_module_create_info.codeSize = code.size();
+		shader_module_create_info.pCode = reinterpret_cast<const uint32_t*>(&code[0]);
+
+		VkShaderModule shader_module;
+		if (vkCreateShaderModule(m_Device, &shader_module_create_info, nullptr, &shader_module) != VK_SUCCESS) {
+			std::cout << "Could not create shader module from a \"" << filename << "\" file!\n";
+			return AutoDeleter<VkShaderModule, PFN_vkDestroyShaderModule>();
+		}
+		return AutoDeleter<VkShaderModule, PFN_vkDestroyShaderModule>(shader_module, vkDestroyShaderModule, m_Device);
+	}
+
+	bool RenderParameters::CreatePipeline() {
+		GraphicsPipelineDesc desc;
+		desc.vertexShader = "shaders/vert.spv";
+		desc.fragmentShader = "shaders/frag.spv";
+		desc.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+		desc.layout = m_PipelineLayout;
+		desc.renderPass = m_RenderPass;
+
+		// Vertex inputs are read from the shader and have to add up to VertexData
+		ShaderReflection vertex_reflection;
+		if (!ReflectShader(desc.vertexShader.c_str(), vertex_reflection)) {
+			return false;
+		}
+		vertex_reflection.GetVertexInputState(UINT32_MAX, desc.vertexBindings, desc.vertexAttributes);
+		if ((desc.vertexBindings.size() != 1) || (desc.vertexBindings[0].stride != sizeof(VertexData))) {
+			std::cout << "Vertex inputs of \"" << desc.vertexShader << "\" do not match the vertex data layout!" << std::endl;
+			return false;
+		}
+
+		// Sprites and indexed meshes are triangle lists, otherwise they share everything with the strip pipeline
+		GraphicsPipelineDesc triangle_list_desc = desc;
+		triangle_list_desc.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 
-		if (vkCreateGraphicsPipelines(m_Device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &m_GraphicsPipeline) != VK_SUCCESS) {
+		// Every startup pipeline compiles in parallel on the registry workers
+		uint32_t strip_pipeline = m_PipelineRegistry.Request(desc);
+		uint32_t triangle_list_pipeline = m_PipelineRegistry.Request(triangle_list_desc);
+		uint32_t sprite_pipeline = RequestSpritePipeline(triangle_list_desc);
+		uint32_t instanced_pipelines[2];
+		bool instanced_requested = RequestInstancedPipelines(desc, instanced_pipelines);
+
+		if (!m_PipelineRegistry.Wait(strip_pipeline) || !m_PipelineRegistry.Wait(triangle_list_pipeline) || !m_PipelineRegistry.Wait(sprite_pipeline)) {
 			std::cout << "Could not create graphics pipeline!" << std::endl;
 			return false;
 		}
+		m_GraphicsPipeline = m_PipelineRegistry.Get(strip_pipeline);
+		m_TriangleListPipeline = m_PipelineRegistry.Get(triangle_list_pipeline);
+
+		if (instanced_requested && m_PipelineRegistry.Wait(instanced_pipelines[0]) && m_PipelineRegistry.Wait(instanced_pipelines[1])) {
+			m_InstancedPipeline = m_PipelineRegistry.Get(instanced_pipelines[0]);
+			m_InstancedTriangleListPipeline = m_PipelineRegistry.Get(instanced_pipelines[1]);
+		}
+		else {
+			std::cout << "Instanced drawing is not available!" << std::endl;
+		}
+
+		// Blended sprites are only compiled once asked for and draw opaque until then
+		m_BlendedSpritePipeline = PipelineRegistry::INVALID_PIPELINE;
+		m_SpritePipeline = sprite_pipeline;
+		return true;
+	}
+
+	uint32_t RenderParameters::RequestSpritePipeline(const GraphicsPipelineDesc &mesh_desc)
+	{
+		GraphicsPipelineDesc desc = mesh_desc;
+		desc.vertexShader = "shaders/sprite.vert.spv";
+		desc.fragmentShader = "shaders/instanced.frag.spv";
+
+		// Without the tinting shaders sprites fall back to the mesh ones, which skip over the tint
+		ShaderReflection reflections[2];
+		const ShaderReflection *stages[] = { &reflections[0], &reflections[1] };
+		ReflectedLayout layout;
+		if (!ReflectShader(desc.vertexShader.c_str(), reflections[0]) || !ReflectShader(desc.fragmentShader.c_str(), reflections[1]) ||
+			!m_LayoutCache.GetLayout(stages, 2, true, layout) || (layout.pipelineLayout != m_PipelineLayout)) {
+			std::cout << "Sprite tinting is not available!" << std::endl;
+			desc = mesh_desc;
+			desc.vertexBindings[0].stride = sizeof(SpriteVertex);
+			return m_PipelineRegistry.Request(desc);
+		}
+
+		reflections[0].GetVertexInputState(UINT32_MAX, desc.vertexBindings, desc.vertexAttributes);
+		if ((desc.vertexBindings.size() != 1) || (desc.vertexBindings[0].stride != sizeof(SpriteVertex))) {
+			std::cout << "Vertex inputs of \"" << desc.vertexShader << "\" do not match the sprite vertex layout!" << std::endl;
+			return PipelineRegistry::INVALID_PIPELINE;
+		}
+		return m_PipelineRegistry.Request(desc);
+	}
+
+	bool RenderParameters::RequestInstancedPipelines(const GraphicsPipelineDesc &mesh_desc, uint32_t *pipelines)
+	{
+		pipelines[0] = PipelineRegistry::INVALID_PIPELINE;
+		pipelines[1] = PipelineRegistry::INVALID_PIPELINE;
+
+		// Everything else matches the strip and triangle list mesh pipelines
+		GraphicsPipelineDesc desc = mesh_desc;
+		desc.vertexShader = "shaders/instanced.vert.spv";
+		desc.fragmentShader = "shaders/instanced.frag.spv";
+
+		ShaderReflection reflections[2];
+		if (!ReflectShader(desc.vertexShader.c_str(), reflections[0]) || !ReflectShader(desc.fragmentShader.c_str(), reflections[1])) {
+			return false;
+		}
+		// Declaring the same bindings as the mesh shaders, they end up with the same layout objects
+		const ShaderReflection *stages[] = { &reflections[0], &reflections[1] };
+		ReflectedLayout layout;
+		if (!m_LayoutCache.GetLayout(stages, 2, true, layout)) {
+			return false;
+		}
+		desc.layout = layout.pipelineLayout;
+		if (desc.layout != m_PipelineLayout) {
+			std::cout << "Instanced shaders do not match the mesh descriptor set layout!" << std::endl;
+			return false;
+		}
+
+		// Binding 0 is the mesh itself, binding 1 advances once per instance
+		reflections[0].GetVertexInputState(INSTANCE_FIRST_LOCATION, desc.vertexBindings, desc.vertexAttributes);
+		if ((desc.vertexBindings.size() != 2) || (desc.vertexBindings[0].stride != sizeof(VertexData)) || (desc.vertexBindings[1].stride != sizeof(Instance))) {
+			std::cout << "Vertex inputs of \"" << desc.vertexShader << "\" do not match the vertex and instance data layout!" << std::endl;
+			return false;
+		}
+
+		// Each topology gets its own set of variants; the tinted, untested one is the default
+		VkPrimitiveTopology topologies[] = { VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST };
+		for (size_t i = 0; i < 2; ++i) {
+			desc.topology = topologies[i];
+			m_InstancedPermutations[i].Initialize(&m_PipelineRegistry, desc, INSTANCE_FEATURE_TINT_BIT);
+			m_InstancedPermutations[i].AddFeature(INSTANCE_FEATURE_TINT_BIT, VK_SHADER_STAGE_FRAGMENT_BIT, INSTANCED_TINT_CONSTANT_ID);
+			m_InstancedPermutations[i].AddFeature(INSTANCE_FEATURE_ALPHA_TEST_BIT, VK_SHADER_STAGE_FRAGMENT_BIT, INSTANCED_ALPHA_TEST_CONSTANT_ID);
+			pipelines[i] = m_InstancedPermutations[i].Get(INSTANCE_FEATURE_TINT_BIT);
+		}
 		return true;
 	}
 
+	void RenderParameters::SetInstanceFeatures(uint32_t features)
+	{
+		if (m_InstanceFeatures == features) {
+			return;
+		}
+		m_InstanceFeatures = features;
+		// Without instanced shaders there are no variants to compile, DrawInstances() refuses to draw anyway
+		if (m_InstancedPipeline == VK_NULL_HANDLE) {
+			return;
+		}
+		// Both topologies start compiling now rather than when first drawn
+		m_InstancedPermutations[0].Get(features);
+		m_InstancedPermutations[1].Get(features);
+		MarkDirty(DIRTY_SCENE_BIT);
+	}
+
+	void RenderParameters::SetSpriteBlending(bool enabled)
+	{
+		if (enabled && (m_BlendedSpritePipeline == PipelineRegistry::INVALID_PIPELINE)) {
+			// Requested in the background; the opaque pipeline stands in until it is compiled
+			GraphicsPipelineDesc desc = m_PipelineRegistry.GetDesc(m_SpritePipeline);
+			desc.blend.blendEnable = VK_TRUE;
+			desc.blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+			desc.blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+			desc.blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+			desc.blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+			m_BlendedSpritePipeline = m_PipelineRegistry.Request(desc, m_SpritePipeline);
+		}
+		if (m_SpriteBlending != enabled) {
+			m_SpriteBlending = enabled;
+			MarkDirty(DIRTY_SCENE_BIT);
+		}
+	}
+
 	bool RenderParameters::CreateVertexBuffer(const std::vector<float>& vertex_data)
 	{
 		m_VertexBuffer.size = static_cast<uint32_t>(vertex_data.size() * sizeof(vertex_data[0]));
@@ -822,84 +1879,639 @@ namespace HelloEngine
 		if (!CopyVertexData(vertex_data)) {
 			return false;
 		}
+		// The stream keeps what was uploaded, so later partial updates have something to patch
+		m_VertexStream.Initialize(static_cast<uint32_t>(m_RenderingResources.size()));
+		m_VertexStream.Orphan(vertex_data.data(), vertex_data.size());
+		UpdateMeshRadius(0, vertex_data.size(), true);
+		MarkDirty(DIRTY_VERTEX_BUFFER_BIT);
 		return true;
 	}
 
-	bool RenderParameters::CopyVertexData(const std::vector<float>& vertex_data) {
-		void *staging_buffer_memory_pointer;
-		if (vkMapMemory(m_Device, m_StagingBuffer.memory, 0, m_VertexBuffer.size, 0, &staging_buffer_memory_pointer) != VK_SUCCESS) {
-			std::cout << "Could not map memory and upload data to a staging buffer!" << std::endl;
+	void RenderParameters::UpdateMeshRadius(size_t offset, size_t count, bool reset)
+	{
+		// Partial updates only ever grow the bounds, so they stay conservative without a full rescan
+		if (reset) {
+			m_MeshRadius = 0.0f;
+		}
+		const size_t vertex_size = sizeof(VertexData) / sizeof(float);
+		const VertexData *vertices = reinterpret_cast<const VertexData*>(m_VertexStream.GetData());
+		size_t last = std::min(offset + count, m_VertexStream.GetFloatCount()) / vertex_size;
+		float radius_squared = m_MeshRadius * m_MeshRadius;
+		for (size_t i = offset / vertex_size; i < last; ++i) {
+			radius_squared = std::max(radius_squared, vertices[i].x * vertices[i].x + vertices[i].y * vertices[i].y);
+		}
+		m_MeshRadius = std::sqrt(radius_squared);
+	}
+
+	bool RenderParameters::CreateIndexBuffer(const std::vector<uint32_t>& index_data)
+	{
+		m_IndexCount = static_cast<uint32_t>(index_data.size() - index_data.size() % 3);
+		if (m_IndexCount == 0) {
+			return true;
+		}
+		uint32_t max_index = *std::max_element(index_data.begin(), index_data.begin() + m_IndexCount);
+		if (max_index >= GetVertexCount()) {
+			std::cout << "Index data refers past the end of the vertex data!" << std::endl;
 			return false;
 		}
+		m_IndexedVertexCount = max_index + 1;
 
-		memcpy(staging_buffer_memory_pointer, &vertex_data[0], m_VertexBuffer.size);
+		// Indices that fit are narrowed to 16 bits, which halves the index fetch bandwidth
+		std::vector<uint16_t> short_indices;
+		const void *indices = &index_data[0];
+		m_IndexType = VK_INDEX_TYPE_UINT32;
+		m_IndexBuffer.size = m_IndexCount * sizeof(uint32_t);
+		if (max_index <= UINT16_MAX) {
+			short_indices.assign(index_data.begin(), index_data.begin() + m_IndexCount);
+			indices = &short_indices[0];
+			m_IndexType = VK_INDEX_TYPE_UINT16;
+			m_IndexBuffer.size = m_IndexCount * sizeof(uint16_t);
+		}
 
-		VkMappedMemoryRange flush_range = {
-			VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,            
-			nullptr,                                         
-			m_StagingBuffer.memory,                        
-			0,                                                 
-			m_VertexBuffer.size                          
-		};
-		vkFlushMappedMemoryRanges(m_Device, 1, &flush_range);
+		if (!CreateBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_IndexBuffer)) {
+			std::cout << "Could not create index buffer!" << std::endl;
+			return false;
+		}
+		if (!EnqueueBufferUpload(indices, m_IndexBuffer.size, m_IndexBuffer.handle, VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT)) {
+			return false;
+		}
+		MarkDirty(DIRTY_VERTEX_BUFFER_BIT);
+		return true;
+	}
 
-		vkUnmapMemory(m_Device, m_StagingBuffer.memory);
+	void RenderParameters::QueueMeshDraws(VkBuffer vertex_buffer)
+	{
+		QueuedDraw draw = {};
+		draw.descriptorSet = m_DescriptorSet.handle;
+		draw.vertexBuffer = vertex_buffer;
+		draw.instanceCount = 1;
+		draw.constants.tint = { 1.0f, 1.0f, 1.0f };
+		if (m_IndexCount != 0) {
+			// Streamed vertex data may have shrunk below what the indices refer to
+			if (GetVertexCount() < m_IndexedVertexCount) {
+				return;
+			}
+			draw.pipeline = m_TriangleListPipeline;
+			draw.indexBuffer = m_IndexBuffer.handle;
+			draw.indexType = m_IndexType;
+			draw.count = m_IndexCount;
+		}
+		else if (GetVertexCount() != 0) {
+			draw.pipeline = m_GraphicsPipeline;
+			draw.count = GetVertexCount();
+		}
+		else {
+			return;
+		}
+		bool indexed = (m_IndexCount != 0);
+		m_RenderQueue.Add(RenderQueue::MakeKey(0, indexed ? QUEUE_PIPELINE_TRIANGLE_LIST : QUEUE_PIPELINE_STRIP, 0, 0), draw);
+		if (m_InstanceCount == 0) {
+			return;
+		}
+
+		// Culled instances are compacted on the GPU, which also writes how many of them are left
+		draw.pipeline = m_PipelineRegistry.Get(m_InstancedPermutations[indexed ? 1 : 0].Get(m_InstanceFeatures));
+		draw.instanceBuffer = m_GpuCulling ? m_VisibleInstanceBuffers[m_FrameIndex].handle : m_InstanceBuffers[m_FrameIndex].handle;
+		draw.indirectBuffer = m_GpuCulling ? m_IndirectBuffers[m_FrameIndex].handle : VK_NULL_HANDLE;
+		draw.instanceCount = m_InstanceCount;
+		m_RenderQueue.Add(RenderQueue::MakeKey(0, indexed ? QUEUE_PIPELINE_INSTANCED_TRIANGLE_LIST : QUEUE_PIPELINE_INSTANCED, 0, 0), draw);
+	}
 
-		VkCommandBufferBeginInfo command_buffer_begin_info = {
-			VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,        // VkStructureType                        sType
-			nullptr,                                            // const void                            *pNext
-			VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,        // VkCommandBufferUsageFlags              flags
-			nullptr                                             // const VkCommandBufferInheritanceInfo  *pInheritanceInfo
-		};
+	void RenderParameters::RecordQueuedDraws(VkCommandBuffer command_buffer, uint32_t uniform_offset)
+	{
+		m_RenderQueue.Sort();
+
+		// Every pipeline shares one layout, so bound sets, buffers and push constants stay valid across pipeline changes
+		VkPipeline      bound_pipeline = VK_NULL_HANDLE;
+		VkDescriptorSet bound_set = VK_NULL_HANDLE;
+		VkBuffer        bound_vertex_buffer = VK_NULL_HANDLE;
+		VkBuffer        bound_instance_buffer = VK_NULL_HANDLE;
+		VkBuffer        bound_index_buffer = VK_NULL_HANDLE;
+		const DrawConstants *pushed_constants = nullptr;
+		VkDeviceSize    offset = 0;
+		for (size_t i = 0; i < m_RenderQueue.GetCount(); ++i) {
+			const QueuedDraw &draw = m_RenderQueue.Get(i);
+			if (draw.pipeline != bound_pipeline) {
+				bound_pipeline = draw.pipeline;
+				vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bound_pipeline);
+			}
+			else {
+				++m_Statistics.skippedPipelineBinds;
+			}
+			if ((pushed_constants == nullptr) || (memcmp(pushed_constants, &draw.constants, sizeof(DrawConstants)) != 0)) {
+				pushed_constants = &draw.constants;
+				vkCmdPushConstants(command_buffer, m_PipelineLayout, DRAW_CONSTANT_STAGES, 0, sizeof(DrawConstants), pushed_constants);
+			}
+			if (draw.descriptorSet != bound_set) {
+				bound_set = draw.descriptorSet;
+				vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1, &bound_set, 1, &uniform_offset);
+			}
+			else {
+				++m_Statistics.skippedDescriptorSetBinds;
+			}
+			if (draw.vertexBuffer != bound_vertex_buffer) {
+				bound_vertex_buffer = draw.vertexBuffer;
+				vkCmdBindVertexBuffers(command_buffer, 0, 1, &bound_vertex_buffer, &offset);
+			}
+			else {
+				++m_Statistics.skippedVertexBufferBinds;
+			}
+			if (draw.instanceBuffer != VK_NULL_HANDLE) {
+				if (draw.instanceBuffer != bound_instance_buffer) {
+					bound_instance_buffer = draw.instanceBuffer;
+					vkCmdBindVertexBuffers(command_buffer, 1, 1, &bound_instance_buffer, &offset);
+				}
+				else {
+					++m_Statistics.skippedVertexBufferBinds;
+				}
+			}
 
-		VkCommandBuffer command_buffer = m_RenderingResources[0].commandBuffer;
+			if (draw.indexBuffer != VK_NULL_HANDLE) {
+				if (draw.indexBuffer != bound_index_buffer) {
+					bound_index_buffer = draw.indexBuffer;
+					vkCmdBindIndexBuffer(command_buffer, bound_index_buffer, 0, draw.indexType);
+				}
+				if (draw.indirectBuffer != VK_NULL_HANDLE) {
+					vkCmdDrawIndexedIndirect(command_buffer, draw.indirectBuffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+				}
+				else {
+					vkCmdDrawIndexed(command_buffer, draw.count, draw.instanceCount, draw.first, 0, 0);
+				}
+			}
+			else {
+				if (draw.indirectBuffer != VK_NULL_HANDLE) {
+					vkCmdDrawIndirect(command_buffer, draw.indirectBuffer, 0, 1, sizeof(VkDrawIndirectCommand));
+				}
+				else {
+					vkCmdDraw(command_buffer, draw.count, draw.instanceCount, draw.first, 0);
+				}
+			}
+		}
+		m_RenderQueue.Clear();
+	}
 
-		vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info);
+	bool RenderParameters::UpdateVertexData(const std::vector<float>& vertex_data, uint32_t offset)
+	{
+		if (!m_VertexStream.Update(offset, vertex_data.data(), vertex_data.size())) {
+			std::cout << "Vertex data update starts past the end of the stream!" << std::endl;
+			return false;
+		}
+		UpdateMeshRadius(offset, vertex_data.size(), false);
+		return ReserveDynamicVertexBuffers(m_VertexStream.GetSize());
+	}
 
-		VkBufferCopy buffer_copy_info = {
-			0,                                                  // VkDeviceSize                           srcOffset
-			0,                                                  // VkDeviceSize                           dstOffset
-			m_VertexBuffer.size                            // VkDeviceSize                           size
-		};
-		vkCmdCopyBuffer(command_buffer, m_StagingBuffer.handle, m_VertexBuffer.handle, 1, &buffer_copy_info);
+	bool RenderParameters::AppendVertexData(const std::vector<float>& vertex_data)
+	{
+		size_t offset = m_VertexStream.GetFloatCount();
+		m_VertexStream.Append(vertex_data.data(), vertex_data.size());
+		UpdateMeshRadius(offset, vertex_data.size(), false);
+		return ReserveDynamicVertexBuffers(m_VertexStream.GetSize());
+	}
 
-		VkBufferMemoryBarrier buffer_memory_barrier = {
-			VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,            // VkStructureType                        sType;
-			nullptr,                                            // const void                            *pNext
-			VK_ACCESS_MEMORY_WRITE_BIT,                         // VkAccessFlags                          srcAccessMask
-			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,                // VkAccessFlags                          dstAccessMask
-			VK_QUEUE_FAMILY_IGNORED,                            // uint32_t                               srcQueueFamilyIndex
-			VK_QUEUE_FAMILY_IGNORED,                            // uint32_t                               dstQueueFamilyIndex
-			m_VertexBuffer.handle,                              // VkBuffer                               buffer
-			0,                                                  // VkDeviceSize                           offset
-			VK_WHOLE_SIZE                                       // VkDeviceSize                           size
-		};
-		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &buffer_memory_barrier, 0, nullptr);
+	bool RenderParameters::SetVertexData(const std::vector<float>& vertex_data)
+	{
+		m_VertexStream.Orphan(vertex_data.data(), vertex_data.size());
+		UpdateMeshRadius(0, vertex_data.size(), true);
+		return ReserveDynamicVertexBuffers(m_VertexStream.GetSize());
+	}
 
-		vkEndCommandBuffer(command_buffer);
+	bool RenderParameters::ReserveDynamicVertexBuffers(VkDeviceSize size)
+	{
+		if (!m_DynamicVertexBuffers.empty() && (size <= m_DynamicVertexCapacity)) {
+			return true;
+		}
 
-		// Submit command buffer and copy data from staging buffer to a vertex buffer
-		VkSubmitInfo submit_info = {
-			VK_STRUCTURE_TYPE_SUBMIT_INFO,                      // VkStructureType                        sType
-			nullptr,                                            // const void                            *pNext
-			0,                                                  // uint32_t                               waitSemaphoreCount
-			nullptr,                                            // const VkSemaphore                     *pWaitSemaphores
-			nullptr,                                            // const VkPipelineStageFlags            *pWaitDstStageMask;
-			1,                                                  // uint32_t                               commandBufferCount
-			&command_buffer,                                    // const VkCommandBuffer                 *pCommandBuffers
-			0,                                                  // uint32_t                               signalSemaphoreCount
-			nullptr                                             // const VkSemaphore                     *pSignalSemaphores
+		// Frames in flight keep reading the old copies, so they are only released once those frames finish
+		for (size_t i = 0; i < m_DynamicVertexBuffers.size(); ++i) {
+			RetireBuffer(m_DynamicVertexBuffers[i].hostBuffer);
+			RetireBuffer(m_DynamicVertexBuffers[i].deviceBuffer);
+		}
+		m_DynamicVertexCapacity = std::max(std::max(size, 2 * m_DynamicVertexCapacity), MIN_DYNAMIC_VERTEX_BUFFER_SIZE);
+
+		// Vertex fetch from host-visible memory crosses the bus on discrete GPUs, so there every frame copies its changes into local memory
+		VkPhysicalDeviceProperties device_properties;
+		vkGetPhysicalDeviceProperties(m_PhysicalDevice, &device_properties);
+		bool staged = (device_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+
+		m_DynamicVertexBuffers.assign(m_RenderingResources.size(), DynamicVertexBufferData());
+		for (size_t i = 0; i < m_DynamicVertexBuffers.size(); ++i) {
+			DynamicVertexBufferData &dynamic_buffer = m_DynamicVertexBuffers[i];
+			VkBufferUsageFlags host_usage = staged ? VK_BUFFER_USAGE_TRANSFER_SRC_BIT : VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+			dynamic_buffer.hostBuffer.size = static_cast<uint32_t>(m_DynamicVertexCapacity);
+			if (!CreateBuffer(host_usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, dynamic_buffer.hostBuffer) ||
+				(dynamic_buffer.hostBuffer.memory.mappedData == nullptr)) {
+				std::cout << "Could not create dynamic vertex buffer!" << std::endl;
+				return false;
+			}
+			if (staged) {
+				dynamic_buffer.deviceBuffer.size = static_cast<uint32_t>(m_DynamicVertexCapacity);
+				if (!CreateBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, dynamic_buffer.deviceBuffer)) {
+					std::cout << "Could not create dynamic vertex buffer!" << std::endl;
+					return false;
+				}
+			}
+		}
+		m_VertexStream.Invalidate();
+		return true;
+	}
+
+	VkBuffer RenderParameters::AddVertexStreamPass(uint32_t &resource)
+	{
+		// The frame that used this copy last has finished, so only what changed since then is written
+		DynamicVertexBufferData &dynamic_buffer = m_DynamicVertexBuffers[m_FrameIndex];
+		resource = UINT32_MAX;
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		if (m_VertexStream.TakeDirtyRange(m_FrameIndex, offset, size)) {
+			memcpy(static_cast<char*>(dynamic_buffer.hostBuffer.memory.mappedData) + offset, reinterpret_cast<const char*>(m_VertexStream.GetData()) + offset, static_cast<size_t>(size));
+			m_MemoryAllocator.Flush(dynamic_buffer.hostBuffer.memory, offset, size);
+
+			if (dynamic_buffer.deviceBuffer.handle != VK_NULL_HANDLE) {
+				VkBuffer host_buffer = dynamic_buffer.hostBuffer.handle;
+				VkBuffer device_buffer = dynamic_buffer.deviceBuffer.handle;
+				resource = m_RenderGraph.ImportBuffer(device_buffer, offset, size, 0, 0);
+				uint32_t pass = m_RenderGraph.AddPass("VertexStream", [=](VkCommandBuffer command_buffer) {
+					VkBufferCopy buffer_copy_info = {
+						offset,                                             // VkDeviceSize                           srcOffset
+						offset,                                             // VkDeviceSize                           dstOffset
+						size                                                // VkDeviceSize                           size
+					};
+					vkCmdCopyBuffer(command_buffer, host_buffer, device_buffer, 1, &buffer_copy_info);
+				});
+				m_RenderGraph.Write(pass, resource, GraphAccess::TransferWrite);
+			}
+		}
+		return (dynamic_buffer.deviceBuffer.handle != VK_NULL_HANDLE) ? dynamic_buffer.deviceBuffer.handle : dynamic_buffer.hostBuffer.handle;
+	}
+
+	bool RenderParameters::DrawSprites(const std::vector<Sprite>& sprites)
+	{
+		// Layers and textures are part of the sort key, anything wider would wrap around in it
+		static_assert(MAX_SPRITE_LAYER <= RenderQueue::MAX_LAYER, "Sprite layers do not fit the render queue key");
+		for (size_t i = 0; i < sprites.size(); ++i) {
+			if ((sprites[i].texture >= m_TextureDescriptorSets.size()) || (sprites[i].texture > RenderQueue::MAX_TEXTURE)) {
+				std::cout << "Sprite refers to an unknown texture!" << std::endl;
+				return false;
+			}
+			if (sprites[i].layer > MAX_SPRITE_LAYER) {
+				std::cout << "Sprite layer is out of range!" << std::endl;
+				return false;
+			}
+		}
+		m_SpriteBatch.Add(sprites.data(), sprites.size());
+		return true;
+	}
+
+	void RenderParameters::SetSpriteCullSettings(const CullSettings& settings)
+	{
+		m_SpriteCullSettings = settings;
+	}
+
+	bool RenderParameters::SetSpriteLayerTint(uint32_t layer, Color tint)
+	{
+		if (layer > MAX_SPRITE_LAYER) {
+			std::cout << "Sprite layer is out of range!" << std::endl;
+			return false;
+		}
+		// Frames with sprites are recorded every time, so nothing pre-recorded has to be redone
+		m_SpriteLayerTints[layer] = tint;
+		return true;
+	}
+
+	CullRect RenderParameters::GetViewRect() const
+	{
+		// The camera is centred on the origin and covers the swap chain extent
+		float half_width = static_cast<float>(m_SwapChain.extent.width) * 0.5f;
+		float half_height = static_cast<float>(m_SwapChain.extent.height) * 0.5f;
+		CullRect view = { -half_width, -half_height, half_width, half_height };
+		return view;
+	}
+
+	bool RenderParameters::ReservePerFrameBuffers(std::vector<BufferParameters> &buffers, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlagBits memory_property)
+	{
+		VkDeviceSize capacity = buffers.empty() ? 0 : buffers[0].size;
+		if (!buffers.empty() && (size <= capacity)) {
+			return true;
+		}
+
+		// Data rewritten every frame gets one copy per frame in flight
+		for (size_t i = 0; i < buffers.size(); ++i) {
+			RetireBuffer(buffers[i]);
+		}
+		capacity = std::max(size, 2 * capacity);
+		buffers.assign(m_RenderingResources.size(), BufferParameters());
+		for (size_t i = 0; i < buffers.size(); ++i) {
+			buffers[i].size = static_cast<uint32_t>(capacity);
+			if (!CreateBuffer(usage, memory_property, buffers[i]) ||
+				((memory_property & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && (buffers[i].memory.mappedData == nullptr))) {
+				std::cout << "Could not create per-frame buffer!" << std::endl;
+				for (size_t j = 0; j <= i; ++j) {
+					DestroyBuffer(buffers[j]);
+				}
+				buffers.clear();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool RenderParameters::ReserveSpriteBuffers(uint32_t sprite_count)
+	{
+		if (sprite_count <= m_SpriteCapacity) {
+			return true;
+		}
+
+		uint32_t capacity = std::max(std::max(sprite_count, 2 * m_SpriteCapacity), MIN_SPRITE_CAPACITY);
+		if (!ReservePerFrameBuffers(m_SpriteVertexBuffers, capacity * SpriteBatch::VERTICES_PER_SPRITE * sizeof(SpriteVertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+			return false;
+		}
+
+		// Indices never change, they are uploaded once per capacity
+		RetireBuffer(m_SpriteIndexBuffer);
+		std::vector<uint32_t> indices(capacity * SpriteBatch::INDICES_PER_SPRITE);
+		SpriteBatch::BuildIndices(&indices[0], capacity);
+		m_SpriteIndexBuffer.size = static_cast<uint32_t>(indices.size() * sizeof(indices[0]));
+		if (!CreateBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_SpriteIndexBuffer)) {
+			std::cout << "Could not create sprite index buffer!" << std::endl;
+			return false;
+		}
+		if (!EnqueueBufferUpload(&indices[0], m_SpriteIndexBuffer.size, m_SpriteIndexBuffer.handle, VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT)) {
+			return false;
+		}
+		// This frame is submitted to the graphics queue after the copy and its hand-off, so the GPU orders them
+		uint64_t upload_token;
+		if (!SubmitUploads(upload_token) || !SubmitHandOffs(true)) {
+			return false;
+		}
+		m_SpriteCapacity = capacity;
+		return true;
+	}
+
+	bool RenderParameters::BuildSpriteBatch()
+	{
+		m_SpriteDraws.clear();
+		uint32_t sprite_count = m_SpriteBatch.GetSpriteCount();
+		if (sprite_count == 0) {
+			return true;
+		}
+
+		auto cull_start = std::chrono::high_resolution_clock::now();
+		uint32_t visible_count = m_SpriteBatch.Cull(GetViewRect(), m_SpriteCullSettings);
+		std::chrono::duration<double, std::milli> cull_time = std::chrono::high_resolution_clock::now() - cull_start;
+		m_Statistics.spriteCount += sprite_count;
+		m_Statistics.visibleSpriteCount += visible_count;
+		m_Statistics.spriteCullMilliseconds += cull_time.count();
+		if (visible_count == 0) {
+			m_SpriteBatch.Clear();
+			return true;
+		}
+		if (!ReserveSpriteBuffers(visible_count)) {
+			m_SpriteBatch.Clear();
+			return false;
+		}
+
+		auto build_start = std::chrono::high_resolution_clock::now();
+		BufferParameters &vertex_buffer = m_SpriteVertexBuffers[m_FrameIndex];
+		m_SpriteBatch.Build(static_cast<SpriteVertex*>(vertex_buffer.memory.mappedData), m_SpriteDraws);
+		m_MemoryAllocator.Flush(vertex_buffer.memory, 0, visible_count * SpriteBatch::VERTICES_PER_SPRITE * sizeof(SpriteVertex));
+		m_SpriteBatch.Clear();
+		std::chrono::duration<double, std::milli> build_time = std::chrono::high_resolution_clock::now() - build_start;
+
+		m_Statistics.spriteDrawCalls += m_SpriteDraws.size();
+		m_Statistics.spriteBuildMilliseconds += build_time.count();
+		return true;
+	}
+
+	void RenderParameters::QueueSpriteDraws()
+	{
+		QueuedDraw draw = {};
+		draw.pipeline = m_PipelineRegistry.Get(m_SpriteBlending ? m_BlendedSpritePipeline : m_SpritePipeline);
+		draw.indexBuffer = m_SpriteIndexBuffer.handle;
+		draw.indexType = VK_INDEX_TYPE_UINT32;
+		draw.instanceCount = 1;
+		for (size_t i = 0; i < m_SpriteDraws.size(); ++i) {
+			const SpriteDrawData &sprite_draw = m_SpriteDraws[i];
+			draw.descriptorSet = m_TextureDescriptorSets[sprite_draw.texture];
+			draw.vertexBuffer = m_SpriteVertexBuffers[m_FrameIndex].handle;
+			draw.count = sprite_draw.spriteCount * SpriteBatch::INDICES_PER_SPRITE;
+			draw.first = sprite_draw.firstSprite * SpriteBatch::INDICES_PER_SPRITE;
+			draw.constants.tint = m_SpriteLayerTints[sprite_draw.layer];
+			// Sprites come after the mesh and its instances, and keep the order the batch sorted them in
+			uint64_t key = RenderQueue::MakeKey(sprite_draw.layer, QUEUE_PIPELINE_SPRITE, sprite_draw.texture, static_cast<uint32_t>(i + 1));
+			m_RenderQueue.Add(key, draw);
+		}
+	}
+
+	bool RenderParameters::DrawInstances(const std::vector<Instance>& instances)
+	{
+		if (m_InstancedPipeline == VK_NULL_HANDLE) {
+			std::cout << "Instanced drawing is not available!" << std::endl;
+			return false;
+		}
+		m_Instances.insert(m_Instances.end(), instances.begin(), instances.end());
+		return true;
+	}
+
+	bool RenderParameters::BuildInstanceData()
+	{
+		m_InstanceCount = static_cast<uint32_t>(m_Instances.size());
+		if (m_InstanceCount == 0) {
+			return true;
+		}
+		VkDeviceSize size = m_Instances.size() * sizeof(Instance);
+		// With GPU culling the instances are read by the compute pass and only the survivors by the draw
+		bool buffers_ready = ReservePerFrameBuffers(m_InstanceBuffers, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		if (buffers_ready && m_GpuCulling) {
+			buffers_ready = ReservePerFrameBuffers(m_VisibleInstanceBuffers, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) &&
+				ReservePerFrameBuffers(m_IndirectBuffers, sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		}
+		if (!buffers_ready) {
+			m_Instances.clear();
+			m_InstanceCount = 0;
+			return false;
+		}
+		BufferParameters &instance_buffer = m_InstanceBuffers[m_FrameIndex];
+		memcpy(instance_buffer.memory.mappedData, &m_Instances[0], static_cast<size_t>(size));
+		m_MemoryAllocator.Flush(instance_buffer.memory, 0, size);
+		m_Instances.clear();
+		return true;
+	}
+
+	bool RenderParameters::SetGpuCulling(bool enabled)
+	{
+		if (enabled && (m_CullPipeline == VK_NULL_HANDLE)) {
+			std::cout << "GPU culling is not available!" << std::endl;
+			return false;
+		}
+		m_GpuCulling = enabled;
+		return true;
+	}
+
+	bool RenderParameters::CreateCullingResources()
+	{
+		if (m_InstancedPipeline == VK_NULL_HANDLE) {
+			return false;
+		}
+		uint32_t queue_families_count = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(m_PhysicalDevice, &queue_families_count, nullptr);
+		std::vector<VkQueueFamilyProperties> queue_family_properties(queue_families_count);
+		vkGetPhysicalDeviceQueueFamilyProperties(m_PhysicalDevice, &queue_families_count, &queue_family_properties[0]);
+		if (!(queue_family_properties[m_GraphicsQueue.familyIndex].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+			return false;
+		}
+
+		ShaderReflection reflection;
+		if (!ReflectShader("shaders/cull_instances.comp.spv", reflection)) {
+			return false;
+		}
+		const ShaderReflection *stages[] = { &reflection };
+		ReflectedLayout layout;
+		if (!m_LayoutCache.GetLayout(stages, 1, false, layout)) {
+			return false;
+		}
+		if ((layout.setLayouts.size() != 1) || (layout.pushConstantRanges.size() != 1)) {
+			std::cout << "Culling shader is expected to use one descriptor set and push constants!" << std::endl;
+			return false;
+		}
+		m_CullDescriptorSetLayout = layout.setLayouts[0];
+		m_CullPipelineLayout = layout.pipelineLayout;
+
+		return CreateComputePipeline("shaders/cull_instances.comp.spv", m_CullPipelineLayout, m_CullPipeline);
+	}
+
+	bool RenderParameters::CreateComputePipeline(const char *filename, VkPipelineLayout layout, VkPipeline &pipeline) const
+	{
+		auto compute_shader_module = CreateShaderModule(filename);
+		if (!compute_shader_module) {
+			return false;
+		}
+
+		VkComputePipelineCreateInfo pipeline_create_info = {
+			VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,     // VkStructureType                    sType
+			nullptr,                                            // const void                        *pNext
+			0,                                                  // VkPipelineCreateFlags              flags
+			{
+				VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, // VkStructureType                    sType
+				nullptr,                                        // const void                        *pNext
+				0,                                              // VkPipelineShaderStageCreateFlags   flags
+				VK_SHADER_STAGE_COMPUTE_BIT,                    // VkShaderStageFlagBits              stage
+				compute_shader_module.Get(),                    // VkShaderModule                     module
+				"main",                                         // const char                        *pName
+				nullptr                                         // const VkSpecializationInfo        *pSpecializationInfo
+			},                                                  // VkPipelineShaderStageCreateInfo    stage
+			layout,                                             // VkPipelineLayout                   layout
+			VK_NULL_HANDLE,                                     // VkPipeline                         basePipelineHandle
+			-1                                                  // int32_t                            basePipelineIndex
 		};
+		if (vkCreateComputePipelines(m_Device, m_PipelineCache.GetHandle(), 1, &pipeline_create_info, nullptr, &pipeline) != VK_SUCCESS) {
+			std::cout << "Could not create compute pipeline!" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	bool RenderParameters::AddInstanceCullingPasses(uint32_t &visible_resource, uint32_t &indirect_resource)
+	{
+		BufferParameters &instance_buffer = m_InstanceBuffers[m_FrameIndex];
+		BufferParameters &visible_instance_buffer = m_VisibleInstanceBuffers[m_FrameIndex];
+		BufferParameters &indirect_buffer = m_IndirectBuffers[m_FrameIndex];
 
-		if (vkQueueSubmit(m_GraphicsQueue.handle, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+		// The buffers behind the set may have grown since the last frame, so it lives only as long as this frame
+		VkDescriptorSet descriptor_set;
+		if (!m_DescriptorAllocator.AllocateFrameSet(m_CullDescriptorSetLayout, descriptor_set)) {
 			return false;
 		}
 
-		vkDeviceWaitIdle(m_Device);
-
+		VkDescriptorBufferInfo buffer_infos[] = {
+			{ instance_buffer.handle, 0, VK_WHOLE_SIZE },
+			{ visible_instance_buffer.handle, 0, VK_WHOLE_SIZE },
+			{ indirect_buffer.handle, 0, VK_WHOLE_SIZE }
+		};
+		VkWriteDescriptorSet descriptor_write = {
+			VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,             // VkStructureType                sType
+			nullptr,                                            // const void                    *pNext
+			descriptor_set,                                     // VkDescriptorSet                dstSet
+			0,                                                  // uint32_t                       dstBinding
+			0,                                                  // uint32_t                       dstArrayElement
+			3,                                                  // uint32_t                       descriptorCount
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,                  // VkDescriptorType               descriptorType
+			nullptr,                                            // const VkDescriptorImageInfo   *pImageInfo
+			buffer_infos,                                       // const VkDescriptorBufferInfo  *pBufferInfo
+			nullptr                                             // const VkBufferView            *pTexelBufferView
+		};
+		vkUpdateDescriptorSets(m_Device, 1, &descriptor_write, 0, nullptr);
+
+		// Instances are written by the host before submission, the other buffers belong to this frame only
+		uint32_t instance_resource = m_RenderGraph.ImportBuffer(instance_buffer.handle, 0, VK_WHOLE_SIZE, 0, 0);
+		visible_resource = m_RenderGraph.ImportBuffer(visible_instance_buffer.handle, 0, VK_WHOLE_SIZE, 0, 0);
+		indirect_resource = m_RenderGraph.ImportBuffer(indirect_buffer.handle, 0, VK_WHOLE_SIZE, 0, 0);
+
+		// The visible count starts at zero; the element count is whatever the mesh draw would use
+		VkDrawIndexedIndirectCommand draw_command = {};
+		draw_command.indexCount = (m_IndexCount != 0) ? m_IndexCount : GetVertexCount();
+		VkBuffer indirect_handle = indirect_buffer.handle;
+		uint32_t reset_pass = m_RenderGraph.AddPass("CullReset", [=](VkCommandBuffer command_buffer) {
+			vkCmdUpdateBuffer(command_buffer, indirect_handle, 0, sizeof(draw_command), reinterpret_cast<const uint32_t*>(&draw_command));
+		});
+		m_RenderGraph.Write(reset_pass, indirect_resource, GraphAccess::TransferWrite);
+
+		struct {
+			CullRect viewRect;
+			float    meshRadius;
+			uint32_t instanceCount;
+		} cull_parameters = { GetViewRect(), m_MeshRadius, m_InstanceCount };
+		uint32_t cull_pass = m_RenderGraph.AddPass("CullInstances", [=](VkCommandBuffer command_buffer) {
+			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullPipeline);
+			vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullPipelineLayout, 0, 1, &descriptor_set, 0, nullptr);
+			vkCmdPushConstants(command_buffer, m_CullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(cull_parameters), &cull_parameters);
+			vkCmdDispatch(command_buffer, (cull_parameters.instanceCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+		});
+		m_RenderGraph.Read(cull_pass, instance_resource, GraphAccess::ComputeRead);
+		m_RenderGraph.Write(cull_pass, visible_resource, GraphAccess::ComputeWrite);
+		m_RenderGraph.Write(cull_pass, indirect_resource, GraphAccess::ComputeWrite);
 		return true;
 	}
 
+	bool RenderParameters::UsesPerFrameGeometry() const
+	{
+		return !m_DynamicVertexBuffers.empty() || !m_SpriteDraws.empty() || (m_InstanceCount != 0);
+	}
+
+	uint32_t RenderParameters::GetVertexCount() const
+	{
+		return static_cast<uint32_t>(m_VertexStream.GetSize() / sizeof(VertexData));
+	}
+
+	void RenderParameters::RetireBuffer(BufferParameters &buffer)
+	{
+		if (buffer.handle == VK_NULL_HANDLE) {
+			return;
+		}
+		RetiredBufferData retired;
+		retired.buffer = buffer;
+		retired.submitIndex = m_SubmitCount;
+		m_RetiredBuffers.push_back(retired);
+		buffer = BufferParameters();
+	}
+
+	void RenderParameters::ReleaseRetiredBuffers(bool force)
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < m_RetiredBuffers.size(); ++i) {
+			if (force || IsSubmitCompleted(m_RetiredBuffers[i].submitIndex)) {
+				DestroyBuffer(m_RetiredBuffers[i].buffer);
+			}
+			else {
+				m_RetiredBuffers[kept++] = m_RetiredBuffers[i];
+			}
+		}
+		m_RetiredBuffers.resize(kept);
+	}
+
+	bool RenderParameters::CopyVertexData(const std::vector<float>& vertex_data) {
+		return EnqueueBufferUpload(&vertex_data[0], m_VertexBuffer.size, m_VertexBuffer.handle, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	}
+
 	bool RenderParameters::CreateFences()
 	{
 		VkFenceCreateInfo fence_create_info{};
@@ -922,39 +2534,48 @@ namespace HelloEngine
 			std::cout << "Could not staging buffer!" << std::endl;
 			return false;
 		}
+		if (m_StagingBuffer.memory.mappedData == nullptr) {
+			std::cout << "Staging buffer memory is not mapped!" << std::endl;
+			return false;
+		}
+		m_StagingRing.Initialize(m_StagingBuffer.size);
 
 		return true;
 	}
 
+	bool RenderParameters::ReflectShader(const char *filename, ShaderReflection &reflection) const
+	{
+		const std::vector<char> code = GetBinaryFileContents(filename);
+		if (code.size() == 0) {
+			return false;
+		}
+		return reflection.Parse(code, filename);
+	}
+
 	bool RenderParameters::CreateDescriptorSetLayout()
 	{
-		std::vector<VkDescriptorSetLayoutBinding> layout_bindings = {
-			{
-				0,                                                  // uint32_t                             binding
-				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,          // VkDescriptorType                     descriptorType
-				1,                                                  // uint32_t                             descriptorCount
-				VK_SHADER_STAGE_FRAGMENT_BIT,                       // VkShaderStageFlags                   stageFlags
-				nullptr                                             // const VkSampler                     *pImmutableSamplers
-			},
-			{
-				1,                                                  // uint32_t                             binding
-				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,                  // VkDescriptorType                     descriptorType
-				1,                                                  // uint32_t                             descriptorCount
-				VK_SHADER_STAGE_VERTEX_BIT,                         // VkShaderStageFlags                   stageFlags
-				nullptr                                             // const VkSampler                     *pImmutableSamplers
-			}
-		};
-		VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {
-			VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,  // VkStructureType                      sType
-			nullptr,                                              // const void                          *pNext
-			0,                                                    // VkDescriptorSetLayoutCreateFlags     flags
-			static_cast<uint32_t>(layout_bindings.size()),        // uint32_t                             bindingCount
-			&layout_bindings[0]                                   // const VkDescriptorSetLayoutBinding  *pBindings
-		};
-		if (vkCreateDescriptorSetLayout(m_Device, &descriptor_set_layout_create_info, nullptr, &m_DescriptorSet.layout) != VK_SUCCESS) {
-			std::cout << "Could not create descriptor set layout!" << std::endl;
+		// The texture and uniform buffer bindings come from the mesh shaders themselves;
+		// the uniform buffer is addressed through dynamic offsets into the uniform ring
+		ShaderReflection reflections[2];
+		if (!ReflectShader("shaders/vert.spv", reflections[0]) || !ReflectShader("shaders/frag.spv", reflections[1])) {
+			return false;
+		}
+		const ShaderReflection *stages[] = { &reflections[0], &reflections[1] };
+		if (!m_LayoutCache.GetLayout(stages, 2, true, m_MeshLayout)) {
+			return false;
+		}
+		if (m_MeshLayout.setLayouts.size() != 1) {
+			std::cout << "Mesh shaders are expected to use a single descriptor set!" << std::endl;
 			return false;
 		}
+		// The prebuilt mesh shaders do not read the draw constants, but the pipelines drawing with them
+		// share this layout with the ones that do
+		if (m_MeshLayout.pushConstantRanges.empty()) {
+			VkPushConstantRange push_constant_range = { DRAW_CONSTANT_STAGES, 0, sizeof(DrawConstants) };
+			m_MeshLayout.pushConstantRanges.push_back(push_constant_range);
+			m_MeshLayout.pipelineLayout = m_LayoutCache.GetPipelineLayout(m_MeshLayout.setLayouts, m_MeshLayout.pushConstantRanges);
+		}
+		m_DescriptorSet.layout = m_MeshLayout.setLayouts[0];
 		return true;
 	}
 
@@ -980,7 +2601,7 @@ namespace HelloEngine
 			return false;
 		}
 
-		if (vkBindBufferMemory(m_Device, buffer.handle, buffer.memory, 0) != VK_SUCCESS) {
+		if (vkBindBufferMemory(m_Device, buffer.handle, buffer.memory.handle, buffer.memory.offset) != VK_SUCCESS) {
 			std::cout << "Could not bind memory to a buffer!" << std::endl;
 			return false;
 		}
@@ -988,36 +2609,19 @@ namespace HelloEngine
 		return true;
 	}
 
-	bool RenderParameters::PrepareFrame(VkCommandBuffer command_buffer, const ImageParameters &image_parameters, VkFramebuffer &framebuffer) const
+	bool RenderParameters::PrepareFrame(VkCommandBuffer command_buffer, const ImageParameters &image_parameters, VkFramebuffer framebuffer, VkCommandBufferUsageFlags usage)
 	{
-		if (!CreateFramebuffer(framebuffer, image_parameters.view)) {
-			return false;
-		}
-
 		VkCommandBufferBeginInfo command_buffer_begin_info {};
 		command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;			
+		command_buffer_begin_info.flags = usage;
 		vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info);
+		++m_Statistics.commandBufferRecordings;
 
 		VkImageSubresourceRange image_subresource_range {};
 		image_subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		image_subresource_range.levelCount = 1;
 		image_subresource_range.layerCount = 1;
 
-		if (m_PresentQueue.handle != m_GraphicsQueue.handle) {
-			VkImageMemoryBarrier barrier_from_present_to_draw{};
-			barrier_from_present_to_draw.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			barrier_from_present_to_draw.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-			barrier_from_present_to_draw.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-			barrier_from_present_to_draw.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-			barrier_from_present_to_draw.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-			barrier_from_present_to_draw.srcQueueFamilyIndex = m_GraphicsQueue.familyIndex;
-			barrier_from_present_to_draw.dstQueueFamilyIndex = m_PresentQueue.familyIndex;
-			barrier_from_present_to_draw.image = image_parameters.handle;
-			barrier_from_present_to_draw.subresourceRange = image_subresource_range;		
-			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier_from_present_to_draw);
-		}		
-		
 		VkClearValue clear_value = {
 			m_ClearColor.r, m_ClearColor.g, m_ClearColor.b                       
 		};
@@ -1030,56 +2634,79 @@ namespace HelloEngine
 		render_pass_begin_info.clearValueCount = 1;
 		render_pass_begin_info.pClearValues = &clear_value;
 
-		vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline);
+		// The frame is described as passes with the resources they use, the graph places every barrier between them.
+		// The swap chain image is cleared, so its previous contents and layout do not matter; the acquire semaphore
+		// is waited for at the color attachment output stage.
+		m_RenderGraph.Reset();
+		uint32_t swap_chain_image = m_RenderGraph.ImportImage(image_parameters.handle, image_subresource_range, VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0);
+		m_RenderGraph.SetOutput(swap_chain_image, GraphAccess::Present, m_GraphicsQueue.familyIndex, m_PresentQueue.familyIndex);
+
+		// Pre-recorded buffers are replayed many times, so each of them carries the projection it was recorded with
+		// and writes it into the persistent block; other frames put it into their own region of the uniform ring
+		uint32_t uniform_offset = m_UniformRing.GetPersistentOffset();
+		uint32_t uniform_resource = UINT32_MAX;
+		if (usage & VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT) {
+			uniform_resource = AddUniformUpdatePass(uniform_offset);
+		}
+		else {
+			const std::array<float, 16> uniform_data = GetUniformBufferData();
+			if (!AllocateUniformData(&uniform_data[0], sizeof(uniform_data), uniform_offset)) {
+				return false;
+			}
+		}
 
-		VkViewport viewport{};
-		viewport.width = static_cast<float>(m_SwapChain.extent.width);
-		viewport.height = static_cast<float>(m_SwapChain.extent.height);
-		viewport.maxDepth = 1.0f;
+		VkBuffer vertex_buffer = m_VertexBuffer.handle;
+		uint32_t vertex_resource = UINT32_MAX;
+		if (!m_DynamicVertexBuffers.empty()) {
+			vertex_buffer = AddVertexStreamPass(vertex_resource);
+		}
+		uint32_t visible_instance_resource = UINT32_MAX;
+		uint32_t indirect_resource = UINT32_MAX;
+		if (m_GpuCulling && (m_InstanceCount != 0) && !AddInstanceCullingPasses(visible_instance_resource, indirect_resource)) {
+			return false;
+		}
 
-		VkRect2D scissor{};
-		scissor.extent = {
-			m_SwapChain.extent.width,
-			m_SwapChain.extent.height
-		};
+		uint32_t scene_pass = m_RenderGraph.AddPass("Scene", [&](VkCommandBuffer command_buffer) {
+			vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
 
-		vkCmdSetViewport(command_buffer, 0, 1, &viewport);
-		vkCmdSetScissor(command_buffer, 0, 1, &scissor);
-
-		VkDeviceSize offset = 0;
-		vkCmdBindVertexBuffers(command_buffer, 0, 1, &m_VertexBuffer.handle, &offset);
-		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1, &m_DescriptorSet.handle, 0, nullptr);
-		vkCmdDraw(command_buffer, 4, 1, 0, 0);
-
-		vkCmdEndRenderPass(command_buffer);
-
-		if (m_GraphicsQueue.handle != m_PresentQueue.handle) {
-			VkImageMemoryBarrier barrier_from_draw_to_present{};
-			barrier_from_draw_to_present.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER; 
-			barrier_from_draw_to_present.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;                      
-			barrier_from_draw_to_present.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;                      
-			barrier_from_draw_to_present.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;                 
-			barrier_from_draw_to_present.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;                
-			barrier_from_draw_to_present.srcQueueFamilyIndex = m_GraphicsQueue.familyIndex;                 
-			barrier_from_draw_to_present.dstQueueFamilyIndex = m_PresentQueue.familyIndex;                  
-			barrier_from_draw_to_present.image = image_parameters.handle;                              
-			barrier_from_draw_to_present.subresourceRange = image_subresource_range;   
-			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier_from_draw_to_present);
-		}
-		VkImageMemoryBarrier barrier_from_draw_to_present = {
-			VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,             // VkStructureType                        sType
-			nullptr,                                            // const void                            *pNext
-			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,               // VkAccessFlags                          srcAccessMask
-			VK_ACCESS_MEMORY_READ_BIT,                          // VkAccessFlags                          dstAccessMask
-			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,           // VkImageLayout                          oldLayout
-			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,                    // VkImageLayout                          newLayout
-			m_GraphicsQueue.familyIndex,                        // uint32_t                               srcQueueFamilyIndex
-			m_PresentQueue.familyIndex,                         // uint32_t                               dstQueueFamilyIndex
-			image_parameters.handle,                            // VkImage                                image
-			image_subresource_range                             // VkImageSubresourceRange                subresourceRange
-		};
-		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier_from_draw_to_present);
+			VkViewport viewport{};
+			viewport.width = static_cast<float>(m_SwapChain.extent.width);
+			viewport.height = static_cast<float>(m_SwapChain.extent.height);
+			viewport.maxDepth = 1.0f;
+
+			VkRect2D scissor{};
+			scissor.extent = {
+				m_SwapChain.extent.width,
+				m_SwapChain.extent.height
+			};
+
+			vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+			vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+			QueueMeshDraws(vertex_buffer);
+			QueueSpriteDraws();
+			RecordQueuedDraws(command_buffer, uniform_offset);
+
+			vkCmdEndRenderPass(command_buffer);
+		});
+		m_RenderGraph.Write(scene_pass, swap_chain_image, GraphAccess::ColorAttachmentWrite);
+		if (uniform_resource != UINT32_MAX) {
+			m_RenderGraph.Read(scene_pass, uniform_resource, GraphAccess::UniformRead);
+		}
+		if (vertex_resource != UINT32_MAX) {
+			m_RenderGraph.Read(scene_pass, vertex_resource, GraphAccess::VertexAttributeRead);
+		}
+		if (indirect_resource != UINT32_MAX) {
+			m_RenderGraph.Read(scene_pass, visible_instance_resource, GraphAccess::VertexAttributeRead);
+			m_RenderGraph.Read(scene_pass, indirect_resource, GraphAccess::IndirectRead);
+		}
+
+		if (!m_RenderGraph.Compile()) {
+			return false;
+		}
+		m_RenderGraph.Execute(command_buffer);
+		m_Statistics.renderGraphBarriers += m_RenderGraph.GetBarrierCount();
+		m_Statistics.culledRenderGraphPasses += m_RenderGraph.GetCulledPassCount();
 
 		if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
 			std::cout << "Could not record command buffer!" << std::endl;
@@ -1088,28 +2715,12 @@ namespace HelloEngine
 		return true;
 	}
 
-	bool RenderParameters::AllocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlagBits property, VkDeviceMemory *memory) const
+	bool RenderParameters::AllocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlagBits property, MemoryAllocation *memory)
 	{
 		VkMemoryRequirements buffer_memory_requirements;
 		vkGetBufferMemoryRequirements(m_Device, buffer, &buffer_memory_requirements);
 
-		VkPhysicalDeviceMemoryProperties memory_properties;
-		vkGetPhysicalDeviceMemoryProperties(m_PhysicalDevice, &memory_properties);
-
-		for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
-			if ((buffer_memory_requirements.memoryTypeBits & (1 << i)) &&
-				(memory_properties.memoryTypes[i].propertyFlags & property)) {
-
-				VkMemoryAllocateInfo memory_allocate_info {};
-				memory_allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-				memory_allocate_info.allocationSize = buffer_memory_requirements.size;
-				memory_allocate_info.memoryTypeIndex = i;
-				if (vkAllocateMemory(m_Device, &memory_allocate_info, nullptr, memory) == VK_SUCCESS) {
-					return true;
-				}
-			}
-		}
-		return false;
+		return m_MemoryAllocator.Allocate(buffer_memory_requirements, property, true, *memory);
 	}
 
 	bool RenderParameters::CreateCommandPool(uint32_t queue_family_index, VkCommandPool *pool) const
@@ -1206,16 +2817,27 @@ namespace HelloEngine
 		return surface_capabilities.currentTransform;
 	}
 
-	VkPresentModeKHR RenderParameters::GetSwapChainPresentMode(std::vector<VkPresentModeKHR> &present_modes)
+	VkPresentModeKHR RenderParameters::GetSwapChainPresentMode(std::vector<VkPresentModeKHR> &present_modes, PresentMode requested_mode)
 	{
-		for (auto& present_mode : present_modes) {
-			if (present_mode == VK_PRESENT_MODE_MAILBOX_KHR) {
-				return present_mode;
-			}
+		// Modes are tried in order, FIFO is the last resort as it is the only one required to be supported
+		std::vector<VkPresentModeKHR> preferred_modes;
+		switch (requested_mode) {
+		case PresentMode::LowLatency:
+			preferred_modes = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+			break;
+		case PresentMode::Uncapped:
+			preferred_modes = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR };
+			break;
+		case PresentMode::VSync:
+			break;
 		}
-		for (auto& present_mode : present_modes) {
-			if (present_mode == VK_PRESENT_MODE_FIFO_KHR) {
-				return present_mode;
+		preferred_modes.push_back(VK_PRESENT_MODE_FIFO_KHR);
+
+		for (auto& preferred_mode : preferred_modes) {
+			for (auto& present_mode : present_modes) {
+				if (present_mode == preferred_mode) {
+					return present_mode;
+				}
 			}
 		}
 		std::cout << "FIFO present mode is not supported by the swap chain!\n";
@@ -1243,6 +2865,14 @@ namespace HelloEngine
       return false;                                                                         \
     }
 
+#define VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION( fun, extension )                         \
+    if( IsExtensionEnabled( extension, m_InstanceExtensions ) ) {                           \
+      if( !(fun = (PFN_##fun)vkGetInstanceProcAddr( m_Instance, #fun )) ) {                 \
+        std::cout << "Could not load instance level function: " << #fun << "!" << std::endl; \
+        return false;                                                                       \
+      }                                                                                     \
+    }
+
 #include "vk_functions.inl"
 
 		return true;
@@ -1256,6 +2886,14 @@ namespace HelloEngine
       return false;                                                                       \
     }
 
+#define VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION( fun, extension )                         \
+    if( IsExtensionEnabled( extension, m_DeviceExtensions ) ) {                           \
+      if( !(fun = (PFN_##fun)vkGetDeviceProcAddr( m_Device, #fun )) ) {                   \
+        std::cout << "Could not load device level function: " << #fun << "!" << std::endl; \
+        return false;                                                                     \
+      }                                                                                   \
+    }
+
 #include "vk_functions.inl"
 
 		return true;
@@ -1272,12 +2910,12 @@ namespace HelloEngine
 			return false;
 		}
 
-		if (!AllocateImageMemory(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_Image.memory)) {
+		if (!AllocateImageMemory(m_Image.handle, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_Image.memory)) {
 			std::cout << "Could not allocate memory for image!" << std::endl;
 			return false;
 		}
 
-		if (vkBindImageMemory(m_Device, m_Image.handle, m_Image.memory, 0) != VK_SUCCESS) {
+		if (vkBindImageMemory(m_Device, m_Image.handle, m_Image.memory.handle, m_Image.memory.offset) != VK_SUCCESS) {
 			std::cout << "Could not bind memory to an image!" << std::endl;
 			return false;
 		}
@@ -1300,35 +2938,6 @@ namespace HelloEngine
 		return true;
 	}
 
-	bool RenderParameters::CreateDescriptorPool()
-	{
-		std::vector<VkDescriptorPoolSize> pool_sizes = {
-			{
-				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,    // VkDescriptorType               type
-				1                                             // uint32_t                       descriptorCount
-			},
-			{
-				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,            // VkDescriptorType               type
-				1                                             // uint32_t                       descriptorCount
-			}
-		};
-
-		VkDescriptorPoolCreateInfo descriptor_pool_create_info = {
-			VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,  // VkStructureType                sType
-			nullptr,                                        // const void                    *pNext
-			0,                                              // VkDescriptorPoolCreateFlags    flags
-			1,                                              // uint32_t                       maxSets
-			static_cast<uint32_t>(pool_sizes.size()),       // uint32_t                       poolSizeCount
-			&pool_sizes[0]                                  // const VkDescriptorPoolSize    *pPoolSizes
-		};
-
-		if (vkCreateDescriptorPool(m_Device, &descriptor_pool_create_info, nullptr, &m_DescriptorSet.pool) != VK_SUCCESS) {
-			std::cout << "Could not create descriptor pool!" << std::endl;
-			return false;
-		}
-		return true;
-	}
-
 	bool RenderParameters::CreateImage(uint32_t width, uint32_t height, VkImage* image) const
 	{
 		VkImageCreateInfo image_create_info = {
@@ -1357,60 +2966,43 @@ namespace HelloEngine
 		return vkCreateImage(m_Device, &image_create_info, nullptr, image) == VK_SUCCESS;
 	}
 
-	bool RenderParameters::AllocateDescriptorSet()
-	{
-		VkDescriptorSetAllocateInfo descriptor_set_allocate_info = {
-			VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, // VkStructureType                sType
-			nullptr,                                        // const void                    *pNext
-			m_DescriptorSet.pool,                      // VkDescriptorPool               descriptorPool
-			1,                                              // uint32_t                       descriptorSetCount
-			&m_DescriptorSet.layout                    // const VkDescriptorSetLayout   *pSetLayouts
-		};
-
-		if (vkAllocateDescriptorSets(m_Device, &descriptor_set_allocate_info, &m_DescriptorSet.handle) != VK_SUCCESS) {
-			std::cout << "Could not allocate descriptor set!" << std::endl;
-			return false;
-		}
-		return true;
-	}
-
-	bool RenderParameters::AllocateImageMemory(VkMemoryPropertyFlagBits property, VkDeviceMemory* memory)
+	bool RenderParameters::AllocateImageMemory(VkImage image, VkMemoryPropertyFlagBits property, MemoryAllocation* memory)
 	{
 		VkMemoryRequirements image_memory_requirements;
-		vkGetImageMemoryRequirements(m_Device, m_Image.handle, &image_memory_requirements);
+		vkGetImageMemoryRequirements(m_Device, image, &image_memory_requirements);
 
-		VkPhysicalDeviceMemoryProperties memory_properties;
-		vkGetPhysicalDeviceMemoryProperties(m_PhysicalDevice, &memory_properties);
-
-		for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
-			if ((image_memory_requirements.memoryTypeBits & (1 << i)) &&
-				(memory_properties.memoryTypes[i].propertyFlags & property)) {
-
-				VkMemoryAllocateInfo memory_allocate_info = {
-					VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,     // VkStructureType                        sType
-					nullptr,                                    // const void                            *pNext
-					image_memory_requirements.size,             // VkDeviceSize                           allocationSize
-					i                                           // uint32_t                               memoryTypeIndex
-				};
-
-				if (vkAllocateMemory(m_Device, &memory_allocate_info, nullptr, memory) == VK_SUCCESS) {
-					return true;
-				}
-			}
-		}
-		return false;
+		return m_MemoryAllocator.Allocate(image_memory_requirements, property, false, *memory);
 	}
 
 	bool RenderParameters::CreateUniformBuffer()
 	{
-		m_UniformBuffer.size = 16 * sizeof(float);
-		if (!CreateBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_UniformBuffer)) {
+		VkPhysicalDeviceProperties device_properties;
+		vkGetPhysicalDeviceProperties(m_PhysicalDevice, &device_properties);
+		VkDeviceSize alignment = device_properties.limits.minUniformBufferOffsetAlignment;
+		VkDeviceSize block_size = alignment > 1 ? (UNIFORM_BLOCK_SIZE + alignment - 1) / alignment * alignment : UNIFORM_BLOCK_SIZE;
+		uint32_t     frame_count = static_cast<uint32_t>(m_RenderingResources.size());
+
+		m_UniformBuffer.size = static_cast<uint32_t>(UniformRing::GetRequiredSize(block_size, UNIFORM_BLOCKS_PER_FRAME, frame_count));
+		if (!CreateBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, m_UniformBuffer)) {
 			std::cout << "Could not create uniform buffer!" << std::endl;
 			return false;
 		}
-		if (!CopyUniformBufferData()) {
+		if (m_UniformBuffer.memory.mappedData == nullptr) {
+			std::cout << "Uniform buffer memory is not mapped!" << std::endl;
+			return false;
+		}
+		m_UniformRing.Initialize(m_UniformBuffer.memory.mappedData, block_size, UNIFORM_BLOCKS_PER_FRAME, frame_count);
+		return true;
+	}
+
+	bool RenderParameters::AllocateUniformData(const void *data, size_t size, uint32_t &dynamic_offset)
+	{
+		void *block_data;
+		if ((size > UNIFORM_BLOCK_SIZE) || !m_UniformRing.Allocate(dynamic_offset, block_data)) {
+			std::cout << "Could not allocate uniform data for the frame!" << std::endl;
 			return false;
 		}
+		memcpy(block_data, data, size);
 		return true;
 	}
 
@@ -1468,278 +3060,70 @@ namespace HelloEngine
 
 	bool RenderParameters::CreatePipelineLayout()
 	{
-		VkPipelineLayoutCreateInfo layout_create_info = {
-			VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,  // VkStructureType                sType
-			nullptr,                                        // const void                    *pNext
-			0,                                              // VkPipelineLayoutCreateFlags    flags
-			1,                                              // uint32_t                       setLayoutCount
-			&m_DescriptorSet.layout,                   // const VkDescriptorSetLayout   *pSetLayouts
-			0,                                              // uint32_t                       pushConstantRangeCount
-			nullptr                                         // const VkPushConstantRange     *pPushConstantRanges
-		};
-
-		if (vkCreatePipelineLayout(m_Device, &layout_create_info, nullptr, &m_PipelineLayout) != VK_SUCCESS) {
-			std::cout << "Could not create pipeline layout!" << std::endl;
-			return false;
-		}
-		return true;
+		// Created together with the descriptor set layout it is reflected from
+		m_PipelineLayout = m_MeshLayout.pipelineLayout;
+		return m_PipelineLayout != VK_NULL_HANDLE;
 	}
 
 	bool RenderParameters::CopyTextureData(const Image &image)
 	{
-		void *staging_buffer_memory_pointer;
-		if (vkMapMemory(m_Device, m_StagingBuffer.memory, 0, image.GetSize(), 0, &staging_buffer_memory_pointer) != VK_SUCCESS) {
-			std::cout << "Could not map memory and upload texture data to a staging buffer!" << std::endl;
-			return false;
-		}
-		memcpy(staging_buffer_memory_pointer, image.GetData(), image.GetSize());
-
-		VkMappedMemoryRange flush_range = {
-			VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,              // VkStructureType                        sType
-			nullptr,                                            // const void                            *pNext
-			m_StagingBuffer.memory,                        // VkDeviceMemory                         memory
-			0,                                                  // VkDeviceSize                           offset
-			image.GetSize()                                          // VkDeviceSize                           size
-		};
-		vkFlushMappedMemoryRanges(m_Device, 1, &flush_range);
-
-		vkUnmapMemory(m_Device, m_StagingBuffer.memory);
-
-		VkCommandBufferBeginInfo command_buffer_begin_info = {
-			VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,        // VkStructureType                        sType
-			nullptr,                                            // const void                            *pNext
-			VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,        // VkCommandBufferUsageFlags              flags
-			nullptr                                             // const VkCommandBufferInheritanceInfo  *pInheritanceInfo
-		};
-
-		VkCommandBuffer command_buffer = m_RenderingResources[0].commandBuffer;
-
-		vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info);
-
-		VkImageSubresourceRange image_subresource_range = {
-			VK_IMAGE_ASPECT_COLOR_BIT,                          // VkImageAspectFlags                     aspectMask
-			0,                                                  // uint32_t                               baseMipLevel
-			1,                                                  // uint32_t                               levelCount
-			0,                                                  // uint32_t                               baseArrayLayer
-			1                                                   // uint32_t                               layerCount
-		};
-
-		VkImageMemoryBarrier image_memory_barrier_from_undefined_to_transfer_dst = {
-			VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,             // VkStructureType                        sType
-			nullptr,                                            // const void                            *pNext
-			0,                                                  // VkAccessFlags                          srcAccessMask
-			VK_ACCESS_TRANSFER_WRITE_BIT,                       // VkAccessFlags                          dstAccessMask
-			VK_IMAGE_LAYOUT_UNDEFINED,                          // VkImageLayout                          oldLayout
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,               // VkImageLayout                          newLayout
-			VK_QUEUE_FAMILY_IGNORED,                            // uint32_t                               srcQueueFamilyIndex
-			VK_QUEUE_FAMILY_IGNORED,                            // uint32_t                               dstQueueFamilyIndex
-			m_Image.handle,                                // VkImage                                image
-			image_subresource_range                             // VkImageSubresourceRange                subresourceRange
-		};
-		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_memory_barrier_from_undefined_to_transfer_dst);
-
-		VkBufferImageCopy buffer_image_copy_info = {
-			0,                                                  // VkDeviceSize                           bufferOffset
-			0,                                                  // uint32_t                               bufferRowLength
-			0,                                                  // uint32_t                               bufferImageHeight
-			{                                                   // VkImageSubresourceLayers               imageSubresource
-				VK_IMAGE_ASPECT_COLOR_BIT,                          // VkImageAspectFlags                     aspectMask
-				0,                                                  // uint32_t                               mipLevel
-				0,                                                  // uint32_t                               baseArrayLayer
-				1                                                   // uint32_t                               layerCount
-			},
-			{                                                   // VkOffset3D                             imageOffset
-				0,                                                  // int32_t                                x
-				0,                                                  // int32_t                                y
-				0                                                   // int32_t                                z
-			},
-			{                                                   // VkExtent3D                             imageExtent
-				image.GetWidth(),                                              // uint32_t                               width
-				image.GetHeight(),                                             // uint32_t                               height
-				1                                                   // uint32_t                               depth
-			}
-		};
-		vkCmdCopyBufferToImage(command_buffer, m_StagingBuffer.handle, m_Image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &buffer_image_copy_info);
-
-		VkImageMemoryBarrier image_memory_barrier_from_transfer_to_shader_read = {
-			VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,             // VkStructureType                        sType
-			nullptr,                                            // const void                            *pNext
-			VK_ACCESS_TRANSFER_WRITE_BIT,                       // VkAccessFlags                          srcAccessMask
-			VK_ACCESS_SHADER_READ_BIT,                          // VkAccessFlags                          dstAccessMask
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,               // VkImageLayout                          oldLayout
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,           // VkImageLayout                          newLayout
-			VK_QUEUE_FAMILY_IGNORED,                            // uint32_t                               srcQueueFamilyIndex
-			VK_QUEUE_FAMILY_IGNORED,                            // uint32_t                               dstQueueFamilyIndex
-			m_Image.handle,                                // VkImage                                image
-			image_subresource_range                             // VkImageSubresourceRange                subresourceRange
-		};
-		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_memory_barrier_from_transfer_to_shader_read);
-
-		vkEndCommandBuffer(command_buffer);
-
-		VkSubmitInfo submit_info = {
-			VK_STRUCTURE_TYPE_SUBMIT_INFO,                      // VkStructureType                        sType
-			nullptr,                                            // const void                            *pNext
-			0,                                                  // uint32_t                               waitSemaphoreCount
-			nullptr,                                            // const VkSemaphore                     *pWaitSemaphores
-			nullptr,                                            // const VkPipelineStageFlags            *pWaitDstStageMask;
-			1,                                                  // uint32_t                               commandBufferCount
-			&command_buffer,                                    // const VkCommandBuffer                 *pCommandBuffers
-			0,                                                  // uint32_t                               signalSemaphoreCount
-			nullptr                                             // const VkSemaphore                     *pSignalSemaphores
-		};
-
-		if (vkQueueSubmit(m_GraphicsQueue.handle, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
-			return false;
-		}
-
-		vkDeviceWaitIdle(m_Device);
-		return true;
+		return EnqueueImageUpload(image, m_Image.handle);
 	}
 
 	const std::array<float, 16> RenderParameters::GetUniformBufferData() const
 	{
-		float half_width = static_cast<float>(m_SwapChain.extent.width) * 0.5f;
-		float half_height = static_cast<float>(m_SwapChain.extent.height) * 0.5f;
-
-		return GetOrthographicProjectionMatrix(-half_width, half_width, -half_height, half_height, -1.0f, 1.0f);
+		CullRect view = GetViewRect();
+		return GetOrthographicProjectionMatrix(view.left, view.right, view.top, view.bottom, -1.0f, 1.0f);
 	}
 
-	bool RenderParameters::CopyUniformBufferData()
+	uint32_t RenderParameters::AddUniformUpdatePass(uint32_t offset)
 	{
 		const std::array<float, 16> uniform_data = GetUniformBufferData();
 
-		void *staging_buffer_memory_pointer;
-		if (vkMapMemory(m_Device, m_StagingBuffer.memory, 0, m_UniformBuffer.size, 0, &staging_buffer_memory_pointer) != VK_SUCCESS) {
-			std::cout << "Could not map memory and upload data to a staging buffer!" << std::endl;
-			return false;
-		}
-
-		memcpy(staging_buffer_memory_pointer, &uniform_data[0], m_UniformBuffer.size);
-
-		VkMappedMemoryRange flush_range = {
-			VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,              // VkStructureType                        sType
-			nullptr,                                            // const void                            *pNext
-			m_StagingBuffer.memory,                        // VkDeviceMemory                         memory
-			0,                                                  // VkDeviceSize                           offset
-			m_UniformBuffer.size                           // VkDeviceSize                           size
-		};
-		vkFlushMappedMemoryRanges(m_Device, 1, &flush_range);
-
-		vkUnmapMemory(m_Device, m_StagingBuffer.memory);
-
-		// Prepare command buffer to copy data from staging buffer to a uniform buffer
-		VkCommandBufferBeginInfo command_buffer_begin_info = {
-			VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,        // VkStructureType                        sType
-			nullptr,                                            // const void                            *pNext
-			VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,        // VkCommandBufferUsageFlags              flags
-			nullptr                                             // const VkCommandBufferInheritanceInfo  *pInheritanceInfo
-		};
-
-		VkCommandBuffer command_buffer = m_RenderingResources[0].commandBuffer;
-
-		vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info);
-
-		VkBufferCopy buffer_copy_info = {
-			0,                                                  // VkDeviceSize                           srcOffset
-			0,                                                  // VkDeviceSize                           dstOffset
-			m_VertexBuffer.size                            // VkDeviceSize                           size
-		};
-		vkCmdCopyBuffer(command_buffer, m_StagingBuffer.handle, m_UniformBuffer.handle, 1, &buffer_copy_info);
-
-		VkBufferMemoryBarrier buffer_memory_barrier = {
-			VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,            // VkStructureType                        sType;
-			nullptr,                                            // const void                            *pNext
-			VK_ACCESS_MEMORY_WRITE_BIT,                         // VkAccessFlags                          srcAccessMask
-			VK_ACCESS_UNIFORM_READ_BIT,                         // VkAccessFlags                          dstAccessMask
-			VK_QUEUE_FAMILY_IGNORED,                            // uint32_t                               srcQueueFamilyIndex
-			VK_QUEUE_FAMILY_IGNORED,                            // uint32_t                               dstQueueFamilyIndex
-			m_UniformBuffer.handle,                        // VkBuffer                               buffer
-			0,                                                  // VkDeviceSize                           offset
-			VK_WHOLE_SIZE                                       // VkDeviceSize                           size
-		};
-		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 0, nullptr, 1, &buffer_memory_barrier, 0, nullptr);
-
-		vkEndCommandBuffer(command_buffer);
-
-		// Submit command buffer and copy data from staging buffer to a vertex buffer
-		VkSubmitInfo submit_info = {
-			VK_STRUCTURE_TYPE_SUBMIT_INFO,                      // VkStructureType                        sType
-			nullptr,                                            // const void                            *pNext
-			0,                                                  // uint32_t                               waitSemaphoreCount
-			nullptr,                                            // const VkSemaphore                     *pWaitSemaphores
-			nullptr,                                            // const VkPipelineStageFlags            *pWaitDstStageMask;
-			1,                                                  // uint32_t                               commandBufferCount
-			&command_buffer,                                    // const VkCommandBuffer                 *pCommandBuffers
-			0,                                                  // uint32_t                               signalSemaphoreCount
-			nullptr                                             // const VkSemaphore                     *pSignalSemaphores
-		};
-
-		if (vkQueueSubmit(m_GraphicsQueue.handle, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
-			return false;
-		}
-
-		vkDeviceWaitIdle(m_Device);
-
-		return true;
+		// Previous replays of the command buffer may still read the block from their vertex shaders
+		uint32_t resource = m_RenderGraph.ImportBuffer(m_UniformBuffer.handle, offset, sizeof(uniform_data), VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_UNIFORM_READ_BIT);
+		VkBuffer uniform_buffer = m_UniformBuffer.handle;
+		uint32_t pass = m_RenderGraph.AddPass("Uniforms", [=](VkCommandBuffer command_buffer) {
+			vkCmdUpdateBuffer(command_buffer, uniform_buffer, offset, sizeof(uniform_data), reinterpret_cast<const uint32_t*>(&uniform_data[0]));
+		});
+		m_RenderGraph.Write(pass, resource, GraphAccess::TransferWrite);
+		return resource;
 	}
 
 	bool RenderParameters::UpdateDescriptorSet()
 	{
-		VkDescriptorImageInfo image_info = {
-			m_Image.sampler,                           // VkSampler                      sampler
-			m_Image.view,                              // VkImageView                    imageView
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL        // VkImageLayout                  imageLayout
-		};
-
-		VkDescriptorBufferInfo buffer_info = {
-			m_UniformBuffer.handle,                    // VkBuffer                       buffer
-			0,                                              // VkDeviceSize                   offset
-			m_UniformBuffer.size                       // VkDeviceSize                   range
-		};
-
-		std::vector<VkWriteDescriptorSet> descriptor_writes = {
-			{
-				VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,       // VkStructureType                sType
-				nullptr,                                      // const void                    *pNext
-				m_DescriptorSet.handle,                  // VkDescriptorSet                dstSet
-				0,                                            // uint32_t                       dstBinding
-				0,                                            // uint32_t                       dstArrayElement
-				1,                                            // uint32_t                       descriptorCount
-				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,    // VkDescriptorType               descriptorType
-				&image_info,                                  // const VkDescriptorImageInfo   *pImageInfo
-				nullptr,                                      // const VkDescriptorBufferInfo  *pBufferInfo
-				nullptr                                       // const VkBufferView            *pTexelBufferView
-			},
-			{
-				VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,       // VkStructureType                sType
-				nullptr,                                      // const void                    *pNext
-				m_DescriptorSet.handle,                  // VkDescriptorSet                dstSet
-				1,                                            // uint32_t                       dstBinding
-				0,                                            // uint32_t                       dstArrayElement
-				1,                                            // uint32_t                       descriptorCount
-				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,            // VkDescriptorType               descriptorType
-				nullptr,                                      // const VkDescriptorImageInfo   *pImageInfo
-				&buffer_info,                                 // const VkDescriptorBufferInfo  *pBufferInfo
-				nullptr                                       // const VkBufferView            *pTexelBufferView
-			}
-		};
+		// The offset of the block is supplied with every bind of the set
+		DescriptorSetDesc desc(m_DescriptorSet.layout);
+		desc.AddImage(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_Image.sampler, m_Image.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		desc.AddBuffer(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, m_UniformBuffer.handle, 0, UNIFORM_BLOCK_SIZE);
 
-		vkUpdateDescriptorSets(m_Device, static_cast<uint32_t>(descriptor_writes.size()), &descriptor_writes[0], 0, nullptr);
+		// Bindings seen before come back as the set already written for them
+		VkDescriptorSet descriptor_set;
+		if (!m_DescriptorAllocator.GetCachedSet(desc, descriptor_set)) {
+			return false;
+		}
+		if (descriptor_set == m_DescriptorSet.handle) {
+			return true;
+		}
+		m_DescriptorSet.handle = descriptor_set;
+		if (m_TextureDescriptorSets.empty()) {
+			m_TextureDescriptorSets.push_back(descriptor_set);
+		}
+		else {
+			m_TextureDescriptorSets[0] = descriptor_set;
+		}
+		MarkDirty(DIRTY_DESCRIPTOR_SET_BIT);
 		return true;
 	}
 
-	void RenderParameters::DestroyBuffer(BufferParameters& buffer) const
+	void RenderParameters::DestroyBuffer(BufferParameters& buffer)
 	{
 		if (buffer.handle != VK_NULL_HANDLE) {
 			vkDestroyBuffer(m_Device, buffer.handle, nullptr);
 			buffer.handle = VK_NULL_HANDLE;
 		}
 
-		if (buffer.memory != VK_NULL_HANDLE) {
-			vkFreeMemory(m_Device, buffer.memory, nullptr);
-			buffer.memory = VK_NULL_HANDLE;
-		}
+		m_MemoryAllocator.Free(buffer.memory);
 	}
 
 	bool RenderParameters::AllocateCommandBuffers(VkCommandPool pool, uint32_t count, VkCommandBuffer *command_buffers) const
@@ -1760,6 +3144,10 @@ namespace HelloEngine
 			std::cout << "Could not create command pool!" << std::endl;
 			return false;
 		}
+		if (HasDedicatedTransferQueue() && !CreateCommandPool(m_TransferQueue.familyIndex, &m_TransferCommandPool)) {
+			std::cout << "Could not create transfer command pool!" << std::endl;
+			return false;
+		}
 
 		for (size_t i = 0; i < m_RenderingResources.size(); ++i) {
 			if (!AllocateCommandBuffers(m_CommandPool, 1, &m_RenderingResources[i].commandBuffer)) {
@@ -1848,11 +3236,12 @@ namespace HelloEngine
 	{
 		if (m_Device != nullptr) {
 			vkDeviceWaitIdle(m_Device);
+			// Joins the compile threads before anything they build pipelines against goes away
+			m_PipelineRegistry.Destroy();
 
+			DestroyRecordedCommandBuffers();
+			DestroyUploadSubmits();
 			for (size_t i = 0; i < m_RenderingResources.size(); ++i) {
-				if (m_RenderingResources[i].framebuffer != VK_NULL_HANDLE) {
-					vkDestroyFramebuffer(m_Device, m_RenderingResources[i].framebuffer, nullptr);
-				}
 				if (m_RenderingResources[i].commandBuffer != nullptr) {
 					vkFreeCommandBuffers(m_Device, m_CommandPool, 1, &m_RenderingResources[i].commandBuffer);
 				}
@@ -1866,32 +3255,50 @@ namespace HelloEngine
 					vkDestroyFence(m_Device, m_RenderingResources[i].fence, nullptr);
 				}
 			}
+			if (m_GraphicsTimeline != VK_NULL_HANDLE) {
+				vkDestroySemaphore(m_Device, m_GraphicsTimeline, nullptr);
+				m_GraphicsTimeline = VK_NULL_HANDLE;
+			}
 			if (m_CommandPool != VK_NULL_HANDLE) {
 				vkDestroyCommandPool(m_Device, m_CommandPool, nullptr);
 				m_CommandPool = VK_NULL_HANDLE;
 			}
+			if (m_TransferCommandPool != VK_NULL_HANDLE) {
+				vkDestroyCommandPool(m_Device, m_TransferCommandPool, nullptr);
+				m_TransferCommandPool = VK_NULL_HANDLE;
+			}
 			DestroyBuffer(m_VertexBuffer);
-			DestroyBuffer(m_StagingBuffer);
-			if (m_GraphicsPipeline != VK_NULL_HANDLE) {
-				vkDestroyPipeline(m_Device, m_GraphicsPipeline, nullptr);
-				m_GraphicsPipeline = VK_NULL_HANDLE;
+			DestroyBuffer(m_IndexBuffer);
+			for (size_t i = 0; i < m_DynamicVertexBuffers.size(); ++i) {
+				DestroyBuffer(m_DynamicVertexBuffers[i].hostBuffer);
+				DestroyBuffer(m_DynamicVertexBuffers[i].deviceBuffer);
 			}
-			if (m_PipelineLayout != VK_NULL_HANDLE) {
-				vkDestroyPipelineLayout(m_Device, m_PipelineLayout, nullptr);
-				m_PipelineLayout = VK_NULL_HANDLE;
+			for (size_t i = 0; i < m_SpriteVertexBuffers.size(); ++i) {
+				DestroyBuffer(m_SpriteVertexBuffers[i]);
 			}
+			DestroyBuffer(m_SpriteIndexBuffer);
+			for (size_t i = 0; i < m_InstanceBuffers.size(); ++i) {
+				DestroyBuffer(m_InstanceBuffers[i]);
+			}
+			for (size_t i = 0; i < m_VisibleInstanceBuffers.size(); ++i) {
+				DestroyBuffer(m_VisibleInstanceBuffers[i]);
+			}
+			for (size_t i = 0; i < m_IndirectBuffers.size(); ++i) {
+				DestroyBuffer(m_IndirectBuffers[i]);
+			}
+			ReleaseRetiredBuffers(true);
+			DestroyBuffer(m_StagingBuffer);
+			if (m_CullPipeline != VK_NULL_HANDLE) {
+				vkDestroyPipeline(m_Device, m_CullPipeline, nullptr);
+				m_CullPipeline = VK_NULL_HANDLE;
+			}
+			// Every descriptor set comes from the allocator's pools, every layout belongs to the layout cache
+			m_DescriptorAllocator.Destroy();
+			m_LayoutCache.Destroy();
 			if (m_RenderPass != VK_NULL_HANDLE) {
 				vkDestroyRenderPass(m_Device, m_RenderPass, nullptr);
 				m_RenderPass = VK_NULL_HANDLE;
 			}
-			if (m_DescriptorSet.pool != VK_NULL_HANDLE) {
-				vkDestroyDescriptorPool(m_Device, m_DescriptorSet.pool, nullptr);
-				m_DescriptorSet.pool = VK_NULL_HANDLE;
-			}
-			if (m_DescriptorSet.layout != VK_NULL_HANDLE) {
-				vkDestroyDescriptorSetLayout(m_Device, m_DescriptorSet.layout, nullptr);
-				m_DescriptorSet.layout = VK_NULL_HANDLE;
-			}
 			DestroyBuffer(m_UniformBuffer);
 			if (m_Image.sampler != VK_NULL_HANDLE) {
 				vkDestroySampler(m_Device, m_Image.sampler, nullptr);
@@ -1905,17 +3312,19 @@ namespace HelloEngine
 				vkDestroyImage(m_Device, m_Image.handle, nullptr);
 				m_Image.handle = VK_NULL_HANDLE;
 			}
-			if (m_Image.memory != VK_NULL_HANDLE) {
-				vkFreeMemory(m_Device, m_Image.memory, nullptr);
-				m_Image.memory = VK_NULL_HANDLE;
-			}
+			m_MemoryAllocator.Free(m_Image.memory);
 			if (m_RenderPass != VK_NULL_HANDLE) {
 				vkDestroyRenderPass(m_Device, m_RenderPass, nullptr);
 				m_RenderPass = VK_NULL_HANDLE;
 			}
+			ReleaseRetiredSwapChains(true);
+			DestroySwapChainImageViews();
 			if (m_SwapChain.handle != VK_NULL_HANDLE) {
 				vkDestroySwapchainKHR(m_Device, m_SwapChain.handle, nullptr);
 			}
+			m_PipelineCache.Save();
+			m_PipelineCache.Destroy();
+			m_MemoryAllocator.Destroy();
 			vkDestroyDevice(m_Device, nullptr);
 		}
 		if (m_PresentationSurface != VK_NULL_HANDLE) {
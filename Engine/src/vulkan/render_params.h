@@ -8,7 +8,19 @@
 #include "vulkan_functions.h"
 #include "image.h"
 #include "autodeleter.h"
+#include "memory_allocator.h"
+#include "staging_ring.h"
+#include "uniform_ring.h"
+#include "vertex_stream.h"
+#include "sprite_batch.h"
+#include "render_queue.h"
+#include "render_graph.h"
+#include "pipeline_cache.h"
+#include "pipeline_registry.h"
+#include "layout_cache.h"
+#include "descriptor_allocator.h"
 #include "window_params.h"
+#include "renderer.h"
 
 #if defined(USE_PLATFORM_WIN32_KHR)
 typedef HMODULE LibraryHandle;
@@ -32,13 +44,13 @@ namespace HelloEngine
 		VkImage                       handle;
 		VkImageView                   view;
 		VkSampler                     sampler;
-		VkDeviceMemory                memory;
+		MemoryAllocation              memory;
 
 		ImageParameters() :
 			handle(VK_NULL_HANDLE),
 			view(VK_NULL_HANDLE),
 			sampler(VK_NULL_HANDLE),
-			memory(VK_NULL_HANDLE) {
+			memory() {
 		}
 	};
 
@@ -46,73 +58,241 @@ namespace HelloEngine
 		VkSwapchainKHR                handle;
 		VkFormat                      format;
 		std::vector<ImageParameters>  images;
+		std::vector<VkFramebuffer>    framebuffers;
 		VkExtent2D                    extent;
 
 		SwapChainParameters() :
 			handle(VK_NULL_HANDLE),
 			format(VK_FORMAT_UNDEFINED),
 			images(),
+			framebuffers(),
 			extent() {
 		}
 	};
 
 	struct BufferParameters {
 		VkBuffer                      handle;
-		VkDeviceMemory                memory;
+		MemoryAllocation              memory;
 		uint32_t                      size;
 
 		BufferParameters() :
 			handle(VK_NULL_HANDLE),
-			memory(VK_NULL_HANDLE),
+			memory(),
 			size(0) {
 		}
 	};
 
-	struct VertexData {
-		float x, y, z, w;
-		float u, v;
+	// Per-frame copy of streamed vertex data; the device-local buffer is only
+	// created where vertex fetch from host-visible memory is slow
+	struct DynamicVertexBufferData {
+		BufferParameters                      hostBuffer;
+		BufferParameters                      deviceBuffer;
+
+		DynamicVertexBufferData() :
+			hostBuffer(),
+			deviceBuffer() {
+		}
+	};
+
+	struct RetiredBufferData {
+		BufferParameters                      buffer;
+		uint64_t                              submitIndex;
+
+		RetiredBufferData() :
+			buffer(),
+			submitIndex(0) {
+		}
 	};
 
 	struct DescriptorSetParameters {
-		VkDescriptorPool                pool;
 		VkDescriptorSetLayout           layout;
 		VkDescriptorSet                 handle;
 
 		DescriptorSetParameters() :
-			pool(VK_NULL_HANDLE),
 			layout(VK_NULL_HANDLE),
 			handle(VK_NULL_HANDLE) {
 		}
 	};
 
 	struct RenderingResourcesData {
-		VkFramebuffer                         framebuffer;
 		VkCommandBuffer                       commandBuffer;
 		VkSemaphore                           imageAvailableSemaphore;
 		VkSemaphore                           finishedRenderingSemaphore;
 		VkFence                               fence;
+		uint64_t                              submitIndex;
 
 		RenderingResourcesData() :
-			framebuffer(VK_NULL_HANDLE),
 			commandBuffer(nullptr),
 			imageAvailableSemaphore(VK_NULL_HANDLE),
 			finishedRenderingSemaphore(VK_NULL_HANDLE),
-			fence(VK_NULL_HANDLE) {
+			fence(VK_NULL_HANDLE),
+			submitIndex(0) {
 		}
 	};	
 
+	struct RetiredSwapChainData {
+		VkSwapchainKHR                        handle;
+		std::vector<VkImageView>              views;
+		std::vector<VkFramebuffer>            framebuffers;
+		uint64_t                              submitIndex;
+
+		RetiredSwapChainData() :
+			handle(VK_NULL_HANDLE),
+			views(),
+			framebuffers(),
+			submitIndex(0) {
+		}
+	};
+
+	struct RecordedCommandBufferData {
+		VkCommandBuffer                       handle;
+		uint64_t                              submitIndex;
+		bool                                  dirty;
+
+		RecordedCommandBufferData() :
+			handle(nullptr),
+			submitIndex(0),
+			dirty(true) {
+		}
+	};
+
+	// Size of one dynamic uniform block and the number of blocks every frame may use
+	static const uint32_t UNIFORM_BLOCK_SIZE = 256;
+	static const uint32_t UNIFORM_BLOCKS_PER_FRAME = 256;
+
+	// Smallest capacity of the per-frame copies of streamed vertex data
+	static const VkDeviceSize MIN_DYNAMIC_VERTEX_BUFFER_SIZE = 65536;
+
+	// Smallest number of sprites the per-frame sprite buffers are created for
+	static const uint32_t MIN_SPRITE_CAPACITY = 1024;
+
+	// Instances culled by one compute workgroup, matching local_size_x of cull_instances.comp
+	static const uint32_t CULL_WORKGROUP_SIZE = 64;
+
+	// Submit indices of the transfer queue are tagged so they never compare equal to graphics ones
+	static const uint64_t TRANSFER_SUBMIT_BIT = 0x8000000000000000ULL;
+
+	// Pipeline cache kept between runs, relative to the working directory like the shaders
+	static const char PIPELINE_CACHE_FILENAME[] = "pipeline_cache.bin";
+
+	// Specialization constant IDs declared by instanced.frag
+	static const uint32_t INSTANCED_TINT_CONSTANT_ID = 0;
+	static const uint32_t INSTANCED_ALPHA_TEST_CONSTANT_ID = 1;
+
+	// Shader stages reading DrawConstants, the push constant block declared by instanced.frag
+	static const VkShaderStageFlags DRAW_CONSTANT_STAGES = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	// Vertex inputs of instanced.vert from this location on are read per instance
+	static const uint32_t INSTANCE_FIRST_LOCATION = 2;
+
+	// Threads compiling pipelines requested after startup in the background
+	static const uint32_t PIPELINE_COMPILE_THREADS = 2;
+
+	struct UploadSubmitData {
+		VkCommandBuffer                       commandBuffer;
+		VkFence                               fence;
+		uint64_t                              submitIndex;
+		VkCommandBuffer                       transferCommandBuffer;
+		VkFence                               transferFence;
+		VkSemaphore                           handOffSemaphore;
+		VkPipelineStageFlags                  handOffStageMask;
+		uint64_t                              transferSubmitIndex;
+		bool                                  handOffPending;
+
+		UploadSubmitData() :
+			commandBuffer(nullptr),
+			fence(VK_NULL_HANDLE),
+			submitIndex(0),
+			transferCommandBuffer(nullptr),
+			transferFence(VK_NULL_HANDLE),
+			handOffSemaphore(VK_NULL_HANDLE),
+			handOffStageMask(0),
+			transferSubmitIndex(0),
+			handOffPending(false) {
+		}
+	};
+
+	struct BufferUploadData {
+		VkBuffer                              buffer;
+		std::vector<VkBufferCopy>             regions;
+		VkAccessFlags                         dstAccessMask;
+		VkPipelineStageFlags                  dstStageMask;
+		bool                                  complete;
+
+		BufferUploadData() :
+			buffer(VK_NULL_HANDLE),
+			regions(),
+			dstAccessMask(0),
+			dstStageMask(0),
+			complete(false) {
+		}
+	};
+
+	struct ImageUploadData {
+		VkImage                               image;
+		std::vector<VkBufferImageCopy>        regions;
+		VkAccessFlags                         dstAccessMask;
+		VkPipelineStageFlags                  dstStageMask;
+		VkImageLayout                         finalLayout;
+		bool                                  transitioned;
+		bool                                  complete;
+
+		ImageUploadData() :
+			image(VK_NULL_HANDLE),
+			regions(),
+			dstAccessMask(0),
+			dstStageMask(0),
+			finalLayout(VK_IMAGE_LAYOUT_UNDEFINED),
+			transitioned(false),
+			complete(false) {
+		}
+	};
+
+	// Pipeline part of render queue sort keys, in the order pipelines are drawn within a layer:
+	// the mesh, its instances, then sprites over both
+	enum QueuePipeline {
+		QUEUE_PIPELINE_STRIP                   = 0,
+		QUEUE_PIPELINE_TRIANGLE_LIST           = 1,
+		QUEUE_PIPELINE_INSTANCED               = 2,
+		QUEUE_PIPELINE_INSTANCED_TRIANGLE_LIST = 3,
+		QUEUE_PIPELINE_SPRITE                  = 4
+	};
+
+	enum DirtyFlagBits {
+		DIRTY_SCENE_BIT          = 0x00000001,
+		DIRTY_VERTEX_BUFFER_BIT  = 0x00000002,
+		DIRTY_DESCRIPTOR_SET_BIT = 0x00000004,
+		DIRTY_EXTENT_BIT         = 0x00000008
+	};
+
 	class RenderParameters {
 	public:
 		RenderParameters();
 		~RenderParameters();		
-		bool								Initialize(WindowParameters *parameters, const std::vector<float>& vertex_data, Color color);
+		bool								Initialize(WindowParameters *parameters, const std::vector<float>& vertex_data, const std::vector<uint32_t>& index_data, Color color, uint32_t frames_in_flight);
 		bool								Draw();	
 		bool								OnWindowSizeChanged();
 		bool								ReadyToDraw() const;
+		RendererStatistics					GetStatistics() const;
+		MemoryStatistics					GetMemoryStatistics() const;
+		void								SetCommandBufferMode(CommandBufferMode mode);
+		void								MarkDirty(uint32_t dirty_flags);
+		bool								SetPresentMode(PresentMode mode);
+		PresentMode							GetPresentMode() const;
+		bool								UpdateVertexData(const std::vector<float>& vertex_data, uint32_t offset);
+		bool								AppendVertexData(const std::vector<float>& vertex_data);
+		bool								SetVertexData(const std::vector<float>& vertex_data);
+		bool								DrawSprites(const std::vector<Sprite>& sprites);
+		void								SetSpriteCullSettings(const CullSettings& settings);
+		bool								SetSpriteLayerTint(uint32_t layer, Color tint);
+		CullRect							GetViewRect() const;
+		bool								DrawInstances(const std::vector<Instance>& instances);
+		bool								SetGpuCulling(bool enabled);
+		void								SetSpriteBlending(bool enabled);
+		void								SetInstanceFeatures(uint32_t features);
 	private:
 		Color								m_ClearColor;
 		bool								m_CanRender;
-		static const size_t					RESOURCE_COUNT = 3;
 		VkInstance							m_Instance;
 		VkPhysicalDevice					m_PhysicalDevice;
 		VkDevice							m_Device;
@@ -120,19 +300,82 @@ namespace HelloEngine
 		VkCommandPool						m_PresentQueueCmdPool;
 		VkRenderPass						m_RenderPass;
 		VkPipeline							m_GraphicsPipeline;
+		VkPipeline							m_TriangleListPipeline;
+		VkPipeline							m_InstancedPipeline;
+		VkPipeline							m_InstancedTriangleListPipeline;
 		VkCommandPool						m_CommandPool;
+		VkCommandPool						m_TransferCommandPool;
 		WindowParameters				   *m_Window;
 		QueueParameters						m_GraphicsQueue;
 		QueueParameters						m_PresentQueue;
+		QueueParameters						m_TransferQueue;
+		VkExtent3D							m_TransferImageGranularity;
+		uint64_t							m_TransferSubmitCount;
 		SwapChainParameters					m_SwapChain;
 		BufferParameters					m_VertexBuffer;
+		BufferParameters					m_IndexBuffer;
+		VkIndexType							m_IndexType;
+		uint32_t							m_IndexCount;
+		uint32_t							m_IndexedVertexCount;
+		VertexStream						m_VertexStream;
+		std::vector<DynamicVertexBufferData> m_DynamicVertexBuffers;
+		VkDeviceSize						m_DynamicVertexCapacity;
+		std::vector<RetiredBufferData>		m_RetiredBuffers;
+		SpriteBatch							m_SpriteBatch;
+		std::vector<SpriteDrawData>			m_SpriteDraws;
+		RenderQueue							m_RenderQueue;
+		RenderGraph							m_RenderGraph;
+		PipelineCache						m_PipelineCache;
+		PipelineRegistry					m_PipelineRegistry;
+		LayoutCache							m_LayoutCache;
+		ReflectedLayout						m_MeshLayout;
+		DescriptorAllocator					m_DescriptorAllocator;
+		uint32_t							m_SpritePipeline;
+		uint32_t							m_BlendedSpritePipeline;
+		bool								m_SpriteBlending;
+		PipelinePermutations				m_InstancedPermutations[2];
+		uint32_t							m_InstanceFeatures;
+		std::vector<BufferParameters>		m_SpriteVertexBuffers;
+		BufferParameters					m_SpriteIndexBuffer;
+		uint32_t							m_SpriteCapacity;
+		CullSettings						m_SpriteCullSettings;
+		std::vector<Color>					m_SpriteLayerTints;
+		std::vector<Instance>				m_Instances;
+		std::vector<BufferParameters>		m_InstanceBuffers;
+		uint32_t							m_InstanceCount;
+		float								m_MeshRadius;
+		bool								m_GpuCulling;
+		std::vector<BufferParameters>		m_VisibleInstanceBuffers;
+		std::vector<BufferParameters>		m_IndirectBuffers;
+		VkDescriptorSetLayout				m_CullDescriptorSetLayout;
+		VkPipelineLayout					m_CullPipelineLayout;
+		VkPipeline							m_CullPipeline;
 		BufferParameters                    m_StagingBuffer;
+		StagingRing                         m_StagingRing;
+		std::vector<BufferUploadData>       m_BufferUploads;
+		std::vector<ImageUploadData>        m_ImageUploads;
+		std::vector<UploadSubmitData>       m_UploadSubmits;
 		BufferParameters                    m_UniformBuffer;
+		UniformRing                         m_UniformRing;
 		ImageParameters                     m_Image;
 		DescriptorSetParameters             m_DescriptorSet;
+		std::vector<VkDescriptorSet>        m_TextureDescriptorSets;
 		VkPipelineLayout                    m_PipelineLayout;
 		std::vector<RenderingResourcesData> m_RenderingResources;
+		size_t								m_ResourceIndex;
+		uint32_t							m_FrameIndex;
+		uint64_t							m_SubmitCount;
+		VkSemaphore							m_GraphicsTimeline;
+		std::vector<const char*>			m_InstanceExtensions;
+		std::vector<const char*>			m_DeviceExtensions;
+		std::vector<RetiredSwapChainData>	m_RetiredSwapChains;
+		CommandBufferMode					m_CommandBufferMode;
+		PresentMode							m_RequestedPresentMode;
+		VkPresentModeKHR					m_PresentMode;
+		std::vector<RecordedCommandBufferData> m_RecordedCommandBuffers;
 		LibraryHandle						m_VulkanLibrary;
+		MemoryAllocator						m_MemoryAllocator;
+		RendererStatistics					m_Statistics;
 
 		bool CreateInstance();
 		bool CreatePresentationSurface();
@@ -145,16 +388,60 @@ namespace HelloEngine
 		bool CreateSemaphores();
 		bool CreateRenderPass();
 		bool CreateSwapChainImageViews();
-		bool CreateFramebuffer(VkFramebuffer &framebuffer, VkImageView image_view) const;
+		bool CreateFramebuffers();
+		bool CreateFramebuffer(VkFramebuffer &framebuffer, VkImageView image_view);
+		void DestroySwapChainImageViews();
+		void RetireSwapChain(VkSwapchainKHR swap_chain);
+		void ReleaseRetiredSwapChains(bool force);
+		bool IsSubmitCompleted(uint64_t submit_index) const;
+		bool WaitForSubmit(uint64_t submit_index) const;
+		void GetSubmitFences(uint64_t submit_index, std::vector<VkFence> &fences) const;
+		void ReclaimStagingMemory();
+		bool AcquireStagingMemory(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset);
+		bool EnqueueBufferUpload(const void *data, VkDeviceSize size, VkBuffer buffer, VkAccessFlags dst_access, VkPipelineStageFlags dst_stage);
+		bool EnqueueImageUpload(const Image &image, VkImage handle);
+		bool SubmitUploads(uint64_t &token);
+		bool SubmitHandOffs(bool force);
+		bool HasDedicatedTransferQueue() const;
+		bool AcquireUploadSubmit(size_t &index);
+		void DestroyUploadSubmit(UploadSubmitData &upload);
+		void DestroyUploadSubmits();
+		bool CheckTimelineSemaphoreSupport(VkPhysicalDevice physical_device) const;
+		bool CreateTimelineSemaphore();
+		uint32_t AddUniformUpdatePass(uint32_t offset);
+		bool AllocateUniformData(const void *data, size_t size, uint32_t &dynamic_offset);
 		bool CreatePipeline();
+		uint32_t RequestSpritePipeline(const GraphicsPipelineDesc &mesh_desc);
+		bool RequestInstancedPipelines(const GraphicsPipelineDesc &mesh_desc, uint32_t *pipelines);
 		bool CopyVertexData(const std::vector<float>& vertex_data);
 		bool CreateVertexBuffer(const std::vector<float>& vertex_data);
+		bool CreateIndexBuffer(const std::vector<uint32_t>& index_data);
+		void QueueMeshDraws(VkBuffer vertex_buffer);
+		void RecordQueuedDraws(VkCommandBuffer command_buffer, uint32_t uniform_offset);
+		bool ReserveDynamicVertexBuffers(VkDeviceSize size);
+		VkBuffer AddVertexStreamPass(uint32_t &resource);
+		uint32_t GetVertexCount() const;
+		void RetireBuffer(BufferParameters &buffer);
+		void ReleaseRetiredBuffers(bool force);
+		bool ReservePerFrameBuffers(std::vector<BufferParameters> &buffers, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlagBits memory_property);
+		void UpdateMeshRadius(size_t offset, size_t count, bool reset);
+		bool CreateCullingResources();
+		bool CreateComputePipeline(const char *filename, VkPipelineLayout layout, VkPipeline &pipeline) const;
+		bool AddInstanceCullingPasses(uint32_t &visible_resource, uint32_t &indirect_resource);
+		bool ReserveSpriteBuffers(uint32_t sprite_count);
+		bool BuildInstanceData();
+		bool UsesPerFrameGeometry() const;
+		bool BuildSpriteBatch();
+		void QueueSpriteDraws();
 		bool CreateFences();	
 		bool CreateStagingBuffer();
+		bool ReflectShader(const char *filename, ShaderReflection &reflection) const;
 		bool CreateDescriptorSetLayout();
 		bool CreateBuffer(VkBufferUsageFlags usage, VkMemoryPropertyFlagBits memoryProperty, BufferParameters &buffer);
-		bool PrepareFrame(VkCommandBuffer command_buffer, const ImageParameters &image_parameters, VkFramebuffer &framebuffer) const;
-		bool AllocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlagBits property, VkDeviceMemory *memory) const;
+		bool PrepareFrame(VkCommandBuffer command_buffer, const ImageParameters &image_parameters, VkFramebuffer framebuffer, VkCommandBufferUsageFlags usage);
+		bool GetRecordedCommandBuffer(uint32_t image_index, VkCommandBuffer &command_buffer);
+		void DestroyRecordedCommandBuffers();
+		bool AllocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlagBits property, MemoryAllocation *memory);
 		bool CreateCommandPool(uint32_t queue_family_index, VkCommandPool *pool) const;
 		bool AllocateCommandBuffers(VkCommandPool pool, uint32_t count, VkCommandBuffer *command_buffers) const;
 		bool LoadVulkanLibrary();
@@ -163,27 +450,26 @@ namespace HelloEngine
 		bool LoadInstanceLevelEntryPoints() const;
 		bool LoadDeviceLevelEntryPoints() const;	
 		bool CreateTexture();
-		bool CreateDescriptorPool();
 		bool CreateImage(uint32_t width, uint32_t height, VkImage *image) const;
-		bool AllocateDescriptorSet();
-		bool AllocateImageMemory(VkMemoryPropertyFlagBits property, VkDeviceMemory *memory);
+		bool AllocateImageMemory(VkImage image, VkMemoryPropertyFlagBits property, MemoryAllocation *memory);
 		bool CreateUniformBuffer();
 		bool CreateImageView(ImageParameters &image_parameters);
 		bool CreateSampler(VkSampler *sampler);
 		bool CreatePipelineLayout();
 		bool CopyTextureData(const Image &image);
-		bool CopyUniformBufferData();
 		bool UpdateDescriptorSet();
 		const std::array<float, 16> GetUniformBufferData() const;
-		void DestroyBuffer(BufferParameters& buffer) const;
+		void DestroyBuffer(BufferParameters& buffer);
 
 		static bool                          CheckExtensionAvailability(const char *extension_name, const std::vector<VkExtensionProperties> &available_extensions);
+		static bool                          IsExtensionEnabled(const char *extension_name, const std::vector<const char*> &enabled_extensions);
+		static uint32_t                      GetTransferQueueFamilyIndex(VkPhysicalDevice physical_device, uint32_t graphics_queue_family_index, VkExtent3D &image_granularity);
 		static uint32_t                      GetSwapChainNumImages(VkSurfaceCapabilitiesKHR &surface_capabilities);
 		static VkSurfaceFormatKHR            GetSwapChainFormat(std::vector<VkSurfaceFormatKHR> &surface_formats);
 		static VkExtent2D                    GetSwapChainExtent(VkSurfaceCapabilitiesKHR &surface_capabilities);
 		static VkImageUsageFlags             GetSwapChainUsageFlags(VkSurfaceCapabilitiesKHR &surface_capabilities);
 		static VkSurfaceTransformFlagBitsKHR GetSwapChainTransform(VkSurfaceCapabilitiesKHR &surface_capabilities);
-		static VkPresentModeKHR              GetSwapChainPresentMode(std::vector<VkPresentModeKHR> &present_modes);
+		static VkPresentModeKHR              GetSwapChainPresentMode(std::vector<VkPresentModeKHR> &present_modes, PresentMode requested_mode);
 	
 		AutoDeleter<VkPipelineLayout, PFN_vkDestroyPipelineLayout>  CreatePipelineLayout() const;
 		AutoDeleter<VkShaderModule, PFN_vkDestroyShaderModule>		CreateShaderModule(const char* filename) const;
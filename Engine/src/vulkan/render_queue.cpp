@@ -0,0 +1,86 @@
+#ifdef USE_RENDER_VULKAN
+#include "render_queue.h"
+
+namespace HelloEngine
+{
+	void RadixSort(std::vector<SortEntry> &entries, std::vector<SortEntry> &scratch)
+	{
+		static const uint32_t PASS_COUNT = sizeof(uint64_t);
+		size_t count = entries.size();
+		if (count < 2) {
+			return;
+		}
+
+		// All histograms are gathered in one read of the keys
+		size_t histograms[PASS_COUNT][256] = {};
+		for (size_t i = 0; i < count; ++i) {
+			uint64_t key = entries[i].key;
+			for (uint32_t pass = 0; pass < PASS_COUNT; ++pass) {
+				++histograms[pass][(key >> (8 * pass)) & 0xFF];
+			}
+		}
+
+		scratch.resize(count);
+		for (uint32_t pass = 0; pass < PASS_COUNT; ++pass) {
+			size_t *histogram = histograms[pass];
+			uint32_t shift = 8 * pass;
+			if (histogram[(entries[0].key >> shift) & 0xFF] == count) {
+				continue;
+			}
+			size_t offset = 0;
+			for (uint32_t digit = 0; digit < 256; ++digit) {
+				size_t digit_count = histogram[digit];
+				histogram[digit] = offset;
+				offset += digit_count;
+			}
+			for (size_t i = 0; i < count; ++i) {
+				scratch[histogram[(entries[i].key >> shift) & 0xFF]++] = entries[i];
+			}
+			entries.swap(scratch);
+		}
+	}
+
+	RenderQueue::RenderQueue() :
+		m_Draws(),
+		m_Entries(),
+		m_Scratch()
+	{
+	}
+
+	uint64_t RenderQueue::MakeKey(uint32_t layer, uint32_t pipeline, uint32_t texture, uint32_t depth)
+	{
+		return (static_cast<uint64_t>(layer & MAX_LAYER) << 56) |
+			(static_cast<uint64_t>(pipeline & MAX_PIPELINE) << 48) |
+			(static_cast<uint64_t>(texture & MAX_TEXTURE) << 32) |
+			depth;
+	}
+
+	void RenderQueue::Clear()
+	{
+		m_Draws.clear();
+		m_Entries.clear();
+	}
+
+	void RenderQueue::Add(uint64_t key, const QueuedDraw &draw)
+	{
+		SortEntry entry = { key, static_cast<uint32_t>(m_Draws.size()) };
+		m_Entries.push_back(entry);
+		m_Draws.push_back(draw);
+	}
+
+	void RenderQueue::Sort()
+	{
+		RadixSort(m_Entries, m_Scratch);
+	}
+
+	size_t RenderQueue::GetCount() const
+	{
+		return m_Entries.size();
+	}
+
+	const QueuedDraw& RenderQueue::Get(size_t index) const
+	{
+		return m_Draws[m_Entries[index].value];
+	}
+}
+#endif
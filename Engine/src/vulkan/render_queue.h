@@ -0,0 +1,67 @@
+#ifdef USE_RENDER_VULKAN
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+#pragma once
+#include <vector>
+#include "color.h"
+#include "vulkan_functions.h"
+
+namespace HelloEngine
+{
+	struct SortEntry {
+		uint64_t                              key;
+		uint32_t                              value;
+	};
+
+	// Stable LSD radix sort over the eight key bytes; bytes equal in every key are skipped
+	void RadixSort(std::vector<SortEntry> &entries, std::vector<SortEntry> &scratch);
+
+	// Small per draw data handed to the shaders as push constants
+	struct DrawConstants {
+		Color                                 tint;
+	};
+
+	// Everything a queued draw binds, plus its draw parameters. Draws without an
+	// index buffer are non-indexed, an indirect buffer replaces the counts.
+	struct QueuedDraw {
+		VkPipeline                            pipeline;
+		VkDescriptorSet                       descriptorSet;
+		VkBuffer                              vertexBuffer;
+		VkBuffer                              instanceBuffer;
+		VkBuffer                              indexBuffer;
+		VkIndexType                           indexType;
+		VkBuffer                              indirectBuffer;
+		uint32_t                              count;
+		uint32_t                              instanceCount;
+		uint32_t                              first;
+		DrawConstants                         constants;
+	};
+
+	// Collects the draws of a frame and orders them by a 64-bit key, so draws
+	// sharing a pipeline and texture end up next to each other
+	class RenderQueue {
+	public:
+		RenderQueue();
+
+		static const uint32_t	MAX_LAYER = 0xFF;
+		static const uint32_t	MAX_PIPELINE = 0xFF;
+		static const uint32_t	MAX_TEXTURE = 0xFFFF;
+
+		// Layer is the most significant part, then pipeline, texture and depth.
+		// Each part has to fit its MAX_ value, callers validate what they pass in
+		static uint64_t			MakeKey(uint32_t layer, uint32_t pipeline, uint32_t texture, uint32_t depth);
+
+		void					Clear();
+		void					Add(uint64_t key, const QueuedDraw &draw);
+		void					Sort();
+		size_t					GetCount() const;
+		// Draws in key order after Sort()
+		const QueuedDraw&		Get(size_t index) const;
+	private:
+		std::vector<QueuedDraw>	m_Draws;
+		std::vector<SortEntry>	m_Entries;
+		std::vector<SortEntry>	m_Scratch;
+	};
+}
+#endif
+#endif
@@ -0,0 +1,453 @@
+#ifdef USE_RENDER_VULKAN
+#include "shader_reflection.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace HelloEngine
+{
+	static const uint32_t SPIRV_MAGIC = 0x07230203;
+	static const uint32_t SPIRV_HEADER_WORDS = 5;
+
+	// The handful of opcodes, decorations, storage classes and execution models the layouts depend on
+	enum SpirvOp {
+		SPIRV_OP_ENTRY_POINT         = 15,
+		SPIRV_OP_TYPE_BOOL           = 20,
+		SPIRV_OP_TYPE_INT            = 21,
+		SPIRV_OP_TYPE_FLOAT          = 22,
+		SPIRV_OP_TYPE_VECTOR         = 23,
+		SPIRV_OP_TYPE_MATRIX         = 24,
+		SPIRV_OP_TYPE_IMAGE          = 25,
+		SPIRV_OP_TYPE_SAMPLER        = 26,
+		SPIRV_OP_TYPE_SAMPLED_IMAGE  = 27,
+		SPIRV_OP_TYPE_ARRAY          = 28,
+		SPIRV_OP_TYPE_RUNTIME_ARRAY  = 29,
+		SPIRV_OP_TYPE_STRUCT         = 30,
+		SPIRV_OP_TYPE_POINTER        = 32,
+		SPIRV_OP_CONSTANT            = 43,
+		SPIRV_OP_VARIABLE            = 59,
+		SPIRV_OP_DECORATE            = 71,
+		SPIRV_OP_MEMBER_DECORATE     = 72
+	};
+
+	enum SpirvDecoration {
+		SPIRV_DECORATION_BLOCK         = 2,
+		SPIRV_DECORATION_BUFFER_BLOCK  = 3,
+		SPIRV_DECORATION_ARRAY_STRIDE  = 6,
+		SPIRV_DECORATION_MATRIX_STRIDE = 7,
+		SPIRV_DECORATION_BUILT_IN      = 11,
+		SPIRV_DECORATION_LOCATION      = 30,
+		SPIRV_DECORATION_BINDING       = 33,
+		SPIRV_DECORATION_DESCRIPTOR_SET = 34,
+		SPIRV_DECORATION_OFFSET        = 35
+	};
+
+	enum SpirvStorageClass {
+		SPIRV_STORAGE_UNIFORM_CONSTANT = 0,
+		SPIRV_STORAGE_INPUT            = 1,
+		SPIRV_STORAGE_UNIFORM          = 2,
+		SPIRV_STORAGE_PUSH_CONSTANT    = 9,
+		SPIRV_STORAGE_STORAGE_BUFFER   = 12
+	};
+
+	enum SpirvExecutionModel {
+		SPIRV_EXECUTION_VERTEX    = 0,
+		SPIRV_EXECUTION_FRAGMENT  = 4,
+		SPIRV_EXECUTION_GLCOMPUTE = 5
+	};
+
+	static const uint32_t SPIRV_DIM_BUFFER = 5;
+	static const uint32_t SPIRV_DIM_SUBPASS_DATA = 6;
+
+	ShaderReflection::ShaderReflection() :
+		m_Name(""),
+		m_Stage(VK_SHADER_STAGE_VERTEX_BIT),
+		m_Bindings(),
+		m_PushConstantSize(0),
+		m_VertexInputs(),
+		m_Types(),
+		m_Constants(),
+		m_Decorations()
+	{
+	}
+
+	bool ShaderReflection::Parse(const std::vector<char> &code, const char *name)
+	{
+		m_Name = name;
+		m_Bindings.clear();
+		m_PushConstantSize = 0;
+		m_VertexInputs.clear();
+		m_Types.clear();
+		m_Constants.clear();
+		m_Decorations.clear();
+
+		size_t word_count = code.size() / sizeof(uint32_t);
+		std::vector<uint32_t> words(word_count);
+		if (word_count != 0) {
+			memcpy(&words[0], &code[0], word_count * sizeof(uint32_t));
+		}
+		if ((word_count < SPIRV_HEADER_WORDS) || (words[0] != SPIRV_MAGIC)) {
+			std::cout << "\"" << m_Name << "\" is not a SPIR-V module!" << std::endl;
+			return false;
+		}
+
+		// Types and decorations come before any variable, so variables are resolved in a second pass
+		struct Variable {
+			uint32_t id;
+			uint32_t pointerType;
+			uint32_t storageClass;
+		};
+		std::vector<Variable> variables;
+		bool has_entry_point = false;
+
+		size_t position = SPIRV_HEADER_WORDS;
+		while (position < word_count) {
+			uint32_t opcode = words[position] & 0xFFFF;
+			uint32_t length = words[position] >> 16;
+			if ((length == 0) || (position + length > word_count)) {
+				std::cout << "\"" << m_Name << "\" is a truncated SPIR-V module!" << std::endl;
+				return false;
+			}
+			const uint32_t *operands = &words[position + 1];
+			uint32_t operand_count = length - 1;
+
+			switch (opcode) {
+			case SPIRV_OP_ENTRY_POINT:
+				if (!has_entry_point) {
+					has_entry_point = true;
+					switch (operands[0]) {
+					case SPIRV_EXECUTION_VERTEX:
+						m_Stage = VK_SHADER_STAGE_VERTEX_BIT;
+						break;
+					case SPIRV_EXECUTION_FRAGMENT:
+						m_Stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+						break;
+					case SPIRV_EXECUTION_GLCOMPUTE:
+						m_Stage = VK_SHADER_STAGE_COMPUTE_BIT;
+						break;
+					default:
+						std::cout << "\"" << m_Name << "\" has an unsupported execution model!" << std::endl;
+						return false;
+					}
+				}
+				break;
+			case SPIRV_OP_TYPE_BOOL:
+			case SPIRV_OP_TYPE_INT:
+			case SPIRV_OP_TYPE_FLOAT:
+			case SPIRV_OP_TYPE_VECTOR:
+			case SPIRV_OP_TYPE_MATRIX:
+			case SPIRV_OP_TYPE_IMAGE:
+			case SPIRV_OP_TYPE_SAMPLER:
+			case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+			case SPIRV_OP_TYPE_ARRAY:
+			case SPIRV_OP_TYPE_RUNTIME_ARRAY:
+			case SPIRV_OP_TYPE_STRUCT:
+			case SPIRV_OP_TYPE_POINTER:
+				if (operand_count >= 1) {
+					TypeInfo &type = m_Types[operands[0]];
+					type.opcode = opcode;
+					type.operands.assign(operands + 1, operands + operand_count);
+				}
+				break;
+			case SPIRV_OP_CONSTANT:
+				// Array lengths are 32 bit integer constants
+				if (operand_count >= 3) {
+					m_Constants[operands[1]] = operands[2];
+				}
+				break;
+			case SPIRV_OP_VARIABLE:
+				if (operand_count >= 3) {
+					Variable variable = { operands[1], operands[0], operands[2] };
+					variables.push_back(variable);
+				}
+				break;
+			case SPIRV_OP_DECORATE:
+				if (operand_count >= 2) {
+					Decorations &decorations = m_Decorations[operands[0]];
+					uint32_t value = (operand_count >= 3) ? operands[2] : 0;
+					switch (operands[1]) {
+					case SPIRV_DECORATION_BLOCK:          decorations.block = true; break;
+					case SPIRV_DECORATION_BUFFER_BLOCK:   decorations.bufferBlock = true; break;
+					case SPIRV_DECORATION_ARRAY_STRIDE:   decorations.arrayStride = value; break;
+					case SPIRV_DECORATION_BUILT_IN:       decorations.builtIn = true; break;
+					case SPIRV_DECORATION_LOCATION:       decorations.location = value; break;
+					case SPIRV_DECORATION_BINDING:        decorations.binding = value; break;
+					case SPIRV_DECORATION_DESCRIPTOR_SET: decorations.set = value; break;
+					}
+				}
+				break;
+			case SPIRV_OP_MEMBER_DECORATE:
+				if (operand_count >= 4) {
+					Decorations &decorations = m_Decorations[operands[0]];
+					uint32_t member = operands[1];
+					if (operands[2] == SPIRV_DECORATION_OFFSET) {
+						decorations.memberOffsets.resize(std::max<size_t>(decorations.memberOffsets.size(), member + 1), 0);
+						decorations.memberOffsets[member] = operands[3];
+					}
+					else if (operands[2] == SPIRV_DECORATION_MATRIX_STRIDE) {
+						decorations.memberMatrixStrides.resize(std::max<size_t>(decorations.memberMatrixStrides.size(), member + 1), 0);
+						decorations.memberMatrixStrides[member] = operands[3];
+					}
+				}
+				else if ((operand_count >= 3) && (operands[2] == SPIRV_DECORATION_BUILT_IN)) {
+					m_Decorations[operands[0]].builtIn = true;
+				}
+				break;
+			}
+			position += length;
+		}
+		if (!has_entry_point) {
+			std::cout << "\"" << m_Name << "\" has no entry point!" << std::endl;
+			return false;
+		}
+
+		for (size_t i = 0; i < variables.size(); ++i) {
+			if (!AddVariable(variables[i].id, variables[i].pointerType, variables[i].storageClass)) {
+				return false;
+			}
+		}
+		std::sort(m_VertexInputs.begin(), m_VertexInputs.end(), [](const ReflectedVertexInput &left, const ReflectedVertexInput &right) {
+			return left.location < right.location;
+		});
+		return true;
+	}
+
+	bool ShaderReflection::AddVariable(uint32_t id, uint32_t pointer_type, uint32_t storage_class)
+	{
+		const TypeInfo *pointer = GetType(pointer_type);
+		if ((pointer == nullptr) || (pointer->opcode != SPIRV_OP_TYPE_POINTER) || (pointer->operands.size() < 2)) {
+			return true;
+		}
+		uint32_t type_id = pointer->operands[1];
+		const Decorations &decorations = m_Decorations[id];
+
+		switch (storage_class) {
+		case SPIRV_STORAGE_UNIFORM_CONSTANT:
+		case SPIRV_STORAGE_UNIFORM:
+		case SPIRV_STORAGE_STORAGE_BUFFER: {
+			ReflectedBinding reflected = {};
+			reflected.set = decorations.set;
+			reflected.binding.binding = decorations.binding;
+			reflected.binding.stageFlags = m_Stage;
+			if (!GetDescriptorType(type_id, storage_class, reflected.binding.descriptorType, reflected.binding.descriptorCount)) {
+				std::cout << "\"" << m_Name << "\" uses an unsupported resource at set " << decorations.set << " binding " << decorations.binding << "!" << std::endl;
+				return false;
+			}
+			m_Bindings.push_back(reflected);
+			return true;
+		}
+		case SPIRV_STORAGE_PUSH_CONSTANT:
+			m_PushConstantSize = std::max(m_PushConstantSize, GetTypeSize(type_id, 0));
+			return true;
+		case SPIRV_STORAGE_INPUT:
+			if ((m_Stage != VK_SHADER_STAGE_VERTEX_BIT) || decorations.builtIn || m_Decorations[type_id].builtIn) {
+				return true;
+			}
+			if (decorations.location == UINT32_MAX) {
+				std::cout << "\"" << m_Name << "\" has a vertex input without a location!" << std::endl;
+				return false;
+			}
+			ReflectedVertexInput input;
+			input.location = decorations.location;
+			if (!GetVertexFormat(type_id, input.format, input.size)) {
+				std::cout << "\"" << m_Name << "\" has an unsupported vertex input at location " << input.location << "!" << std::endl;
+				return false;
+			}
+			m_VertexInputs.push_back(input);
+			return true;
+		}
+		return true;
+	}
+
+	bool ShaderReflection::GetDescriptorType(uint32_t type_id, uint32_t storage_class, VkDescriptorType &descriptor_type, uint32_t &count) const
+	{
+		count = 1;
+		const TypeInfo *type = GetType(type_id);
+		while ((type != nullptr) && ((type->opcode == SPIRV_OP_TYPE_ARRAY) || (type->opcode == SPIRV_OP_TYPE_RUNTIME_ARRAY))) {
+			if (type->opcode == SPIRV_OP_TYPE_ARRAY) {
+				std::map<uint32_t, uint32_t>::const_iterator length = m_Constants.find(type->operands[1]);
+				if (length == m_Constants.end()) {
+					return false;
+				}
+				count *= length->second;
+			}
+			type_id = type->operands[0];
+			type = GetType(type_id);
+		}
+		if (type == nullptr) {
+			return false;
+		}
+
+		std::map<uint32_t, Decorations>::const_iterator decorations = m_Decorations.find(type_id);
+		switch (type->opcode) {
+		case SPIRV_OP_TYPE_STRUCT:
+			if (storage_class == SPIRV_STORAGE_STORAGE_BUFFER) {
+				descriptor_type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				return true;
+			}
+			// Before SPIR-V 1.3 storage buffers are Uniform blocks decorated BufferBlock
+			if ((decorations != m_Decorations.end()) && decorations->second.bufferBlock) {
+				descriptor_type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				return true;
+			}
+			descriptor_type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			return true;
+		case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+			descriptor_type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			return true;
+		case SPIRV_OP_TYPE_SAMPLER:
+			descriptor_type = VK_DESCRIPTOR_TYPE_SAMPLER;
+			return true;
+		case SPIRV_OP_TYPE_IMAGE: {
+			// Operands: sampled type, dim, depth, arrayed, multisampled, sampled
+			uint32_t dim = type->operands[1];
+			bool storage = type->operands[5] == 2;
+			if (dim == SPIRV_DIM_BUFFER) {
+				descriptor_type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+			}
+			else if (dim == SPIRV_DIM_SUBPASS_DATA) {
+				descriptor_type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+			}
+			else {
+				descriptor_type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+			}
+			return true;
+		}
+		}
+		return false;
+	}
+
+	bool ShaderReflection::GetVertexFormat(uint32_t type_id, VkFormat &format, uint32_t &size) const
+	{
+		static const VkFormat float_formats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+		static const VkFormat int_formats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+		static const VkFormat uint_formats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+		const TypeInfo *type = GetType(type_id);
+		uint32_t component_count = 1;
+		if ((type != nullptr) && (type->opcode == SPIRV_OP_TYPE_VECTOR)) {
+			component_count = type->operands[1];
+			type = GetType(type->operands[0]);
+		}
+		// Only 32 bit components are read from vertex buffers in this engine
+		if ((type == nullptr) || (component_count < 1) || (component_count > 4) || (type->operands[0] != 32)) {
+			return false;
+		}
+		if (type->opcode == SPIRV_OP_TYPE_FLOAT) {
+			format = float_formats[component_count - 1];
+		}
+		else if (type->opcode == SPIRV_OP_TYPE_INT) {
+			format = (type->operands[1] != 0) ? int_formats[component_count - 1] : uint_formats[component_count - 1];
+		}
+		else {
+			return false;
+		}
+		size = component_count * sizeof(uint32_t);
+		return true;
+	}
+
+	uint32_t ShaderReflection::GetTypeSize(uint32_t type_id, uint32_t matrix_stride) const
+	{
+		const TypeInfo *type = GetType(type_id);
+		if (type == nullptr) {
+			return 0;
+		}
+		switch (type->opcode) {
+		case SPIRV_OP_TYPE_BOOL:
+			return 4;
+		case SPIRV_OP_TYPE_INT:
+		case SPIRV_OP_TYPE_FLOAT:
+			return type->operands[0] / 8;
+		case SPIRV_OP_TYPE_VECTOR:
+			return type->operands[1] * GetTypeSize(type->operands[0], 0);
+		case SPIRV_OP_TYPE_MATRIX:
+			return type->operands[1] * ((matrix_stride != 0) ? matrix_stride : GetTypeSize(type->operands[0], 0));
+		case SPIRV_OP_TYPE_ARRAY: {
+			std::map<uint32_t, uint32_t>::const_iterator length = m_Constants.find(type->operands[1]);
+			std::map<uint32_t, Decorations>::const_iterator decorations = m_Decorations.find(type_id);
+			uint32_t stride = ((decorations != m_Decorations.end()) && (decorations->second.arrayStride != 0)) ?
+				decorations->second.arrayStride : GetTypeSize(type->operands[0], matrix_stride);
+			return (length != m_Constants.end()) ? length->second * stride : 0;
+		}
+		case SPIRV_OP_TYPE_STRUCT: {
+			// Explicitly laid out blocks end with their last member
+			std::map<uint32_t, Decorations>::const_iterator decorations = m_Decorations.find(type_id);
+			uint32_t size = 0;
+			uint32_t offset = 0;
+			for (size_t i = 0; i < type->operands.size(); ++i) {
+				uint32_t member_stride = 0;
+				if (decorations != m_Decorations.end()) {
+					const Decorations &member_decorations = decorations->second;
+					if (i < member_decorations.memberOffsets.size()) {
+						offset = member_decorations.memberOffsets[i];
+					}
+					if (i < member_decorations.memberMatrixStrides.size()) {
+						member_stride = member_decorations.memberMatrixStrides[i];
+					}
+				}
+				uint32_t member_size = GetTypeSize(type->operands[i], member_stride);
+				size = std::max(size, offset + member_size);
+				offset += member_size;
+			}
+			return size;
+		}
+		}
+		return 0;
+	}
+
+	const ShaderReflection::TypeInfo* ShaderReflection::GetType(uint32_t id) const
+	{
+		std::map<uint32_t, TypeInfo>::const_iterator it = m_Types.find(id);
+		return (it != m_Types.end()) ? &it->second : nullptr;
+	}
+
+	VkShaderStageFlagBits ShaderReflection::GetStage() const
+	{
+		return m_Stage;
+	}
+
+	const std::vector<ReflectedBinding>& ShaderReflection::GetBindings() const
+	{
+		return m_Bindings;
+	}
+
+	uint32_t ShaderReflection::GetPushConstantSize() const
+	{
+		return m_PushConstantSize;
+	}
+
+	const std::vector<ReflectedVertexInput>& ShaderReflection::GetVertexInputs() const
+	{
+		return m_VertexInputs;
+	}
+
+	void ShaderReflection::GetVertexInputState(uint32_t first_instance_location, std::vector<VkVertexInputBindingDescription> &bindings, std::vector<VkVertexInputAttributeDescription> &attributes) const
+	{
+		bindings.clear();
+		attributes.clear();
+		uint32_t strides[2] = { 0, 0 };
+		for (size_t i = 0; i < m_VertexInputs.size(); ++i) {
+			const ReflectedVertexInput &input = m_VertexInputs[i];
+			uint32_t binding = (input.location >= first_instance_location) ? 1 : 0;
+			VkVertexInputAttributeDescription attribute = {
+				input.location,                                             // uint32_t                                       location
+				binding,                                                    // uint32_t                                       binding
+				input.format,                                               // VkFormat                                       format
+				strides[binding]                                            // uint32_t                                       offset
+			};
+			attributes.push_back(attribute);
+			strides[binding] += input.size;
+		}
+		for (uint32_t i = 0; i < 2; ++i) {
+			if (strides[i] != 0) {
+				VkVertexInputBindingDescription binding = {
+					i,                                                          // uint32_t                                       binding
+					strides[i],                                                 // uint32_t                                       stride
+					(i == 0) ? VK_VERTEX_INPUT_RATE_VERTEX : VK_VERTEX_INPUT_RATE_INSTANCE // VkVertexInputRate                inputRate
+				};
+				bindings.push_back(binding);
+			}
+		}
+	}
+}
+#endif
@@ -0,0 +1,82 @@
+#ifdef USE_RENDER_VULKAN
+#ifndef SHADER_REFLECTION_H
+#define SHADER_REFLECTION_H
+#pragma once
+#include <map>
+#include <vector>
+#include "vulkan_functions.h"
+
+namespace HelloEngine
+{
+	struct ReflectedBinding {
+		uint32_t                      set;
+		VkDescriptorSetLayoutBinding  binding;
+	};
+
+	struct ReflectedVertexInput {
+		uint32_t                      location;
+		VkFormat                      format;
+		uint32_t                      size;
+	};
+
+	// Reads the resource interface of one SPIR-V module: descriptor bindings,
+	// the size of its push constant block and, for vertex shaders, the vertex
+	// inputs. Only what the layouts are built from is parsed, everything else
+	// in the module is skipped.
+	class ShaderReflection {
+	public:
+		ShaderReflection();
+
+		bool									Parse(const std::vector<char> &code, const char *name);
+		VkShaderStageFlagBits					GetStage() const;
+		const std::vector<ReflectedBinding>&	GetBindings() const;
+		uint32_t								GetPushConstantSize() const;
+		const std::vector<ReflectedVertexInput>& GetVertexInputs() const;
+		// Inputs are packed in location order, those from first_instance_location on into a second, per instance binding
+		void									GetVertexInputState(uint32_t first_instance_location, std::vector<VkVertexInputBindingDescription> &bindings, std::vector<VkVertexInputAttributeDescription> &attributes) const;
+	private:
+		struct TypeInfo {
+			uint32_t              opcode;
+			std::vector<uint32_t> operands;
+		};
+
+		struct Decorations {
+			uint32_t              set;
+			uint32_t              binding;
+			uint32_t              location;
+			uint32_t              arrayStride;
+			bool                  builtIn;
+			bool                  block;
+			bool                  bufferBlock;
+			std::vector<uint32_t> memberOffsets;
+			std::vector<uint32_t> memberMatrixStrides;
+
+			Decorations() :
+				set(0),
+				binding(0),
+				location(UINT32_MAX),
+				arrayStride(0),
+				builtIn(false),
+				block(false),
+				bufferBlock(false) {
+			}
+		};
+
+		bool					AddVariable(uint32_t id, uint32_t pointer_type, uint32_t storage_class);
+		bool					GetDescriptorType(uint32_t type_id, uint32_t storage_class, VkDescriptorType &descriptor_type, uint32_t &count) const;
+		bool					GetVertexFormat(uint32_t type_id, VkFormat &format, uint32_t &size) const;
+		uint32_t				GetTypeSize(uint32_t type_id, uint32_t matrix_stride) const;
+		const TypeInfo*			GetType(uint32_t id) const;
+
+		const char							   *m_Name;
+		VkShaderStageFlagBits					m_Stage;
+		std::vector<ReflectedBinding>			m_Bindings;
+		uint32_t								m_PushConstantSize;
+		std::vector<ReflectedVertexInput>		m_VertexInputs;
+		std::map<uint32_t, TypeInfo>			m_Types;
+		std::map<uint32_t, uint32_t>			m_Constants;
+		std::map<uint32_t, Decorations>			m_Decorations;
+	};
+}
+#endif
+#endif
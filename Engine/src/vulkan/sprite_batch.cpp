@@ -0,0 +1,102 @@
+#ifdef USE_RENDER_VULKAN
+#include "sprite_batch.h"
+
+namespace HelloEngine
+{
+	SpriteBatch::SpriteBatch() :
+		m_Sprites(),
+		m_Bounds(),
+		m_Visible(),
+		m_Order(),
+		m_SortScratch()
+	{
+	}
+
+	void SpriteBatch::Add(const Sprite *sprites, size_t count)
+	{
+		size_t first = m_Sprites.size();
+		m_Sprites.insert(m_Sprites.end(), sprites, sprites + count);
+		m_Bounds.Resize(m_Sprites.size());
+		for (size_t i = 0; i < count; ++i) {
+			const Sprite &sprite = sprites[i];
+			float half_width = 0.5f * sprite.width;
+			float half_height = 0.5f * sprite.height;
+			m_Bounds.Set(first + i, sprite.x - half_width, sprite.y - half_height, sprite.x + half_width, sprite.y + half_height);
+		}
+	}
+
+	void SpriteBatch::Clear()
+	{
+		m_Sprites.clear();
+		m_Bounds.Clear();
+		m_Visible.clear();
+	}
+
+	uint32_t SpriteBatch::GetSpriteCount() const
+	{
+		return static_cast<uint32_t>(m_Sprites.size());
+	}
+
+	uint32_t SpriteBatch::Cull(const CullRect &view, const CullSettings &settings)
+	{
+		m_Bounds.Cull(view, m_Visible, settings);
+		return GetVisibleCount();
+	}
+
+	uint32_t SpriteBatch::GetVisibleCount() const
+	{
+		return static_cast<uint32_t>(m_Visible.size());
+	}
+
+	void SpriteBatch::Build(SpriteVertex *vertices, std::vector<SpriteDrawData> &draws)
+	{
+		// Only sprites kept by the last Cull() are expanded, sorted by layer and
+		// texture with submission order breaking ties
+		m_Order.resize(m_Visible.size());
+		for (size_t i = 0; i < m_Visible.size(); ++i) {
+			const Sprite &sprite = m_Sprites[m_Visible[i]];
+			m_Order[i].key = RenderQueue::MakeKey(sprite.layer, 0, sprite.texture, m_Visible[i]);
+			m_Order[i].value = m_Visible[i];
+		}
+		RadixSort(m_Order, m_SortScratch);
+
+		draws.clear();
+		for (size_t i = 0; i < m_Order.size(); ++i) {
+			const Sprite &sprite = m_Sprites[m_Order[i].value];
+			float left = sprite.x - 0.5f * sprite.width;
+			float right = sprite.x + 0.5f * sprite.width;
+			float top = sprite.y - 0.5f * sprite.height;
+			float bottom = sprite.y + 0.5f * sprite.height;
+
+			const Color &tint = sprite.tint;
+			SpriteVertex *quad = vertices + i * VERTICES_PER_SPRITE;
+			quad[0] = { left,  top,    0.0f, 1.0f, sprite.u0, sprite.v0, tint.r, tint.g, tint.b };
+			quad[1] = { left,  bottom, 0.0f, 1.0f, sprite.u0, sprite.v1, tint.r, tint.g, tint.b };
+			quad[2] = { right, top,    0.0f, 1.0f, sprite.u1, sprite.v0, tint.r, tint.g, tint.b };
+			quad[3] = { right, bottom, 0.0f, 1.0f, sprite.u1, sprite.v1, tint.r, tint.g, tint.b };
+
+			// A new draw call is only started when the layer or texture changes
+			if (draws.empty() || (draws.back().texture != sprite.texture) || (draws.back().layer != sprite.layer)) {
+				SpriteDrawData draw = { sprite.layer, sprite.texture, static_cast<uint32_t>(i), 0 };
+				draws.push_back(draw);
+			}
+			++draws.back().spriteCount;
+		}
+	}
+
+	void SpriteBatch::BuildIndices(uint32_t *indices, uint32_t sprite_count)
+	{
+		// Same two triangles, and the same winding, as a four vertex strip
+		for (uint32_t i = 0; i < sprite_count; ++i) {
+			uint32_t first_vertex = i * VERTICES_PER_SPRITE;
+			uint32_t *quad = indices + i * INDICES_PER_SPRITE;
+			quad[0] = first_vertex;
+			quad[1] = first_vertex + 1;
+			quad[2] = first_vertex + 2;
+			quad[3] = first_vertex + 2;
+			quad[4] = first_vertex + 1;
+			quad[5] = first_vertex + 3;
+		}
+	}
+}
+#endif
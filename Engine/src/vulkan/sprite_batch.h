@@ -0,0 +1,54 @@
+#ifdef USE_RENDER_VULKAN
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+#pragma once
+#include <vector>
+#include "renderer.h"
+#include "sprite_culling.h"
+#include "render_queue.h"
+#include "vertex_stream.h"
+
+namespace HelloEngine
+{
+	// Mesh vertex followed by the tint of the sprite it belongs to
+	struct SpriteVertex {
+		float x, y, z, w;
+		float u, v;
+		float r, g, b;
+	};
+
+	// Consecutive sprites that share a layer and texture, drawn with one indexed draw call
+	struct SpriteDrawData {
+		uint32_t                              layer;
+		uint32_t                              texture;
+		uint32_t                              firstSprite;
+		uint32_t                              spriteCount;
+	};
+
+	// Collects the sprites submitted for a frame and expands the visible ones
+	// into quads. Every sprite takes four vertices in triangle strip order, so
+	// one static index pattern serves all of them.
+	class SpriteBatch {
+	public:
+		static const uint32_t	VERTICES_PER_SPRITE = 4;
+		static const uint32_t	INDICES_PER_SPRITE = 6;
+
+		SpriteBatch();
+
+		void					Add(const Sprite *sprites, size_t count);
+		void					Clear();
+		uint32_t				GetSpriteCount() const;
+		uint32_t				Cull(const CullRect &view, const CullSettings &settings);
+		uint32_t				GetVisibleCount() const;
+		void					Build(SpriteVertex *vertices, std::vector<SpriteDrawData> &draws);
+		static void				BuildIndices(uint32_t *indices, uint32_t sprite_count);
+	private:
+		std::vector<Sprite>		m_Sprites;
+		SpriteBounds			m_Bounds;
+		std::vector<uint32_t>	m_Visible;
+		std::vector<SortEntry>	m_Order;
+		std::vector<SortEntry>	m_SortScratch;
+	};
+}
+#endif
+#endif
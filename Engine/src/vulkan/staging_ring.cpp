@@ -0,0 +1,87 @@
+#ifdef USE_RENDER_VULKAN
+#include "staging_ring.h"
+
+namespace HelloEngine
+{
+	StagingRing::StagingRing() :
+		m_Capacity(0),
+		m_Head(0),
+		m_Used(0),
+		m_Untagged(0),
+		m_Pending()
+	{
+	}
+
+	void StagingRing::Initialize(VkDeviceSize capacity)
+	{
+		m_Capacity = capacity;
+		m_Head = 0;
+		m_Used = 0;
+		m_Untagged = 0;
+		m_Pending.clear();
+	}
+
+	bool StagingRing::Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset)
+	{
+		if (alignment == 0) {
+			alignment = 1;
+		}
+		VkDeviceSize aligned = (m_Head + alignment - 1) / alignment * alignment;
+		VkDeviceSize padding = aligned - m_Head;
+		if (aligned + size > m_Capacity) {
+			// Skip the tail of the buffer and continue from its beginning
+			aligned = 0;
+			padding = m_Capacity - m_Head;
+		}
+		if (m_Used + padding + size > m_Capacity) {
+			return false;
+		}
+		offset = aligned;
+		m_Head = aligned + size;
+		m_Used += padding + size;
+		m_Untagged += padding + size;
+		return true;
+	}
+
+	void StagingRing::Tag(uint64_t submit_index)
+	{
+		if (m_Untagged == 0) {
+			return;
+		}
+		PendingRange range = { m_Untagged, submit_index };
+		m_Pending.push_back(range);
+		m_Untagged = 0;
+	}
+
+	void StagingRing::ReleaseOldest()
+	{
+		if (!m_Pending.empty()) {
+			m_Used -= m_Pending.front().size;
+			m_Pending.pop_front();
+		}
+		if (m_Used == 0) {
+			m_Head = 0;
+		}
+	}
+
+	bool StagingRing::HasUntagged() const
+	{
+		return m_Untagged != 0;
+	}
+
+	bool StagingRing::HasPending() const
+	{
+		return !m_Pending.empty();
+	}
+
+	uint64_t StagingRing::GetOldestSubmit() const
+	{
+		return m_Pending.empty() ? 0 : m_Pending.front().submitIndex;
+	}
+
+	VkDeviceSize StagingRing::GetCapacity() const
+	{
+		return m_Capacity;
+	}
+}
+#endif
@@ -0,0 +1,39 @@
+#ifdef USE_RENDER_VULKAN
+#ifndef STAGING_RING_H
+#define STAGING_RING_H
+#pragma once
+#include <deque>
+#include "vulkan_functions.h"
+
+namespace HelloEngine
+{
+	// Hands out ranges of a persistently mapped staging buffer in ring order.
+	// Ranges allocated since the last Tag() belong to the next submit; they
+	// come back in submission order through ReleaseOldest() once it is done.
+	class StagingRing {
+	public:
+		StagingRing();
+
+		void					Initialize(VkDeviceSize capacity);
+		bool					Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset);
+		void					Tag(uint64_t submit_index);
+		void					ReleaseOldest();
+		bool					HasUntagged() const;
+		bool					HasPending() const;
+		uint64_t				GetOldestSubmit() const;
+		VkDeviceSize			GetCapacity() const;
+	private:
+		struct PendingRange {
+			VkDeviceSize size;
+			uint64_t     submitIndex;
+		};
+
+		VkDeviceSize				m_Capacity;
+		VkDeviceSize				m_Head;
+		VkDeviceSize				m_Used;
+		VkDeviceSize				m_Untagged;
+		std::deque<PendingRange>	m_Pending;
+	};
+}
+#endif
+#endif
@@ -0,0 +1,69 @@
+#ifdef USE_RENDER_VULKAN
+#include "uniform_ring.h"
+
+namespace HelloEngine
+{
+	UniformRing::UniformRing() :
+		m_MappedData(nullptr),
+		m_SlotSize(0),
+		m_SlotsPerFrame(0),
+		m_FrameCount(0),
+		m_FrameIndex(0),
+		m_UsedSlots(0)
+	{
+	}
+
+	void UniformRing::Initialize(void *mapped_data, VkDeviceSize slot_size, uint32_t slots_per_frame, uint32_t frame_count)
+	{
+		m_MappedData = static_cast<char*>(mapped_data);
+		m_SlotSize = slot_size;
+		m_SlotsPerFrame = slots_per_frame;
+		m_FrameCount = frame_count;
+		m_FrameIndex = 0;
+		m_UsedSlots = 0;
+	}
+
+	void UniformRing::BeginFrame(uint32_t frame_index)
+	{
+		m_FrameIndex = frame_index % m_FrameCount;
+		m_UsedSlots = 0;
+	}
+
+	bool UniformRing::Allocate(uint32_t &offset, void *&data)
+	{
+		if (m_UsedSlots == m_SlotsPerFrame) {
+			return false;
+		}
+		VkDeviceSize slot_offset = GetFrameOffset() + m_UsedSlots * m_SlotSize;
+		++m_UsedSlots;
+		offset = static_cast<uint32_t>(slot_offset);
+		data = m_MappedData + slot_offset;
+		return true;
+	}
+
+	VkDeviceSize UniformRing::GetFrameOffset() const
+	{
+		return static_cast<VkDeviceSize>(m_FrameIndex) * m_SlotsPerFrame * m_SlotSize;
+	}
+
+	VkDeviceSize UniformRing::GetFrameUsedSize() const
+	{
+		return m_UsedSlots * m_SlotSize;
+	}
+
+	uint32_t UniformRing::GetPersistentOffset() const
+	{
+		return static_cast<uint32_t>(static_cast<VkDeviceSize>(m_FrameCount) * m_SlotsPerFrame * m_SlotSize);
+	}
+
+	VkDeviceSize UniformRing::GetSlotSize() const
+	{
+		return m_SlotSize;
+	}
+
+	VkDeviceSize UniformRing::GetRequiredSize(VkDeviceSize slot_size, uint32_t slots_per_frame, uint32_t frame_count)
+	{
+		return (static_cast<VkDeviceSize>(frame_count) * slots_per_frame + 1) * slot_size;
+	}
+}
+#endif
@@ -0,0 +1,34 @@
+#ifdef USE_RENDER_VULKAN
+#ifndef UNIFORM_RING_H
+#define UNIFORM_RING_H
+#pragma once
+#include "vulkan_functions.h"
+
+namespace HelloEngine
+{
+	// Splits a persistently mapped uniform buffer into one region per frame in
+	// flight plus a trailing slot for pre-recorded command buffers. Every frame
+	// hands out fixed-size slots from its region, addressed by dynamic offsets.
+	class UniformRing {
+	public:
+		UniformRing();
+
+		void					Initialize(void *mapped_data, VkDeviceSize slot_size, uint32_t slots_per_frame, uint32_t frame_count);
+		void					BeginFrame(uint32_t frame_index);
+		bool					Allocate(uint32_t &offset, void *&data);
+		VkDeviceSize			GetFrameOffset() const;
+		VkDeviceSize			GetFrameUsedSize() const;
+		uint32_t				GetPersistentOffset() const;
+		VkDeviceSize			GetSlotSize() const;
+		static VkDeviceSize		GetRequiredSize(VkDeviceSize slot_size, uint32_t slots_per_frame, uint32_t frame_count);
+	private:
+		char				   *m_MappedData;
+		VkDeviceSize			m_SlotSize;
+		uint32_t				m_SlotsPerFrame;
+		uint32_t				m_FrameCount;
+		uint32_t				m_FrameIndex;
+		uint32_t				m_UsedSlots;
+	};
+}
+#endif
+#endif
@@ -0,0 +1,100 @@
+#ifdef USE_RENDER_VULKAN
+#include "vertex_stream.h"
+#include <algorithm>
+#include <string.h>
+
+namespace HelloEngine
+{
+	VertexStream::VertexStream() :
+		m_Data(),
+		m_DirtyRanges()
+	{
+	}
+
+	void VertexStream::Initialize(uint32_t copy_count)
+	{
+		DirtyRange clean = { 0, 0 };
+		m_DirtyRanges.assign(copy_count, clean);
+		Invalidate();
+	}
+
+	bool VertexStream::Update(size_t offset, const float *data, size_t count)
+	{
+		if (offset > m_Data.size()) {
+			return false;
+		}
+		if (offset + count > m_Data.size()) {
+			m_Data.resize(offset + count);
+		}
+		if (count != 0) {
+			memcpy(&m_Data[offset], data, count * sizeof(float));
+		}
+		MarkDirty(offset, offset + count);
+		return true;
+	}
+
+	void VertexStream::Append(const float *data, size_t count)
+	{
+		Update(m_Data.size(), data, count);
+	}
+
+	void VertexStream::Orphan(const float *data, size_t count)
+	{
+		// Nothing of the previous contents survives, so every copy simply takes the new data
+		m_Data.assign(data, data + count);
+		MarkDirty(0, count);
+	}
+
+	void VertexStream::Invalidate()
+	{
+		MarkDirty(0, m_Data.size());
+	}
+
+	bool VertexStream::TakeDirtyRange(uint32_t copy_index, VkDeviceSize &offset, VkDeviceSize &size)
+	{
+		DirtyRange &range = m_DirtyRanges[copy_index];
+		size_t end = std::min(range.end, m_Data.size());
+		if (range.begin >= end) {
+			range.begin = range.end = 0;
+			return false;
+		}
+		offset = range.begin * sizeof(float);
+		size = (end - range.begin) * sizeof(float);
+		range.begin = range.end = 0;
+		return true;
+	}
+
+	const float* VertexStream::GetData() const
+	{
+		return m_Data.empty() ? nullptr : &m_Data[0];
+	}
+
+	size_t VertexStream::GetFloatCount() const
+	{
+		return m_Data.size();
+	}
+
+	VkDeviceSize VertexStream::GetSize() const
+	{
+		return m_Data.size() * sizeof(float);
+	}
+
+	void VertexStream::MarkDirty(size_t begin, size_t end)
+	{
+		if (begin >= end) {
+			return;
+		}
+		for (size_t i = 0; i < m_DirtyRanges.size(); ++i) {
+			DirtyRange &range = m_DirtyRanges[i];
+			if (range.begin >= range.end) {
+				range.begin = begin;
+				range.end = end;
+			}
+			else {
+				range.begin = std::min(range.begin, begin);
+				range.end = std::max(range.end, end);
+			}
+		}
+	}
+}
+#endif
@@ -0,0 +1,44 @@
+#ifdef USE_RENDER_VULKAN
+#ifndef VERTEX_STREAM_H
+#define VERTEX_STREAM_H
+#pragma once
+#include <vector>
+#include "vulkan_functions.h"
+
+namespace HelloEngine
+{
+	struct VertexData {
+		float x, y, z, w;
+		float u, v;
+	};
+
+	// Keeps the latest contents of streamed vertex data on the CPU and, for
+	// every per-frame copy on the GPU side, the byte range that is out of date.
+	// Writes never touch memory a frame in flight may read, so they never wait.
+	class VertexStream {
+	public:
+		VertexStream();
+
+		void					Initialize(uint32_t copy_count);
+		bool					Update(size_t offset, const float *data, size_t count);
+		void					Append(const float *data, size_t count);
+		void					Orphan(const float *data, size_t count);
+		void					Invalidate();
+		bool					TakeDirtyRange(uint32_t copy_index, VkDeviceSize &offset, VkDeviceSize &size);
+		const float			   *GetData() const;
+		size_t					GetFloatCount() const;
+		VkDeviceSize			GetSize() const;
+	private:
+		struct DirtyRange {
+			size_t begin;
+			size_t end;
+		};
+
+		void					MarkDirty(size_t begin, size_t end);
+
+		std::vector<float>			m_Data;
+		std::vector<DirtyRange>		m_DirtyRanges;
+	};
+}
+#endif
+#endif
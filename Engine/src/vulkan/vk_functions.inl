@@ -45,6 +45,14 @@ VK_INSTANCE_LEVEL_FUNCTION(vkGetPhysicalDeviceMemoryProperties)
 
 #undef VK_INSTANCE_LEVEL_FUNCTION
 
+#if !defined(VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION)
+#define VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION( fun, extension )
+#endif
+
+VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION(vkGetPhysicalDeviceFeatures2KHR, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)
+
+#undef VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION
+
 #if !defined(VK_DEVICE_LEVEL_FUNCTION)
 #define VK_DEVICE_LEVEL_FUNCTION( fun )
 #endif
@@ -80,6 +88,16 @@ VK_DEVICE_LEVEL_FUNCTION(vkCreateGraphicsPipelines)
 VK_DEVICE_LEVEL_FUNCTION(vkCmdBeginRenderPass)
 VK_DEVICE_LEVEL_FUNCTION(vkCmdBindPipeline)
 VK_DEVICE_LEVEL_FUNCTION(vkCmdDraw)
+VK_DEVICE_LEVEL_FUNCTION(vkCmdDrawIndexed)
+VK_DEVICE_LEVEL_FUNCTION(vkCmdBindIndexBuffer)
+VK_DEVICE_LEVEL_FUNCTION(vkCmdDrawIndirect)
+VK_DEVICE_LEVEL_FUNCTION(vkCmdDrawIndexedIndirect)
+VK_DEVICE_LEVEL_FUNCTION(vkCmdDispatch)
+VK_DEVICE_LEVEL_FUNCTION(vkCmdPushConstants)
+VK_DEVICE_LEVEL_FUNCTION(vkCreateComputePipelines)
+VK_DEVICE_LEVEL_FUNCTION(vkCreatePipelineCache)
+VK_DEVICE_LEVEL_FUNCTION(vkGetPipelineCacheData)
+VK_DEVICE_LEVEL_FUNCTION(vkDestroyPipelineCache)
 VK_DEVICE_LEVEL_FUNCTION(vkCmdEndRenderPass)
 VK_DEVICE_LEVEL_FUNCTION(vkDestroyShaderModule)
 VK_DEVICE_LEVEL_FUNCTION(vkDestroyPipelineLayout)
@@ -100,10 +118,12 @@ VK_DEVICE_LEVEL_FUNCTION(vkCmdSetScissor)
 VK_DEVICE_LEVEL_FUNCTION(vkCmdBindVertexBuffers)
 VK_DEVICE_LEVEL_FUNCTION(vkWaitForFences)
 VK_DEVICE_LEVEL_FUNCTION(vkResetFences)
+VK_DEVICE_LEVEL_FUNCTION(vkGetFenceStatus)
 VK_DEVICE_LEVEL_FUNCTION(vkFreeMemory)
 VK_DEVICE_LEVEL_FUNCTION(vkDestroyBuffer)
 VK_DEVICE_LEVEL_FUNCTION(vkDestroyFence)
 VK_DEVICE_LEVEL_FUNCTION(vkCmdCopyBuffer)
+VK_DEVICE_LEVEL_FUNCTION(vkCmdUpdateBuffer)
 VK_DEVICE_LEVEL_FUNCTION(vkCreateImage)
 VK_DEVICE_LEVEL_FUNCTION(vkGetImageMemoryRequirements)
 VK_DEVICE_LEVEL_FUNCTION(vkBindImageMemory)
@@ -115,9 +135,19 @@ VK_DEVICE_LEVEL_FUNCTION(vkAllocateDescriptorSets)
 VK_DEVICE_LEVEL_FUNCTION(vkUpdateDescriptorSets)
 VK_DEVICE_LEVEL_FUNCTION(vkCmdBindDescriptorSets)
 VK_DEVICE_LEVEL_FUNCTION(vkDestroyDescriptorPool)
+VK_DEVICE_LEVEL_FUNCTION(vkResetDescriptorPool)
 VK_DEVICE_LEVEL_FUNCTION(vkDestroyDescriptorSetLayout)
 VK_DEVICE_LEVEL_FUNCTION(vkDestroySampler)
 VK_DEVICE_LEVEL_FUNCTION(vkDestroyImage)
 
 #undef VK_DEVICE_LEVEL_FUNCTION
+
+#if !defined(VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION)
+#define VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION( fun, extension )
+#endif
+
+VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION(vkGetSemaphoreCounterValueKHR, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)
+VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION(vkWaitSemaphoresKHR, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)
+
+#undef VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION
 #endif
\ No newline at end of file
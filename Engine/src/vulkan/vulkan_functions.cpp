@@ -1,5 +1,6 @@
 #ifdef USE_RENDER_VULKAN
 #include "vulkan.h"
+#include "vk_extensions.h"
 
 namespace HelloEngine 
 {
@@ -8,6 +9,8 @@ namespace HelloEngine
 #define VK_GLOBAL_LEVEL_FUNCTION( fun ) PFN_##fun fun;
 #define VK_INSTANCE_LEVEL_FUNCTION( fun ) PFN_##fun fun;
 #define VK_DEVICE_LEVEL_FUNCTION( fun ) PFN_##fun fun;
+#define VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION( fun, extension ) PFN_##fun fun;
+#define VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION( fun, extension ) PFN_##fun fun;
 
 #include "vk_functions.inl"
 
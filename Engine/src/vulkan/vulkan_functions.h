@@ -3,6 +3,7 @@
 #define VULKAN_FUNCTIONS_H
 #pragma once
 #include "vulkan.h"
+#include "vk_extensions.h"
 
 namespace HelloEngine
 {
@@ -11,6 +12,8 @@ namespace HelloEngine
 #define VK_GLOBAL_LEVEL_FUNCTION( fun) extern PFN_##fun fun;
 #define VK_INSTANCE_LEVEL_FUNCTION( fun ) extern PFN_##fun fun;
 #define VK_DEVICE_LEVEL_FUNCTION( fun ) extern PFN_##fun fun;
+#define VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION( fun, extension ) extern PFN_##fun fun;
+#define VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION( fun, extension ) extern PFN_##fun fun;
 
 #include "vk_functions.inl"
 
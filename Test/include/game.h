@@ -1,13 +1,27 @@
 #pragma once
+#include <chrono>
 #include "window.h"
 #include "renderer.h"
+#include "spatial_grid.h"
 
 class Game : public HelloEngine::WindowEventHandler {
-	const char           *NAME = "Test";
-	HelloEngine::Window   m_Window;
-	HelloEngine::Renderer m_Renderer;
+	const char                         *NAME = "Test";
+	HelloEngine::Window                 m_Window;
+	HelloEngine::Renderer               m_Renderer;
+	std::vector<HelloEngine::Sprite>    m_Sprites;
+	std::vector<float>                  m_SpriteVelocities;
+	HelloEngine::SpatialGrid            m_SpriteGrid;
+	HelloEngine::RendererStatistics     m_ReportedStatistics;
+	std::chrono::steady_clock::time_point m_ReportTime;
+	bool                                m_SpriteBlending = false;
+
+	void CreateBenchmarkSprites(uint32_t count);
+	void UpdateBenchmarkSprites();
+	void ReportBenchmark();
 public:
-	bool Initialize();
+	static void RunCullBenchmark(uint32_t sprite_count);
+	bool Initialize(uint32_t benchmark_sprites = 0);
 	void Run();
 	void OnLButtonDown(int x, int y) override;
+	void OnRButtonDown(int x, int y) override;
 };
@@ -1,13 +1,51 @@
 #include "game.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <thread>
+#include <algorithm>
+
+namespace
+{
+	HelloEngine::CullRect GetSpriteBounds(const HelloEngine::Sprite &sprite)
+	{
+		HelloEngine::CullRect bounds = {
+			sprite.x - 0.5f * sprite.width, sprite.y - 0.5f * sprite.height,
+			sprite.x + 0.5f * sprite.width, sprite.y + 0.5f * sprite.height
+		};
+		return bounds;
+	}
+}
 
 void Game::OnLButtonDown(int x, int y)
 {
 	printf("Left button down at %d %d\n", x, y);
+	if (m_Sprites.empty()) {
+		return;
+	}
+	HelloEngine::CullRect view = m_Renderer.GetViewRect();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	uint32_t sprite = 0;
+	bool picked = m_SpriteGrid.Pick(view.left + x, view.top + y, sprite);
+	std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+	if (picked) {
+		printf("Picked sprite %u in %.2f us\n", sprite, elapsed.count());
+	}
+	else {
+		printf("No sprite picked in %.2f us\n", elapsed.count());
+	}
+}
+
+void Game::OnRButtonDown(int, int)
+{
+	// The blended pipeline is compiled in the background the first time, sprites stay opaque meanwhile
+	m_SpriteBlending = !m_SpriteBlending;
+	m_Renderer.SetSpriteBlending(m_SpriteBlending);
+	HelloEngine::RendererStatistics statistics = m_Renderer.GetStatistics();
+	printf("Sprite blending %s, %u pipelines, %u compiling\n", m_SpriteBlending ? "on" : "off",
+		statistics.graphicsPipelines, statistics.pendingGraphicsPipelines);
 }
 
-bool Game::Initialize()
+bool Game::Initialize(uint32_t benchmark_sprites)
 {
 	m_Window.AddEventHandler(this);	
 	if (!m_Window.Create(NAME)) {
@@ -29,9 +67,130 @@ bool Game::Initialize()
 	if (!m_Renderer.Initialize(m_Window.GetParameters(), vertex_data)) {
 		return false;
 	}
+	HelloEngine::RendererStatistics statistics = m_Renderer.GetStatistics();
+	printf("Pipelines created in %.2f ms, %.2f ms saved by the pipeline cache\n",
+		statistics.pipelineCreationMilliseconds, statistics.pipelineCacheSavedMilliseconds);
+	CreateBenchmarkSprites(benchmark_sprites);
 	return true;
 }
 
+void Game::CreateBenchmarkSprites(uint32_t count)
+{
+	m_Sprites.resize(count);
+	m_SpriteVelocities.resize(2 * count);
+	// Sprites bounce inside 1024x768, the grid covers it with a little margin for their size
+	const HelloEngine::CullRect world = { -520.0f, -392.0f, 520.0f, 392.0f };
+	m_SpriteGrid.Initialize(world, 16.0f);
+	for (uint32_t i = 0; i < count; ++i) {
+		HelloEngine::Sprite &sprite = m_Sprites[i];
+		sprite.x = static_cast<float>(rand() % 1024 - 512);
+		sprite.y = static_cast<float>(rand() % 768 - 384);
+		sprite.width = 8.0f;
+		sprite.height = 8.0f;
+		m_SpriteVelocities[2 * i] = static_cast<float>(rand() % 5 - 2);
+		m_SpriteVelocities[2 * i + 1] = static_cast<float>(rand() % 5 - 2);
+		m_SpriteGrid.Insert(i, GetSpriteBounds(sprite));
+	}
+	m_ReportedStatistics = m_Renderer.GetStatistics();
+	m_ReportTime = std::chrono::steady_clock::now();
+}
+
+void Game::UpdateBenchmarkSprites()
+{
+	for (size_t i = 0; i < m_Sprites.size(); ++i) {
+		HelloEngine::Sprite &sprite = m_Sprites[i];
+		sprite.x += m_SpriteVelocities[2 * i];
+		sprite.y += m_SpriteVelocities[2 * i + 1];
+		if ((sprite.x < -512.0f) || (sprite.x > 512.0f)) {
+			m_SpriteVelocities[2 * i] = -m_SpriteVelocities[2 * i];
+		}
+		if ((sprite.y < -384.0f) || (sprite.y > 384.0f)) {
+			m_SpriteVelocities[2 * i + 1] = -m_SpriteVelocities[2 * i + 1];
+		}
+		m_SpriteGrid.Update(static_cast<uint32_t>(i), GetSpriteBounds(sprite));
+	}
+}
+
+void Game::ReportBenchmark()
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	std::chrono::duration<double, std::milli> elapsed = now - m_ReportTime;
+	if (elapsed.count() < 1000.0) {
+		return;
+	}
+	HelloEngine::RendererStatistics statistics = m_Renderer.GetStatistics();
+	uint64_t frames = statistics.frameCount - m_ReportedStatistics.frameCount;
+	uint64_t sprites = statistics.spriteCount - m_ReportedStatistics.spriteCount;
+	uint64_t draw_calls = statistics.spriteDrawCalls - m_ReportedStatistics.spriteDrawCalls;
+	uint64_t visible_sprites = statistics.visibleSpriteCount - m_ReportedStatistics.visibleSpriteCount;
+	double build_time = statistics.spriteBuildMilliseconds - m_ReportedStatistics.spriteBuildMilliseconds;
+	double cull_time = statistics.spriteCullMilliseconds - m_ReportedStatistics.spriteCullMilliseconds;
+	uint64_t skipped_binds =
+		(statistics.skippedPipelineBinds - m_ReportedStatistics.skippedPipelineBinds) +
+		(statistics.skippedDescriptorSetBinds - m_ReportedStatistics.skippedDescriptorSetBinds) +
+		(statistics.skippedVertexBufferBinds - m_ReportedStatistics.skippedVertexBufferBinds);
+	if (frames != 0) {
+		printf("%u sprites: %.1f fps, %.1f sprites/ms built, %.1f sprites/ms overall, %.1f draw calls per frame, %.1f%% visible, %.3f ms culling per frame, %.1f binds skipped per frame\n",
+			static_cast<unsigned>(m_Sprites.size()),
+			1000.0 * frames / elapsed.count(),
+			(build_time > 0.0) ? visible_sprites / build_time : 0.0,
+			sprites / elapsed.count(),
+			static_cast<double>(draw_calls) / frames,
+			(sprites != 0) ? 100.0 * visible_sprites / sprites : 0.0,
+			cull_time / frames,
+			static_cast<double>(skipped_binds) / frames);
+	}
+	m_ReportedStatistics = statistics;
+	m_ReportTime = now;
+}
+
+void Game::RunCullBenchmark(uint32_t sprite_count)
+{
+	// Sprites spread over a world much larger than the 1024x768 view, as in a scrolling game
+	HelloEngine::SpriteBounds bounds;
+	bounds.Resize(sprite_count);
+	for (uint32_t i = 0; i < sprite_count; ++i) {
+		float x = static_cast<float>(rand() % 16384 - 8192);
+		float y = static_cast<float>(rand() % 16384 - 8192);
+		bounds.Set(i, x - 4.0f, y - 4.0f, x + 4.0f, y + 4.0f);
+	}
+	const HelloEngine::CullRect view = { -512.0f, -384.0f, 512.0f, 384.0f };
+
+	HelloEngine::CullSettings scalar_settings;
+	scalar_settings.method = HelloEngine::CullMethod::Scalar;
+	HelloEngine::CullSettings simd_settings;
+	HelloEngine::CullSettings threaded_settings;
+	threaded_settings.threadCount = std::max(1u, std::thread::hardware_concurrency());
+	const struct {
+		const char                 *name;
+		HelloEngine::CullSettings   settings;
+	} runs[] = {
+		{ "scalar", scalar_settings },
+		{ HelloEngine::IsAvxCullingSupported() ? "avx" : "sse", simd_settings },
+		{ "threaded", threaded_settings }
+	};
+
+	const int iterations = 20;
+	std::vector<uint32_t> reference;
+	bounds.Cull(view, reference, scalar_settings);
+	std::vector<uint32_t> visible;
+	for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); ++i) {
+		// The first threaded cull starts the workers, later ones only hand them chunks as a frame would
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bounds.Cull(view, visible, runs[i].settings);
+		std::chrono::duration<double, std::milli> first = std::chrono::steady_clock::now() - start;
+		start = std::chrono::steady_clock::now();
+		for (int j = 0; j < iterations; ++j) {
+			bounds.Cull(view, visible, runs[i].settings);
+		}
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		printf("%-8s %u threads: %.3f ms per cull (first %.3f ms), %u of %u visible%s\n",
+			runs[i].name, runs[i].settings.threadCount, elapsed.count() / iterations, first.count(),
+			static_cast<unsigned>(visible.size()), sprite_count,
+			(visible == reference) ? "" : ", MISMATCH");
+	}
+}
+
 void Game::Run()
 {
 	while (!m_Window.IsCloseRequested()) {
@@ -42,9 +201,18 @@ void Game::Run()
 				}
 			}
 			if (m_Renderer.ReadyToDraw()) {
+				if (!m_Sprites.empty()) {
+					UpdateBenchmarkSprites();
+					if (!m_Renderer.DrawSprites(m_Sprites)) {
+						break;
+					}
+				}
 				if (!m_Renderer.Draw()) {
 					break;
 				}
+				if (!m_Sprites.empty()) {
+					ReportBenchmark();
+				}
 			}
 			else {
 				std::this_thread::sleep_for(std::chrono::milliseconds(100));
@@ -1,9 +1,22 @@
 #include "game.h"
+#include <stdlib.h>
+#include <string.h>
 
-int main()
+int main(int argc, char *argv[])
 {
+	// "--sprite-benchmark [count]" draws count moving sprites every frame and reports the throughput
+	uint32_t benchmark_sprites = 0;
+	if ((argc > 1) && (strcmp(argv[1], "--sprite-benchmark") == 0)) {
+		benchmark_sprites = (argc > 2) ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : 100000;
+	}
+	// "--cull-benchmark [count]" compares the sprite culling kernels without opening a window
+	if ((argc > 1) && (strcmp(argv[1], "--cull-benchmark") == 0)) {
+		Game::RunCullBenchmark((argc > 2) ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : 1000000);
+		return 0;
+	}
+
 	Game game;	
-	if(game.Initialize()){
+	if(game.Initialize(benchmark_sprites)){
 		game.Run();
 	}
 	return 0;